@@ -15,6 +15,7 @@ public:
         const Vec_t buoyancy = calculateBuoyancy(density, 1.0, gravity);
         return drag + buoyancy;
     }
+    Vec_t operator()(Particle_t &particle) { return calculateForce(particle); }
 
 private:
     mp::map_logistic<float> densityMap;
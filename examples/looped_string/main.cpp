@@ -18,50 +18,7 @@ Renderer renderer(120, 0.0f, 1.0f, leds);
 using Vec_t = Vec<2, float>;
 using Particle_t = Particle<2, float>;
 using Constraint_t = Constraint<2, float>;
-
-
-inline Vec_t wrappedDistance(const Vec_t &lhs, const Vec_t &rhs)
-{
-    static mp::wrapped_distance<float> wrap(1.0);
-    Vec_t diff = lhs - rhs;
-    diff.x() = wrap(diff.x());
-    return diff;
-}
-
-class WrappedDistanceConstraint : public Constraint<2, float>
-{
-    using Particle_t = Particle<2, float>;
-    using Vec_t = Vec<2, float>;
-public:
-    WrappedDistanceConstraint(Particle_t &p1, Particle_t &p2) 
-        : Constraint<2, float>(p1, p2), wrap(1.0), length((wrappedDistance(this->p1.position, this->p2.position)).length()) 
-    {
-    }
-    void solve(float dt) override
-    {
-        float constraintMass = this->p1.inverseMass + this->p2.inverseMass;
-        if (constraintMass <= 0)
-            return;
-
-        Vec<2, float> relativePosition = wrappedDistance(this->p1.position, this->p2.position);
-        float distance = relativePosition.length();
-        float offset = length - distance;
-        offset *= strength;
-        Vec<2, float> offsetDir = relativePosition.normalised();
-        Vec<2, float> relativeVelocity = this->p1.linearVelocity - this->p2.linearVelocity;
-        float velocityDot = Vec<2, float>::dot(relativeVelocity, offsetDir);
-        float bias = -(biasFactor / dt) * offset;
-        float lambda = -(velocityDot + bias) / constraintMass;
-        
-        this->p1.applyImpulse(offsetDir * lambda);
-        this->p2.applyImpulse(-offsetDir * lambda);
-    }
-    mp::wrapped_distance<float> wrap;
-    bool log = false;
-    float length;
-    float strength = 1.0;
-    float biasFactor = 0.6;
-};
+using WrappedDistance_t = WrappedDistanceConstraint<2, float>;
 
 void handleEdge(Particle_t &particle)
 {
@@ -76,16 +33,10 @@ void handleEdge(Particle_t &particle)
 
 constexpr int nParticles = 30;
 etl::vector<Particle_t, nParticles> particles;
-etl::vector<WrappedDistanceConstraint, nParticles> constraints;
+etl::vector<WrappedDistance_t, nParticles> constraints;
 
 etl::vector<std::reference_wrapper<Constraint_t>, nParticles> constraint_refs;
 mp::World<2, float> world;
-LogisticMedium medium(-1.0, 1.0, 2.0, 0.0, 1.0, world.gravity); 
-
-Vec_t applyForces(Particle_t &particle)
-{
-    return medium.calculateForce(particle);
-}
 
 void setup()
 {
@@ -115,7 +66,7 @@ void setup()
     
     for (size_t i = 0; i < particles.size(); ++i)
     {
-        WrappedDistanceConstraint d(particles[i], particles[(i + 1) % particles.size()]);
+        WrappedDistance_t d(particles[i], particles[(i + 1) % particles.size()], {1.0f, 0.0f}, 1.0f, 0.6f);
         constraints.push_back(d);
     }
     
@@ -124,12 +75,15 @@ void setup()
     for (Constraint_t &c : constraints)
         constraint_refs.push_back(std::ref(c));
     world.addConstraints({constraint_refs});
-    world.setForceCB(applyForces);
+    world.addForce(LogisticMedium(-1.0, 1.0, 2.0, 0.0, 1.0, world.gravity));
     world.setDamping(0.3);
     world.gravity = {0.0, -9.5};
     world.timeStretch = 1.0f;
     world.iterationCount = 2;
     world.stepSize = 0.045f;
+    // cover slow frames with longer sub-steps rather than more of them
+    world.setMaxSubSteps(2);
+    world.setOverloadPolicy(mp::OverloadPolicy::StretchTime);
 }
 
 void loop()
@@ -150,15 +104,12 @@ void loop()
        renderer.show();
        renderMs = 0;
    }
-   if (world.isDeathSpiralling)
+   if (world.status.overloaded)
    {
-       float stepSize = world.stepSize + 0.01;
-       Serial.print(world.dtAccumulator);
-       Serial.print("\t");
-       Serial.print(world.stepSize);
-        Serial.print("\tbad, changing stepsize to ");
-        Serial.println(stepSize);
-        world.stepSize = stepSize;
+        Serial.print("overloaded, stretch ");
+        Serial.print(world.status.stretch);
+        Serial.print("\tdropped ");
+        Serial.println(world.status.droppedTime);
    }
 
    static elapsedMillis reportms;
@@ -1,102 +1,1147 @@
 #pragma once
 
 #include "utility/debug.hpp"
+#include "utility/profile.hpp"
 #include "utility/range.hpp"
 #include "dynamics/particle.hpp"
+#include "dynamics/particle_store.hpp"
+#include "dynamics/force.hpp"
+#include "dynamics/sleep.hpp"
+#include "dynamics/governor.hpp"
 #include "constraints/constraint.hpp"
+#include "constraints/colouring.hpp"
+#include "constraints/constraint_set.hpp"
+#include "constraints/indexed.hpp"
+#include "constraints/residual.hpp"
+#include "constraints/islands.hpp"
+#include "constraints/implicit.hpp"
+#include "constraints/jacobi.hpp"
+#include "parallel/executor.hpp"
+#include "parallel/snapshot.hpp"
 #include "common/vec.hpp"
 
 namespace mp {
 
-template<int Dim, typename T >
+enum class SolverMode
+{
+    // solve every constraint in turn, in the order they were added
+    GaussSeidel,
+    // solve by colour of the constraint graph, each colour spread across the executor
+    Coloured,
+    // solve each connected island through all its iterations on its own, islands
+    // spread across the executor. Same result as GaussSeidel.
+    Islands,
+    // solve indexed sets with JacobiSolver, every stage spread across the
+    // executor. Range constraints and groups are solved as in GaussSeidel.
+    Jacobi,
+    // extended position based dynamics: positions are integrated first and the
+    // constraints project them back, softened by each one's compliance, then
+    // velocities are taken from the change. Stiffness no longer depends on
+    // iterationCount, so one iteration and a small stepSize is usually the
+    // cheapest way to stiff cloth. Split across the executor by colour.
+    XPBD,
+    // indexed sets with compliance > 0 are springs integrated by ImplicitSolver
+    // with backward Euler, stable at steps far longer than their stiffness
+    // would otherwise allow. Everything else is solved as in GaussSeidel.
+    Implicit
+};
+
+// Particles is the storage World steps over: either a contiguous_range of
+// Particle structs (the default) or a ParticleStore<Dim, T>::range of SoA arrays.
+// Both index to something with the Particle interface.
+template<int Dim, typename T, typename Particles = contiguous_range<Particle<Dim, T>>>
 class World
 {
     // typedefs for current template types
     using Vec_t = Vec<Dim, T>;
     using Particle_t = Particle<Dim, T>;
+    using Particle_ref = decltype(std::declval<Particles &>()[0]);
     using Constraint_t = Constraint<Dim, T>;
-    using particle_cb_fn = void (*)(Particle<Dim, T> &);
-    using force_cb_fn = Vec_t (*)(Particle<Dim, T> &);
+    using ConstraintGroup_t = ConstraintGroup<Dim, T>;
+    using IndexedDistanceSet_t = IndexedDistanceSet<Dim, T>;
+    using Force_t = Force<Particles>;
+    using particle_cb_fn = void (*)(Particle_ref);
+    using force_cb_fn = Vec_t (*)(Particle_ref);
     using user_cb_fn = void (*)(void);
 public:
-    void addParticles(contiguous_range<Particle_t> _particles) { particles = _particles; }
-    void addConstraints(contiguous_range<std::reference_wrapper<Constraint_t>> _constraints) { constraints = _constraints; }
+    void addParticles(Particles _particles) 
+    { 
+        particles = _particles; 
+        sleepGraphValid = false;
+        islands.invalidate();
+        if (interpolate)
+            resetPreviousPositions();
+    }
+    void addConstraints(contiguous_range<std::reference_wrapper<Constraint_t>> _constraints) 
+    { 
+        constraints = _constraints; 
+        invalidateColouring();
+    }
+    // typed constraint storage such as a ConstraintSet, solved after the range above
+    void addConstraints(ConstraintGroup_t &group) 
+    { 
+        constraintGroups.push_back(&group); 
+        sleepGraphValid = false;
+    }
+    // index based constraints, resolved against particles
+    void addConstraints(IndexedDistanceSet_t &set) 
+    { 
+        indexedConstraints.push_back(&set); 
+        sleepGraphValid = false;
+        islands.invalidate();
+        jacobi.invalidate();
+        implicit.invalidate();
+    }
+    // call if the constraints in the added range or indexed sets change, or a
+    // particle becomes static or dynamic, so the colouring, sleep connectivity
+    // and islands are rebuilt
+    void invalidateColouring() 
+    { 
+        colouring.invalidate(); 
+        sleepGraphValid = false;
+        islands.invalidate();
+        jacobi.invalidate();
+        implicit.invalidate();
+    }
+    void setSolverMode(SolverMode mode) { solverMode = mode; }
+    // with an executor the per-particle phases and coloured and Jacobi solves are split into
+    // chunks of grainSize; force, position and user callbacks must then be thread safe
+    void setExecutor(Executor *e) { executor = e; }
+    void setGrainSize(std::size_t grain) { grainSize = grain; }
     void setForceCB(force_cb_fn cb) { force_cb = cb; } 
+    // register a force, either a callable returning the force on one particle or
+    // one taking (particles, begin, end) that adds to the force accumulators.
+    // Applied to each span of particles before velocity integration.
+    template <typename F>
+    Force_t &addForce(F force) { return forces.add(std::move(force)); }
+    void removeForce(const Force_t &force) { forces.remove(force); }
     void setUserCB(user_cb_fn cb) { user_cb = cb; } 
     void setPositionCB(particle_cb_fn cb) { position_handler = cb; }
     void setGravity(Vec_t g) { gravity = g; }
     void setDamping(T d) { damping = d; }
+    // at most n sub-steps per call to step, whatever dt is; 0 for no limit, the default
+    void setMaxSubSteps(int n) { governor.maxSubSteps = n; }
+    // seconds of wall time a call to step may spend, 0 for no limit
+    void setStepBudget(T seconds) { governor.budget = seconds; }
+    void setOverloadPolicy(OverloadPolicy policy) { governor.policy = policy; }
+    void setClock(typename StepGovernor<T>::clock_fn clock) { governor.clock = clock; }
+    // keep the positions from before the last sub-step so rendering can blend
+    // towards the current ones by alpha()
+    void setInterpolation(bool enable)
+    {
+        interpolate = enable;
+        if (enable)
+            resetPreviousPositions();
+    }
+    // fraction of a sub-step the accumulator holds, in [0, 1)
+    T alpha() const { return dtAccumulator / stepSize; }
+    // position of particle i blended alpha of the way from where it was before
+    // the last sub-step to where it is now. A particle moved by the position
+    // callback, e.g. wrapped, blends across the jump.
+    Vec_t interpolatedPosition(std::size_t i) const
+    {
+        const Vec_t current = particles[i].position;
+        if (!interpolate || previousSize != particles.size() || (sleeping && sleepGraphValid && sleep.isAsleep(i)))
+            return current;
+        const T a = alpha();
+        Vec_t blended;
+        for (int axis = 0; axis < Dim; ++axis)
+        {
+            const T previous = previousPosition[axis][i];
+            blended[axis] = previous + (current[axis] - previous) * a;
+        }
+        return blended;
+    }
+    // after every call to step, write the interpolated positions to sink and
+    // publish them, e.g. to a SnapshotBuffer read from another thread
+    void setSnapshotSink(SnapshotSink<Dim, T> *sink)
+    {
+        snapshotSink = sink;
+        snapshotFrame = 0;
+    }
+    SnapshotSink<Dim, T> *getSnapshotSink() const { return snapshotSink; }
+    // attach sink in place of the current one, which is returned, and carry on
+    // numbering frames from where it left off
+    SnapshotSink<Dim, T> *swapSnapshotSink(SnapshotSink<Dim, T> *sink)
+    {
+        SnapshotSink<Dim, T> *old = snapshotSink;
+        snapshotSink = sink;
+        return old;
+    }
+    // interpolatedPosition of every particle, written to out[0, particles.size())
+    void copyInterpolatedPositions(contiguous_range<Vec_t> out) const
+    {
+        const std::size_t n = out.size() < particles.size() ? out.size() : particles.size();
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = interpolatedPosition(i);
+    }
+    // Forces added with Particle::applyForce between steps are integrated by
+    // default. Turning this off skips reading the accumulator each step, and
+    // applyForce is then ignored; turning it back on drops what was applied
+    // while it was off.
+    void setForceAccumulation(bool accumulate)
+    {
+        if (accumulate && !accumulateForces)
+            for (std::size_t i = 0; i < particles.size(); ++i)
+                particles[i].forceAccumulator = Vec_t{};
+        accumulateForces = accumulate;
+    }
+    // skip integrating and solving particles that have come to rest, see SleepState
+    void setSleeping(bool enable) 
+    { 
+        if (sleeping && !enable)
+            storeActiveImpulses();
+        sleeping = enable; 
+        sleepGraphValid = false;
+        groupsFiltered = false;
+    }
+    // Stop a sub-step's constraint iterations once a pass corrects no velocity
+    // error above tolerance, so iterationCount becomes a cap. 0 always runs
+    // iterationCount passes. In Islands mode each island stops on its own. In
+    // XPBD mode the errors are distances rather than velocities.
+    void setSolverTolerance(T tolerance) { solverTolerance = tolerance; }
+    T getSolverTolerance() const { return solverTolerance; }
+    // measure every pass for residualHistory even without a tolerance
+    void setResidualTracking(bool enable) { trackResiduals = enable; }
+    // the residual of each pass of the last sub-step, when measured. In Islands
+    // mode pass k covers pass k of every island that ran it.
+    const std::vector<SolverResidual<T>> &residualHistory() const { return residuals; }
+    // Start each sub-step's solve from factor times the impulse every distance
+    // constraint applied in the last one, so stiff constraints need fewer
+    // iterations to hold. 0 turns it off. Around 0.5 is safe at any iteration
+    // count; nearer 1 holds best with one or two iterations but can go unstable
+    // with more. Not used in XPBD mode.
+    void setWarmStarting(T factor) { warmStartFactor = factor; }
+    T getWarmStarting() const { return warmStartFactor; }
+    void setSleepThreshold(T energy) { sleep.threshold = energy; }
+    void setSleepWindow(std::uint32_t steps) { sleep.window = steps; }
+    // true if the island is asleep; islands are numbered as in World::islands
+    bool isIslandAsleep(std::size_t island) const
+    {
+        return sleeping && sleepGraphValid && sleep.isAsleep(islands.particles(island)[0]);
+    }
+    // wake particle i and its neighbours, e.g. after moving it or changing its
+    // velocity by hand; nothing else notices a sleeping particle being changed
+    void wake(std::size_t i)
+    {
+        if (sleeping && sleepGraphValid)
+            sleep.wake(i);
+    }
+    // apply an impulse to particle i, waking it and its neighbours
+    void applyImpulse(std::size_t i, const Vec_t &impulse)
+    {
+        wake(i);
+        particles[i].applyImpulse(impulse);
+    }
+    // advance by dt in fixed sub-steps of stepSize, as many as the governor allows
     void step(T dt)
     {
-        static T prevDt = stepSize;
+        if (tickRate != 0)
+        {
+            // whole ticks go to stepTicks, the fraction is carried to the next call
+            stepTicks(detail::whole_ticks(dt, tickRate, tickCarry));
+            return;
+        }
+        MP_PROFILE_SCOPE(profiler, Step);
+
         dtAccumulator += dt;
-        bool didUpdate = false;
-        while (dtAccumulator >= stepSize)
+        // beyond this many sub-steps every policy drops the time, so stop counting
+        const int countLimit = governor.countLimit();
+        int needed = 0;
+        T remaining = dtAccumulator;
+        while (remaining >= stepSize && needed < countLimit)
+        {
+            remaining -= stepSize;
+            ++needed;
+        }
+        T skipped = 0;
+        if (remaining >= stepSize)
+        {
+            skipped = remaining - std::fmod(remaining, stepSize);
+            remaining -= skipped;
+        }
+        // time for dropped sub-steps goes with the rest
+        dtAccumulator = remaining;
+        runSubSteps(needed, skipped);
+    }
+    // Count time in whole ticks of 1 / rate seconds rather than accumulating
+    // floating point dt, so the sub-steps run depend only on the ticks passed to
+    // stepTicks. Pick a rate at which stepSize is a whole number of ticks. 0 to
+    // go back to floating point time.
+    void setTickRate(std::uint32_t rate)
+    {
+        tickRate = rate;
+        tickAccumulator = 0;
+        tickCarry = 0;
+        dtAccumulator = 0;
+    }
+    std::uint32_t getTickRate() const { return tickRate; }
+    // whole ticks per sub-step at the current stepSize and tick rate
+    std::uint32_t ticksPerStep() const
+    {
+        const T ticks = stepSize * static_cast<T>(tickRate) + T(0.5);
+        T carry = 0;
+        return ticks < T(1) ? 1 : detail::whole_ticks(ticks, 1, carry);
+    }
+    // advance by ticks on the integer time base set by setTickRate
+    void stepTicks(std::uint32_t ticks)
+    {
+        MP_PROFILE_SCOPE(profiler, Step);
+        const std::uint32_t perStep = ticksPerStep();
+        tickAccumulator += ticks;
+        const std::uint64_t whole = tickAccumulator / perStep;
+        tickAccumulator -= whole * perStep;
+        const std::uint64_t countLimit = static_cast<std::uint64_t>(governor.countLimit());
+        const int needed = static_cast<int>(whole < countLimit ? whole : countLimit);
+        const T skipped = static_cast<T>(whole - static_cast<std::uint64_t>(needed)) * stepSize;
+        dtAccumulator = static_cast<T>(tickAccumulator) / static_cast<T>(tickRate);
+        runSubSteps(needed, skipped);
+    }
+
+    Particles particles;
+    contiguous_range<std::reference_wrapper<Constraint_t>> constraints;
+    std::vector<ConstraintGroup_t *> constraintGroups;
+    std::vector<IndexedDistanceSet_t *> indexedConstraints;
+    ConstraintColouring<Dim, T> colouring;
+    SolverMode solverMode = SolverMode::GaussSeidel;
+    Executor *executor = nullptr;
+    std::size_t grainSize = 256;
+    force_cb_fn force_cb = nullptr;
+    ForceRegistry<Particles> forces;
+    particle_cb_fn position_handler = nullptr;
+    user_cb_fn user_cb = nullptr;
+    Vec_t gravity{};
+    int iterationCount = 5;
+    T timeStretch = 1.0;
+    T stepSize = 0.01;
+    T damping = 0.3;
+    T dtAccumulator{}; 
+    // with a tick rate, whole ticks not yet stepped and the fraction of one carried by step
+    std::uint64_t tickAccumulator = 0;
+    T tickCarry{};
+    // whether the last sub-step kept the constraints' impulses for warm starting
+    bool warmStarted = false;
+    bool accumulateForces = true;
+    bool sleeping = false;
+    SleepState<Dim, T> sleep;
+    Islands<Dim, T> islands;
+    // averaging and relaxation of SolverMode::Jacobi
+    JacobiSolver<Dim, T> jacobi;
+    // conjugate gradient settings of SolverMode::Implicit
+    ImplicitSolver<Dim, T> implicit;
+    StepGovernor<T> governor;
+    StepStatus<T> status;
+#ifdef MP_USE_PROFILE
+    // phase times and counts of every step, see utility/profile.hpp
+    Profiler profiler;
+#endif
+
+private:
+    // run the sub-steps the governor allows of needed, then report and publish
+    void runSubSteps(int needed, T skipped)
+    {
+        const typename StepGovernor<T>::Plan plan = governor.plan(needed, iterationCount);
+        int iterationsRun = 0;
+        if (plan.subSteps > 0)
         {
-            didUpdate = true;
-            // apply gravity, damping and user forces to all particles
-            // then integtrate tentative velocity
-            for (Particle_t &particle : particles)
-            {           
-                if (particle.inverseMass != T{})
-                    particle.applyForce(gravity / particle.inverseMass);
+            const std::uint32_t start = governor.clock();
+            for (int s = 0; s < plan.subSteps; ++s)
+                iterationsRun += subStep(stepSize * timeStretch * plan.stretch, plan.iterations);
+            governor.record(governor.clock() - start, plan, iterationCount);
+        }
 
-                particle.applyForce(-damping * particle.linearVelocity);
+        status.subSteps = plan.subSteps;
+        status.neededSubSteps = needed;
+        status.iterations = plan.iterations;
+        status.iterationsRun = iterationsRun;
+        status.stretch = plan.stretch;
+        status.droppedTime = plan.droppedSteps * stepSize + skipped;
+        status.subStepCost = governor.subStepCost();
+        status.overloaded = plan.overloaded || skipped > T(0);
+        if (status.overloaded)
+            ++status.overloadCount;
+        MP_PROFILE_COUNT(profiler, Steps, 1);
+        MP_PROFILE_COUNT(profiler, SubSteps, plan.subSteps);
+        MP_PROFILE_COUNT(profiler, Iterations, iterationsRun);
 
-                if (force_cb)
-                    particle.applyForce(force_cb(particle));
+        if (snapshotSink != nullptr)
+            publishSnapshot();
+    }
+
+    // one fixed step of length dt with up to the given number of constraint
+    // iterations, returning how many ran
+    int subStep(T dt, int iterations)
+    {
+        MP_PROFILE_SCOPE(profiler, SubStep);
+        if (sleeping)
+            prepareSleep();
 
-                particle.integrateVelocity(stepSize * timeStretch);
+        // apply gravity, damping and user forces to all particles
+        // then integtrate tentative velocity
+        {
+            MP_PROFILE_SCOPE(profiler, Forces);
+            forEachAwake([&](std::size_t begin, std::size_t end) {
+                forces.apply(particles, begin, end);
+                integrateVelocities(particles, begin, end, dt);
+            });
+        }
+        
+        // post-integration user callback
+        if (user_cb != nullptr)
+        {
+            MP_PROFILE_SCOPE(profiler, UserCallback);
+            user_cb();
+        }
+        
+        int iterationsRun;
+        if (solverMode == SolverMode::XPBD)
+        {
+            // the multipliers replace the cached impulses
+            warmStarted = false;
+            predictPositions(dt);
+            iterationsRun = solvePositions(dt, iterations);
+            updateVelocities(dt);
+        }
+        else
+        {
+            if (solverMode == SolverMode::Implicit)
+                integrateSprings(dt);
+            iterationsRun = solveConstraints(dt, iterations);
+            integratePositions(dt);
+        }
+
+        if (sleeping)
+            sleep.update(particles);
+        return iterationsRun;
+    }
+
+    // solve constraints iteratively, stopping early once within solverTolerance
+    int solveConstraints(T dt, int iterations)
+    {
+        MP_PROFILE_SCOPE(profiler, Constraints);
+        T iterationDt = dt / static_cast<T>(iterations);
+        // with sleeping only constraints touching an awake particle are solved
+        contiguous_range<std::reference_wrapper<Constraint_t>> solving = sleeping ? 
+            contiguous_range<std::reference_wrapper<Constraint_t>>(activeConstraints) : constraints;
+        const bool measure = solverTolerance > T(0) || trackResiduals;
+        residuals.clear();
+        // switching warm starting on or off runs one pass with factor 0 to
+        // clear impulses cached while it was off
+        const bool warm = warmStartFactor > T(0) || warmStarted;
+        const T factor = warmStarted ? warmStartFactor : T(0);
+        warmStarted = warmStartFactor > T(0);
+        if (!warm)
+            dropIndexedImpulses();
+        const int islandPasses = solverMode == SolverMode::Islands ? solveIslands(dt, iterations, warm, factor, measure) : 0;
+        if (solverMode != SolverMode::Islands && warm)
+            warmStart(solving, factor);
+        int i = 0;
+        while (i < iterations)
+        {
+            MP_PROFILE_SCOPE(profiler, Iteration);
+            SolverResidual<T> residual;
+            SolverResidual<T> *r = measure ? &residual : nullptr;
+            if (solverMode == SolverMode::Islands)
+            {
+                for (Constraint_t *constraint : islands.loose())
+                {
+                    const T error = constraint->solve(iterationDt);
+                    if (r != nullptr)
+                        r->add(error);
+                }
             }
-            
-            // post-integration user callback
-            if (user_cb != nullptr)
-                user_cb();
-            
-            // solve constraints iteratively
-            T iterationDt = (stepSize * timeStretch) / static_cast<T>(iterationCount);
-            for (int i = 0; i < iterationCount; ++i)
+            else if (solverMode == SolverMode::Coloured)
             {
-                for (Constraint_t &constraint : constraints)
+                solveColoured(solving, iterationDt, r);
+            }
+            else if (r == nullptr)
+            {
+                for (Constraint_t &constraint : solving)
                 {
                    constraint.solve(iterationDt);
                 }
             }
+            else
+            {
+                for (Constraint_t &constraint : solving)
+                    r->add(constraint.solve(iterationDt));
+            }
+            Executor *groupExecutor = solverMode == SolverMode::Coloured ? executor : nullptr;
+            solveGroups(iterationDt, groupExecutor, r);
+            for (std::size_t s = 0; s < indexedConstraints.size() && solverMode != SolverMode::Islands; ++s)
+            {
+                IndexedDistanceSet_t &set = sleeping ? activeIndexed[s] : *indexedConstraints[s];
+                if (isImplicitSpring(set))
+                    continue;
+                if (solverMode == SolverMode::Jacobi)
+                    jacobi.solve(s, set, particles, iterationDt, executor, grainSize, r);
+                else
+                    set.solve(particles, iterationDt, groupExecutor, grainSize, r);
+            }
+            ++i;
+            if (measure)
+            {
+                // the islands may already have filled this pass
+                if (residuals.size() < static_cast<std::size_t>(i))
+                    residuals.push_back(residual);
+                else
+                    residuals[i - 1].merge(residual);
+                if (solverTolerance > T(0) && residual.max <= solverTolerance)
+                    break;
+            }
+        }
+        return i > islandPasses ? i : islandPasses;
+    }
 
-            // integrate positions and call user position fn
-            for (Particle_t &particle : particles)
+    // integrate positions and call user position fn
+    void integratePositions(T dt)
+    {
+        MP_PROFILE_SCOPE(profiler, Integrate);
+        if (interpolate && previousSize != particles.size())
+            resetPreviousPositions();
+        forEachAwake([&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
             {
-                particle.integratePosition(stepSize * timeStretch);
+                Particle_ref particle = particles[i];
+                if (interpolate)
+                    for (int axis = 0; axis < Dim; ++axis)
+                        previousPosition[axis][i] = particle.position[axis];
+                particle.integratePosition(dt);
                 if (position_handler)
-                    position_handler(particle);
+                    MP_PROFILE_CALL(profiler, PositionHandler, position_handler(particle));
             }
+        });
+    }
+
+    // the springs ImplicitSolver steps rather than the iterative solve
+    bool isImplicitSpring(const IndexedDistanceSet_t &set) const
+    {
+        return solverMode == SolverMode::Implicit && set.compliance > T(0);
+    }
 
-            dtAccumulator -= stepSize;
+    // Implicit: backward Euler velocity change of the springs in the indexed sets
+    void integrateSprings(T dt)
+    {
+        MP_PROFILE_SCOPE(profiler, Constraints);
+        implicitSets.clear();
+        for (std::size_t s = 0; s < indexedConstraints.size(); ++s)
+            implicitSets.push_back(sleeping ? &activeIndexed[s] : indexedConstraints[s]);
+        implicit.solve(implicitSets, particles, dt, executor, grainSize);
+    }
+
+    // XPBD: move every particle by its velocity, remembering where it started
+    void predictPositions(T dt)
+    {
+        MP_PROFILE_SCOPE(profiler, Integrate);
+        if (interpolate && previousSize != particles.size())
+            resetPreviousPositions();
+        for (int axis = 0; axis < Dim; ++axis)
+            startPosition[axis].resize(particles.size());
+        forEachAwake([&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                Particle_ref particle = particles[i];
+                for (int axis = 0; axis < Dim; ++axis)
+                    startPosition[axis][i] = particle.position[axis];
+                if (interpolate)
+                    for (int axis = 0; axis < Dim; ++axis)
+                        previousPosition[axis][i] = particle.position[axis];
+                particle.integratePosition(dt);
+            }
+        });
+    }
+
+    // XPBD: project the predicted positions onto the constraints, stopping early
+    // once within solverTolerance
+    int solvePositions(T dt, int iterations)
+    {
+        MP_PROFILE_SCOPE(profiler, Constraints);
+        contiguous_range<std::reference_wrapper<Constraint_t>> solving = sleeping ? 
+            contiguous_range<std::reference_wrapper<Constraint_t>>(activeConstraints) : constraints;
+        const bool measure = solverTolerance > T(0) || trackResiduals;
+        residuals.clear();
+        for (Constraint_t &constraint : solving)
+            constraint.resetMultiplier();
+        for (ConstraintGroup_t *group : constraintGroups)
+            group->resetMultipliers();
+        for (std::size_t s = 0; s < indexedConstraints.size(); ++s)
+            (sleeping ? activeIndexed[s] : *indexedConstraints[s]).resetMultipliers();
+
+        int i = 0;
+        while (i < iterations)
+        {
+            MP_PROFILE_SCOPE(profiler, Iteration);
+            SolverResidual<T> residual;
+            SolverResidual<T> *r = measure ? &residual : nullptr;
+            if (executor != nullptr)
+            {
+                solveColouredPositions(solving, dt, r);
+            }
+            else
+            {
+                for (Constraint_t &constraint : solving)
+                {
+                    const T error = constraint.solvePosition(dt);
+                    if (r != nullptr)
+                        r->add(error);
+                }
+            }
+            solveGroupPositions(dt, r);
+            for (std::size_t s = 0; s < indexedConstraints.size(); ++s)
+            {
+                IndexedDistanceSet_t &set = sleeping ? activeIndexed[s] : *indexedConstraints[s];
+                set.solvePositions(particles, dt, executor, grainSize, r);
+            }
+            ++i;
+            if (measure)
+            {
+                residuals.push_back(residual);
+                if (solverTolerance > T(0) && residual.max <= solverTolerance)
+                    break;
+            }
         }
-        
-        if (didUpdate)
+        return i;
+    }
+
+    // XPBD: velocity from how far each particle moved, then the position callback
+    void updateVelocities(T dt)
+    {
+        MP_PROFILE_SCOPE(profiler, Integrate);
+        const T inverseDt = T(1) / dt;
+        forEachAwake([&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                Particle_ref particle = particles[i];
+                for (int axis = 0; axis < Dim; ++axis)
+                    particle.linearVelocity[axis] = (particle.position[axis] - startPosition[axis][i]) * inverseDt;
+                if (position_handler)
+                    MP_PROFILE_CALL(profiler, PositionHandler, position_handler(particle));
+            }
+        });
+    }
+
+    void publishSnapshot()
+    {
+        MP_PROFILE_SCOPE(profiler, Snapshot);
+        Snapshot<Dim, T> &snapshot = snapshotSink->writeBuffer();
+        snapshot.frame = snapshotFrame++;
+        snapshot.alpha = alpha();
+        snapshot.positions.resize(particles.size());
+        copyInterpolatedPositions({snapshot.positions});
+        snapshotSink->publish();
+    }
+
+    void resetPreviousPositions()
+    {
+        previousSize = particles.size();
+        for (int axis = 0; axis < Dim; ++axis)
         {
-            T diff = dt - prevDt;
-            isDeathSpiralling = diff > stepSize;
-            prevDt = dt;
+            previousPosition[axis].resize(previousSize);
+            for (std::size_t i = 0; i < previousSize; ++i)
+                previousPosition[axis][i] = particles[i].position[axis];
         }
+    }
 
+    // run fn(begin, end) over every particle, or only the awake runs when sleeping
+    template <typename Fn>
+    void forEachAwake(Fn &&fn)
+    {
+        if (!sleeping)
+        {
+            parallel_for(executor, 0, particles.size(), grainSize, fn);
+            return;
+        }
+        for (const typename SleepState<Dim, T>::run &r : sleep.awakeRuns())
+            parallel_for(executor, r.first, r.second, grainSize, fn);
+    }
 
+    // connect particles through the constraint range, the constraint groups and
+    // the indexed sets. Constraints with a particle not in particles are always
+    // solved, and the other particle is a touch point.
+    void buildSleepGraph()
+    {
+        sleep.reset(particles);
+        findConstraintEnds();
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+            track(constraints[i], constraintEnds[i]);
+        groupConstraints.clear();
+        groupEnds.clear();
+        groupRevisions.clear();
+        for (ConstraintGroup_t *group : constraintGroups)
+        {
+            group->collect(groupConstraints);
+            groupRevisions.push_back(group->revision());
+        }
+        for (Constraint_t *constraint : groupConstraints)
+        {
+            groupEnds.push_back(ends(*constraint));
+            track(*constraint, groupEnds.back());
+        }
+        for (IndexedDistanceSet_t *set : indexedConstraints)
+            for (const typename IndexedDistanceSet_t::Constraint_t &c : set->constraints)
+                sleep.connect(c.p1, c.p2);
+        sleep.buildNeighbours();
+        sleepGraphValid = true;
+    }
 
-    }     
+    void track(Constraint_t &constraint, const std::pair<std::uint32_t, std::uint32_t> &e)
+    {
+        std::uint32_t i;
+        if (e.first != untracked)
+            sleep.connect(e.first, e.second);
+        else if (detail::particle_index(particles, constraint.p1, i) || detail::particle_index(particles, constraint.p2, i))
+            sleep.touch(i);
+    }
 
-    contiguous_range<Particle_t> particles;
-    contiguous_range<std::reference_wrapper<Constraint_t>> constraints;
-    force_cb_fn force_cb = nullptr;
-    particle_cb_fn position_handler = nullptr;
-    user_cb_fn user_cb = nullptr;
-    Vec_t gravity{};
-    int iterationCount = 5;
-    T timeStretch = 1.0;
-    T stepSize = 0.01;
-    T damping = 0.3;
-    T dtAccumulator{}; 
-    bool isDeathSpiralling = false;
+    // particle indices of each range constraint
+    void findConstraintEnds()
+    {
+        constraintEnds.clear();
+        for (Constraint_t &constraint : constraints)
+            constraintEnds.push_back(ends(constraint));
+    }
+
+    std::pair<std::uint32_t, std::uint32_t> ends(Constraint_t &constraint)
+    {
+        std::uint32_t a, b;
+        if (detail::particle_index(particles, constraint.p1, a) && detail::particle_index(particles, constraint.p2, b))
+            return {a, b};
+        return {untracked, untracked};
+    }
+
+    bool groupsChanged() const
+    {
+        if (groupRevisions.size() != constraintGroups.size())
+            return true;
+        for (std::size_t g = 0; g < constraintGroups.size(); ++g)
+            if (groupRevisions[g] != constraintGroups[g]->revision())
+                return true;
+        return false;
+    }
+
+    bool isActive(std::uint32_t a, std::uint32_t b) const
+    {
+        return a == untracked || !sleep.isResting(a) || !sleep.isResting(b);
+    }
+
+    // wake disturbed particles and refresh the lists of constraints to solve
+    void prepareSleep()
+    {
+        // Islands solves the indexed sets themselves, not the filtered copies:
+        // keep what was solved before switching, and refilter once it ends
+        const bool islandsSolve = solverMode == SolverMode::Islands;
+        if (islandsSolve)
+            storeActiveImpulses();
+        bool rebuild = !islandsSolve && activeIndexedStale;
+        activeIndexedStale = islandsSolve;
+        if (!sleepGraphValid || groupsChanged())
+        {
+            buildSleepGraph();
+            rebuild = true;
+        }
+        sleep.wakeDisturbed(particles);
+        if (sleep.takeChanged() || rebuild)
+        {
+            activeConstraints.clear();
+            for (std::size_t i = 0; i < constraints.size(); ++i)
+                if (isActive(constraintEnds[i].first, constraintEnds[i].second))
+                    activeConstraints.push_back(constraints[i]);
+            colouring.invalidate();
+            activeGroupConstraints.clear();
+            for (std::size_t i = 0; i < groupConstraints.size(); ++i)
+                if (isActive(groupEnds[i].first, groupEnds[i].second))
+                    activeGroupConstraints.push_back(groupConstraints[i]);
+            groupsFiltered = activeGroupConstraints.size() != groupConstraints.size();
+
+            // the rebuilt sets carry on from the impulses cached so far
+            storeActiveImpulses();
+            activeIndexed.resize(indexedConstraints.size());
+            jacobi.invalidate();
+            implicit.invalidate();
+            for (std::size_t s = 0; s < indexedConstraints.size(); ++s)
+            {
+                IndexedDistanceSet_t &active = activeIndexed[s];
+                const IndexedDistanceSet_t &source = *indexedConstraints[s];
+                const bool cached = source.cachesImpulses();
+                active.clear();
+                for (std::size_t i = 0; i < source.constraints.size(); ++i)
+                {
+                    const typename IndexedDistanceSet_t::Constraint_t &c = source.constraints[i];
+                    if (!isActive(c.p1, c.p2))
+                        continue;
+                    active.add(c.p1, c.p2, c.length);
+                    if (cached)
+                        active.impulses.push_back(source.impulses[i]);
+                }
+            }
+        }
+        activeIndexedSolved = !islandsSolve;
+        // parameters may change between steps
+        for (std::size_t s = 0; s < indexedConstraints.size(); ++s)
+        {
+            activeIndexed[s].strength = indexedConstraints[s]->strength;
+            activeIndexed[s].biasFactor = indexedConstraints[s]->biasFactor;
+            activeIndexed[s].compliance = indexedConstraints[s]->compliance;
+            activeIndexed[s].wrapRange = indexedConstraints[s]->wrapRange;
+        }
+    }
+
+    // copy the impulses cached in the active sets back to the sets they were
+    // filtered from, matching constraints by their particles. Nothing is copied
+    // unless the active sets were solved since they were filtered.
+    void storeActiveImpulses()
+    {
+        if (!activeIndexedSolved)
+            return;
+        activeIndexedSolved = false;
+        for (std::size_t s = 0; s < activeIndexed.size() && s < indexedConstraints.size(); ++s)
+        {
+            if (!activeIndexed[s].cachesImpulses())
+                continue;
+            indexedConstraints[s]->cacheImpulses();
+            const std::vector<typename IndexedDistanceSet_t::Constraint_t> &source = indexedConstraints[s]->constraints;
+            std::vector<T> &impulses = indexedConstraints[s]->impulses;
+            const std::vector<T> &activeImpulses = activeIndexed[s].impulses;
+            sourceOrder.clear();
+            for (std::size_t i = 0; i < source.size(); ++i)
+                sourceOrder.emplace_back(key(source[i]), static_cast<std::uint32_t>(i));
+            std::sort(sourceOrder.begin(), sourceOrder.end());
+            for (std::size_t i = 0; i < activeIndexed[s].constraints.size(); ++i)
+            {
+                const std::uint64_t k = key(activeIndexed[s].constraints[i]);
+                auto it = std::lower_bound(sourceOrder.begin(), sourceOrder.end(), std::make_pair(k, std::uint32_t{0}));
+                for (; it != sourceOrder.end() && it->first == k; ++it)
+                    impulses[it->second] = activeImpulses[i];
+            }
+        }
+    }
+
+    // free the impulses of the indexed sets while warm starting is off
+    void dropIndexedImpulses()
+    {
+        for (IndexedDistanceSet_t *set : indexedConstraints)
+            set->dropImpulses();
+        for (IndexedDistanceSet_t &set : activeIndexed)
+            set.dropImpulses();
+    }
+
+    static std::uint64_t key(const typename IndexedDistanceSet_t::Constraint_t &c)
+    {
+        return (static_cast<std::uint64_t>(c.p1) << 32) | c.p2;
+    }
+
+    // the constraint groups, or when some are resting only the constraints
+    // touching an awake particle, one virtual call each
+    void solveGroups(T dt, Executor *e, SolverResidual<T> *residual)
+    {
+        if (!groupsFiltered)
+        {
+            for (ConstraintGroup_t *group : constraintGroups)
+                group->solve(dt, e, grainSize, residual);
+            return;
+        }
+        for (Constraint_t *constraint : activeGroupConstraints)
+        {
+            const T error = constraint->solve(dt);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+    }
+
+    void warmStartGroups(T factor, Executor *e)
+    {
+        if (!groupsFiltered)
+        {
+            for (ConstraintGroup_t *group : constraintGroups)
+                group->warmStart(factor, e, grainSize);
+            return;
+        }
+        for (Constraint_t *constraint : activeGroupConstraints)
+            constraint->warmStart(factor);
+    }
+
+    void solveGroupPositions(T dt, SolverResidual<T> *residual)
+    {
+        if (!groupsFiltered)
+        {
+            for (ConstraintGroup_t *group : constraintGroups)
+                group->solvePositions(dt, executor, grainSize, residual);
+            return;
+        }
+        for (Constraint_t *constraint : activeGroupConstraints)
+        {
+            const T error = constraint->solvePosition(dt);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+    }
+
+    // Gravity, damping and the force callback go straight into velocity as an
+    // acceleration. The force accumulator is read and cleared unless force
+    // accumulation was turned off and no registered forces are summed into it.
+    template <typename P>
+    void integrateVelocities(P &ps, std::size_t begin, std::size_t end, T dt)
+    {
+        const bool useAccumulator = accumulateForces || !forces.empty();
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            Particle_ref particle = ps[i];
+            const T inverseMass = particle.inverseMass;
+            if (inverseMass == T{})
+            {
+                // called for every particle, though a static one does not move
+                if (force_cb)
+                    MP_PROFILE_CALL(profiler, ForceCallback, force_cb(particle));
+                if (useAccumulator)
+                    particle.forceAccumulator = Vec_t{};
+                continue;
+            }
+
+            Vec_t acceleration = gravity - particle.linearVelocity * (damping * inverseMass);
+            if (force_cb)
+                acceleration += MP_PROFILE_CALL(profiler, ForceCallback, force_cb(particle)) * inverseMass;
+            if (useAccumulator)
+            {
+                acceleration += particle.forceAccumulator * inverseMass;
+                particle.forceAccumulator = Vec_t{};
+            }
+            particle.linearVelocity += acceleration * dt;
+        }
+    }
+
+    // SoA storage with no force callback: one pass per velocity axis over plain
+    // arrays, which the compiler can vectorise
+    void integrateVelocities(typename ParticleStore<Dim, T>::range &ps, std::size_t begin, std::size_t end, T dt)
+    {
+        if (force_cb)
+        {
+            integrateVelocities<typename ParticleStore<Dim, T>::range>(ps, begin, end, dt);
+            return;
+        }
+
+        const bool useAccumulator = accumulateForces || !forces.empty();
+        const T *inverseMass = ps.inverseMass();
+        for (int axis = 0; axis < Dim; ++axis)
+        {
+            T *velocity = ps.linearVelocity(axis);
+            const T g = gravity[axis];
+            if (useAccumulator)
+            {
+                T *force = ps.forceAccumulator(axis);
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    const T acceleration = (g - velocity[i] * (damping * inverseMass[i])) + force[i] * inverseMass[i];
+                    velocity[i] = inverseMass[i] != T{} ? velocity[i] + acceleration * dt : velocity[i];
+                    force[i] = T{};
+                }
+            }
+            else
+            {
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    const T acceleration = g - velocity[i] * (damping * inverseMass[i]);
+                    velocity[i] = inverseMass[i] != T{} ? velocity[i] + acceleration * dt : velocity[i];
+                }
+            }
+        }
+    }
+
+    // islands share no dynamic particles, so each runs all its iterations in one
+    // task. Sleeping islands are skipped whole. Returns the most passes any
+    // island ran, and when measuring fills residuals pass by pass.
+    int solveIslands(T dt, int iterations, bool warm, T factor, bool measure)
+    {
+        if (!islands.isBuiltFor(constraints, indexedConstraints))
+        {
+            findConstraintEnds();
+            islands.build(particles, constraints, constraintEnds, indexedConstraints);
+        }
+        if (warm)
+        {
+            for (Constraint_t *constraint : islands.loose())
+                constraint->warmStart(factor);
+            // allocated here, as the islands share the sets across threads
+            for (IndexedDistanceSet_t *set : indexedConstraints)
+                set->cacheImpulses();
+        }
+
+        // aim for about grainSize constraints per task
+        const std::size_t perIsland = islands.constraintCount() / std::max<std::size_t>(islands.size(), 1);
+        const std::size_t grain = std::max<std::size_t>(grainSize / std::max<std::size_t>(perIsland, 1), 1);
+        // each chunk of islands keeps its own pass count and residuals, merged
+        // in chunk order afterwards
+        const std::size_t passes = static_cast<std::size_t>(islands.maxIterations(iterations));
+        const std::size_t chunks = (islands.size() + grain - 1) / grain;
+        islandPasses.assign(chunks, 0);
+        islandResiduals.assign(measure ? chunks * passes : 0, SolverResidual<T>{});
+        parallel_for(executor, 0, islands.size(), grain, [&](std::size_t begin, std::size_t end) {
+            const std::size_t chunk = begin / grain;
+            SolverResidual<T> *history = measure ? &islandResiduals[chunk * passes] : nullptr;
+            for (std::size_t island = begin; island < end; ++island)
+            {
+                if (isIslandAsleep(island))
+                    continue;
+                if (warm)
+                    islands.warmStart(island, particles, factor);
+                const int run = islands.solve(island, particles, dt, iterations, solverTolerance, history);
+                islandPasses[chunk] = std::max(islandPasses[chunk], run);
+            }
+        });
+        int run = 0;
+        for (int p : islandPasses)
+            run = std::max(run, p);
+        if (measure)
+        {
+            residuals.assign(static_cast<std::size_t>(run), SolverResidual<T>{});
+            for (std::size_t chunk = 0; chunk < chunks; ++chunk)
+                for (int pass = 0; pass < run; ++pass)
+                    residuals[pass].merge(islandResiduals[chunk * passes + pass]);
+        }
+        return run;
+    }
+
+    // Constraint::warmStart over everything solveConstraints is about to solve
+    void warmStart(contiguous_range<std::reference_wrapper<Constraint_t>> solving, T factor)
+    {
+        if (solverMode == SolverMode::Coloured)
+        {
+            if (!colouring.isBuiltFor(solving))
+                colouring.build(solving);
+            for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+            {
+                contiguous_range<Constraint_t *> group = colouring.colour(c);
+                parallel_for(executor, 0, group.size(), grainSize, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t j = begin; j < end; ++j)
+                        group[j]->warmStart(factor);
+                });
+            }
+            for (Constraint_t *constraint : colouring.remainder())
+                constraint->warmStart(factor);
+        }
+        else
+        {
+            for (Constraint_t &constraint : solving)
+                constraint.warmStart(factor);
+        }
+        Executor *groupExecutor = solverMode == SolverMode::Coloured ? executor : nullptr;
+        warmStartGroups(factor, groupExecutor);
+        for (std::size_t s = 0; s < indexedConstraints.size(); ++s)
+        {
+            IndexedDistanceSet_t &set = sleeping ? activeIndexed[s] : *indexedConstraints[s];
+            if (isImplicitSpring(set))
+                continue;
+            if (solverMode == SolverMode::Jacobi)
+                jacobi.warmStart(s, set, particles, factor, executor, grainSize);
+            else
+                set.warmStart(particles, factor, groupExecutor, grainSize);
+        }
+    }
+
+    // solveColoured for XPBD
+    void solveColouredPositions(contiguous_range<std::reference_wrapper<Constraint_t>> solving, T dt, SolverResidual<T> *residual)
+    {
+        if (!colouring.isBuiltFor(solving))
+            colouring.build(solving);
+
+        for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+        {
+            contiguous_range<Constraint_t *> group = colouring.colour(c);
+            if (residual == nullptr)
+            {
+                parallel_for(executor, 0, group.size(), grainSize, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t j = begin; j < end; ++j)
+                        group[j]->solvePosition(dt);
+                });
+                continue;
+            }
+            detail::parallel_residual(executor, 0, group.size(), grainSize, *residual, residualSlots,
+                [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                    for (std::size_t j = begin; j < end; ++j)
+                        chunk.add(group[j]->solvePosition(dt));
+                });
+        }
+        for (Constraint_t *constraint : colouring.remainder())
+        {
+            const T error = constraint->solvePosition(dt);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+    }
+
+    // constraints within a colour share no particles, so each colour can be split
+    // across threads with the end of parallel_for acting as the barrier
+    void solveColoured(contiguous_range<std::reference_wrapper<Constraint_t>> solving, T dt, SolverResidual<T> *residual)
+    {
+        if (!colouring.isBuiltFor(solving))
+            colouring.build(solving);
+
+        for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+        {
+            contiguous_range<Constraint_t *> group = colouring.colour(c);
+            if (residual == nullptr)
+            {
+                parallel_for(executor, 0, group.size(), grainSize, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t j = begin; j < end; ++j)
+                        group[j]->solve(dt);
+                });
+                continue;
+            }
+            detail::parallel_residual(executor, 0, group.size(), grainSize, *residual, residualSlots,
+                [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                    for (std::size_t j = begin; j < end; ++j)
+                        chunk.add(group[j]->solve(dt));
+                });
+        }
+        for (Constraint_t *constraint : colouring.remainder())
+        {
+            const T error = constraint->solve(dt);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+    }
+
+    enum : std::uint32_t { untracked = Islands<Dim, T>::none };
+    bool sleepGraphValid = false;
+    std::vector<std::reference_wrapper<Constraint_t>> activeConstraints;
+    // particle indices of each range constraint, untracked if not in particles
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> constraintEnds;
+    std::vector<IndexedDistanceSet_t> activeIndexed;
+    // whether activeIndexed is what the sub-steps solve, so its impulses are
+    // newer than the source sets', and whether Islands solved the sources since
+    // activeIndexed was filtered
+    bool activeIndexedSolved = false;
+    bool activeIndexedStale = false;
+    // every constraint of the groups with its particle indices, the revision of
+    // each group when collected, and those touching an awake particle
+    std::vector<Constraint_t *> groupConstraints;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> groupEnds;
+    std::vector<std::size_t> groupRevisions;
+    std::vector<Constraint_t *> activeGroupConstraints;
+    // whether solving the groups goes through activeGroupConstraints
+    bool groupsFiltered = false;
+    // (particles, index) of the constraints of an indexed set, for storeActiveImpulses
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> sourceOrder;
+    // the indexed sets solved this sub-step, for ImplicitSolver
+    std::vector<IndexedDistanceSet_t *> implicitSets;
+    bool interpolate = false;
+    // positions before the last sub-step, one array per axis
+    std::array<std::vector<T, aligned_allocator<T>>, Dim> previousPosition;
+    // XPBD: positions at the start of the sub-step, one array per axis
+    std::array<std::vector<T, aligned_allocator<T>>, Dim> startPosition;
+    std::size_t previousSize = 0;
+    SnapshotSink<Dim, T> *snapshotSink = nullptr;
+    std::uint64_t snapshotFrame = 0;
+    T solverTolerance = 0;
+    bool trackResiduals = false;
+    T warmStartFactor = 0;
+    // residual of each pass of the last sub-step
+    std::vector<SolverResidual<T>> residuals;
+    // per-chunk residuals of a parallel solve
+    std::vector<SolverResidual<T>> residualSlots;
+    // passes run and per-pass residuals of each chunk of islands
+    std::vector<int> islandPasses;
+    std::vector<SolverResidual<T>> islandResiduals;
+    std::uint32_t tickRate = 0;
 };
 
 }
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "utility/memory.hpp"
+#include "constraints/indexed.hpp"
+#include "constraints/distance_batch.hpp"
+#include "parallel/executor.hpp"
+#include "common/vec.hpp"
+
+namespace mp {
+
+namespace detail {
+
+// one particle of Width worlds side by side, so the same particle of every
+// world in a block loads as one register
+template <int Dim, typename T, int Width>
+struct ensemble_particle
+{
+    alignas(32) T position[Dim][Width];
+    alignas(32) T linearVelocity[Dim][Width];
+    alignas(32) T inverseMass[Width];
+};
+
+template <int Dim, typename T, int Width>
+struct ensemble_parameters
+{
+    alignas(32) T gravity[Dim][Width];
+    alignas(32) T damping[Width];
+};
+
+#ifdef MP_SIMD_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// one lane at a time, with the Ops interface of the SIMD structs
+template <typename T>
+struct scalar_ops
+{
+    using scalar = T;
+    using reg = T;
+    static constexpr int width = 1;
+    static reg load(const T *p) { return *p; }
+    static void store(T *p, reg a) { *p = a; }
+    static reg zero() { return T{0}; }
+    static reg broadcast(T a) { return a; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    static reg sqrt(reg a) { return std::sqrt(a); }
+    static reg neg(reg a) { return -a; }
+    static reg greater(reg a, reg b) { return a > b ? T{1} : T{0}; }
+    static reg greaterEqual(reg a, reg b) { return a >= b ? T{1} : T{0}; }
+    static reg select(reg mask, reg a, reg b) { return mask != T{0} ? a : b; }
+};
+
+// One sub-step of a block of worlds: the same phases and operation order as
+// World::subStep with GaussSeidel over an IndexedDistanceSet, so every lane
+// matches a World stepped on its own. Always inlined into the target-specific
+// entry points below.
+template <typename Ops, int Dim, int Width>
+MP_SIMD_INLINE void ensemble_sub_step(ensemble_particle<Dim, typename Ops::scalar, Width> *particles, std::size_t count,
+    const ensemble_parameters<Dim, typename Ops::scalar, Width> &parameters, const IndexedDistanceSet<Dim, typename Ops::scalar> &set,
+    typename Ops::scalar dt, int iterations)
+{
+    using T = typename Ops::scalar;
+    using reg = typename Ops::reg;
+    const reg zero = Ops::zero();
+
+    const reg stepDt = Ops::broadcast(dt);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ensemble_particle<Dim, T, Width> &p = particles[i];
+        for (int l = 0; l < Width; l += Ops::width)
+        {
+            const reg inverseMass = Ops::load(p.inverseMass + l);
+            const reg dynamic = Ops::greater(inverseMass, zero);
+            const reg drag = Ops::mul(Ops::load(parameters.damping + l), inverseMass);
+            for (int a = 0; a < Dim; ++a)
+            {
+                const reg velocity = Ops::load(p.linearVelocity[a] + l);
+                const reg acceleration = Ops::sub(Ops::load(parameters.gravity[a] + l), Ops::mul(velocity, drag));
+                Ops::store(p.linearVelocity[a] + l, Ops::select(dynamic, Ops::add(velocity, Ops::mul(acceleration, stepDt)), velocity));
+            }
+        }
+    }
+
+    const T iterationDt = dt / static_cast<T>(iterations);
+    const reg strength = Ops::broadcast(set.strength);
+    const reg biasScale = Ops::broadcast(-(set.biasFactor / iterationDt));
+    bool wrapped = false;
+    reg wrapRange[Dim], wrapTwice[Dim], wrapShift[Dim], wrapHalf[Dim];
+    for (int a = 0; a < Dim; ++a)
+    {
+        const T range = set.wrapRange[a];
+        wrapped = wrapped || range > T{0};
+        wrapRange[a] = Ops::broadcast(range);
+        wrapTwice[a] = Ops::broadcast(range * T(2));
+        wrapShift[a] = Ops::broadcast(range * T(1.5));
+        wrapHalf[a] = Ops::broadcast(range * T(0.5));
+    }
+    for (int it = 0; it < iterations; ++it)
+    {
+        for (const IndexedDistanceConstraint<T> &c : set.constraints)
+        {
+            ensemble_particle<Dim, T, Width> &p1 = particles[c.p1];
+            ensemble_particle<Dim, T, Width> &p2 = particles[c.p2];
+
+            // Within one range of each other the outer fmod of wrapped_distance
+            // is a no-op and the inner one subtracts range at most twice, both
+            // exactly, so it can be done in vector registers. Further apart
+            // every lane goes through wrapped_distance.
+            bool near = true;
+            for (int a = 0; a < Dim && wrapped; ++a)
+                if (set.wrapRange[a] > T{0})
+                    for (int l = 0; l < Width; ++l)
+                        near &= std::abs(p1.position[a][l] - p2.position[a][l]) < set.wrapRange[a];
+            alignas(32) T relative[Dim][Width];
+            if (!near)
+                for (int a = 0; a < Dim; ++a)
+                    for (int l = 0; l < Width; ++l)
+                        relative[a][l] = set.wrapRange[a] > T{0} ?
+                            wrapped_distance<T>(set.wrapRange[a])(p1.position[a][l] - p2.position[a][l]) : p1.position[a][l] - p2.position[a][l];
+
+            const reg length = Ops::broadcast(c.length);
+            for (int l = 0; l < Width; l += Ops::width)
+            {
+                reg relativePosition[Dim];
+                for (int a = 0; a < Dim; ++a)
+                {
+                    if (!near)
+                    {
+                        relativePosition[a] = Ops::load(relative[a] + l);
+                        continue;
+                    }
+                    relativePosition[a] = Ops::sub(Ops::load(p1.position[a] + l), Ops::load(p2.position[a] + l));
+                    if (set.wrapRange[a] > T{0})
+                    {
+                        reg shifted = Ops::add(relativePosition[a], wrapShift[a]);
+                        shifted = Ops::select(Ops::greaterEqual(shifted, wrapTwice[a]), Ops::sub(shifted, wrapTwice[a]),
+                            Ops::select(Ops::greaterEqual(shifted, wrapRange[a]), Ops::sub(shifted, wrapRange[a]), shifted));
+                        relativePosition[a] = Ops::sub(shifted, wrapHalf[a]);
+                    }
+                }
+
+                const reg inverseMass1 = Ops::load(p1.inverseMass + l);
+                const reg inverseMass2 = Ops::load(p2.inverseMass + l);
+                const reg constraintMass = Ops::add(inverseMass1, inverseMass2);
+
+                reg distanceSquared = Ops::mul(relativePosition[0], relativePosition[0]);
+                for (int a = 1; a < Dim; ++a)
+                    distanceSquared = Ops::add(distanceSquared, Ops::mul(relativePosition[a], relativePosition[a]));
+                const reg distance = Ops::sqrt(distanceSquared);
+                const reg offset = Ops::mul(Ops::sub(length, distance), strength);
+
+                const reg hasLength = Ops::greater(distance, zero);
+                reg offsetDir[Dim];
+                for (int a = 0; a < Dim; ++a)
+                    offsetDir[a] = Ops::select(hasLength, Ops::div(relativePosition[a], distance), relativePosition[a]);
+
+                reg velocity1[Dim], velocity2[Dim];
+                for (int a = 0; a < Dim; ++a)
+                {
+                    velocity1[a] = Ops::load(p1.linearVelocity[a] + l);
+                    velocity2[a] = Ops::load(p2.linearVelocity[a] + l);
+                }
+                reg velocityDot = Ops::mul(Ops::sub(velocity1[0], velocity2[0]), offsetDir[0]);
+                for (int a = 1; a < Dim; ++a)
+                    velocityDot = Ops::add(velocityDot, Ops::mul(Ops::sub(velocity1[a], velocity2[a]), offsetDir[a]));
+
+                const reg bias = Ops::mul(biasScale, offset);
+                // lanes where both particles are static are left alone, as in the scalar solve
+                const reg lambda = Ops::select(Ops::greater(constraintMass, zero),
+                    Ops::div(Ops::neg(Ops::add(velocityDot, bias)), constraintMass), zero);
+                for (int a = 0; a < Dim; ++a)
+                {
+                    const reg impulse = Ops::mul(offsetDir[a], lambda);
+                    Ops::store(p1.linearVelocity[a] + l, Ops::add(velocity1[a], Ops::mul(impulse, inverseMass1)));
+                    Ops::store(p2.linearVelocity[a] + l, Ops::add(velocity2[a], Ops::mul(Ops::neg(impulse), inverseMass2)));
+                }
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ensemble_particle<Dim, T, Width> &p = particles[i];
+        for (int a = 0; a < Dim; ++a)
+            for (int l = 0; l < Width; l += Ops::width)
+                Ops::store(p.position[a] + l, Ops::add(Ops::load(p.position[a] + l), Ops::mul(Ops::load(p.linearVelocity[a] + l), stepDt)));
+    }
+}
+
+template <int Dim, typename T, int Width>
+void ensemble_sub_step_scalar(ensemble_particle<Dim, T, Width> *particles, std::size_t count,
+    const ensemble_parameters<Dim, T, Width> &parameters, const IndexedDistanceSet<Dim, T> &set, T dt, int iterations)
+{
+    ensemble_sub_step<scalar_ops<T>, Dim, Width>(particles, count, parameters, set, dt, iterations);
+}
+
+#ifdef MP_SIMD_X86
+
+template <typename T>
+using sse4_ops = typename std::conditional<std::is_same<T, float>::value, sse4_float, sse4_double>::type;
+template <typename T>
+using avx2_ops = typename std::conditional<std::is_same<T, float>::value, avx2_float, avx2_double>::type;
+
+template <int Dim, typename T, int Width>
+MP_TARGET_SSE4 void ensemble_sub_step_sse4(ensemble_particle<Dim, T, Width> *particles, std::size_t count,
+    const ensemble_parameters<Dim, T, Width> &parameters, const IndexedDistanceSet<Dim, T> &set, T dt, int iterations)
+{
+    ensemble_sub_step<sse4_ops<T>, Dim, Width>(particles, count, parameters, set, dt, iterations);
+}
+
+template <int Dim, typename T, int Width>
+MP_TARGET_AVX2 void ensemble_sub_step_avx2(ensemble_particle<Dim, T, Width> *particles, std::size_t count,
+    const ensemble_parameters<Dim, T, Width> &parameters, const IndexedDistanceSet<Dim, T> &set, T dt, int iterations)
+{
+    ensemble_sub_step<avx2_ops<T>, Dim, Width>(particles, count, parameters, set, dt, iterations);
+}
+
+#pragma GCC diagnostic pop
+
+#endif // MP_SIMD_X86
+
+} // namespace detail
+
+// Many independent worlds sharing one topology, e.g. a parameter sweep over
+// identical looped strings, stepped together. Worlds are stored in blocks of
+// lanes, one AVX register wide, with each particle's values for every world of
+// the block side by side. A sub-step then solves each constraint for the whole
+// block with one set of vector instructions, and blocks are spread across the
+// executor, each running all its sub-steps in one task.
+//
+// Each world steps as a World over the same particles and an IndexedDistanceSet
+// in GaussSeidel mode would, with its own gravity, damping and inverse masses.
+// Forces, callbacks and sleeping are per World only.
+template <int Dim, typename T>
+class WorldEnsemble
+{
+public:
+    using Vec_t = Vec<Dim, T>;
+    using IndexedDistanceSet_t = IndexedDistanceSet<Dim, T>;
+
+    // worlds per block
+    enum : int { lanes = 32 / sizeof(T) };
+
+    // worldCount worlds of particleCount particles, each at the origin with inverse mass 1
+    WorldEnsemble(std::size_t worldCount, std::size_t particleCount)
+        : worldCount(worldCount), _particleCount(particleCount),
+        blockCount((worldCount + lanes - 1) / lanes),
+        blockParticles(blockCount * particleCount), parameters(blockCount)
+    {
+        for (Block_particle &p : blockParticles)
+        {
+            for (int l = 0; l < lanes; ++l)
+            {
+                for (int a = 0; a < Dim; ++a)
+                    p.position[a][l] = p.linearVelocity[a][l] = T{};
+                // unused lanes of the last block are static, so cost nothing to solve
+                p.inverseMass[l] = std::size_t(l) < laneCount(&p - blockParticles.data()) ? T{1} : T{0};
+            }
+        }
+        for (Block_parameters &block : parameters)
+        {
+            for (int l = 0; l < lanes; ++l)
+            {
+                for (int a = 0; a < Dim; ++a)
+                    block.gravity[a][l] = T{};
+                block.damping[l] = T(0.3);
+            }
+        }
+    }
+
+    std::size_t size() const { return worldCount; }
+    std::size_t particleCount() const { return _particleCount; }
+
+    // copy position, velocity and inverse mass of particleCount particles into world w,
+    // e.g. from the storage a World would step
+    template <typename Particles>
+    void setParticles(std::size_t w, Particles &particles)
+    {
+        for (std::size_t i = 0; i < _particleCount; ++i)
+        {
+            auto &&particle = particles[i];
+            setPosition(w, i, particle.position);
+            setVelocity(w, i, particle.linearVelocity);
+            setInverseMass(w, i, particle.inverseMass);
+        }
+    }
+
+    // copy positions and velocities of world w out to particles
+    template <typename Particles>
+    void getParticles(std::size_t w, Particles &particles) const
+    {
+        for (std::size_t i = 0; i < _particleCount; ++i)
+        {
+            auto &&particle = particles[i];
+            particle.position = position(w, i);
+            particle.linearVelocity = velocity(w, i);
+        }
+    }
+
+    Vec_t position(std::size_t w, std::size_t i) const { return get(particle(w, i).position, w); }
+    Vec_t velocity(std::size_t w, std::size_t i) const { return get(particle(w, i).linearVelocity, w); }
+    T inverseMass(std::size_t w, std::size_t i) const { return particle(w, i).inverseMass[w % lanes]; }
+    void setPosition(std::size_t w, std::size_t i, const Vec_t &p) { set(particle(w, i).position, w, p); }
+    void setVelocity(std::size_t w, std::size_t i, const Vec_t &v) { set(particle(w, i).linearVelocity, w, v); }
+    void setInverseMass(std::size_t w, std::size_t i, T inverseMass) { particle(w, i).inverseMass[w % lanes] = inverseMass; }
+    void applyImpulse(std::size_t w, std::size_t i, const Vec_t &impulse)
+    {
+        setVelocity(w, i, velocity(w, i) + impulse * inverseMass(w, i));
+    }
+
+    void setGravity(std::size_t w, const Vec_t &g) { set(parameters[w / lanes].gravity, w, g); }
+    void setDamping(std::size_t w, T d) { parameters[w / lanes].damping[w % lanes] = d; }
+    // the same for every world
+    void setGravity(const Vec_t &g)
+    {
+        for (std::size_t w = 0; w < worldCount; ++w)
+            setGravity(w, g);
+    }
+    void setDamping(T d)
+    {
+        for (std::size_t w = 0; w < worldCount; ++w)
+            setDamping(w, d);
+    }
+
+    // blocks are split across the executor in chunks of grainSize blocks
+    void setExecutor(Executor *e) { executor = e; }
+    void setGrainSize(std::size_t grain) { grainSize = grain; }
+
+    // advance every world by dt in fixed sub-steps of stepSize. Time beyond
+    // maxSubSteps is dropped, as OverloadPolicy::DropTime.
+    void step(T dt)
+    {
+        dtAccumulator += dt;
+        int subSteps = 0;
+        while (dtAccumulator >= stepSize && subSteps < maxSubSteps)
+        {
+            dtAccumulator -= stepSize;
+            ++subSteps;
+        }
+        if (dtAccumulator >= stepSize)
+            dtAccumulator = std::fmod(dtAccumulator, stepSize);
+        if (subSteps == 0)
+            return;
+
+        const simd::Isa isa = simd::activeIsa();
+        parallel_for(executor, 0, blockCount, grainSize, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t block = begin; block < end; ++block)
+                for (int s = 0; s < subSteps; ++s)
+                    subStep(isa, block, stepSize);
+        });
+        completedWorldSteps += static_cast<std::uint64_t>(subSteps) * worldCount;
+    }
+
+    // sub-steps run summed over every world, for measuring world-steps per second
+    std::uint64_t worldSteps() const { return completedWorldSteps; }
+
+    // shared by every world, indexing particles [0, particleCount)
+    IndexedDistanceSet_t constraints;
+    int iterationCount = 5;
+    T stepSize = 0.01;
+    int maxSubSteps = 10;
+    T dtAccumulator{};
+
+private:
+    using Block_particle = detail::ensemble_particle<Dim, T, lanes>;
+    using Block_parameters = detail::ensemble_parameters<Dim, T, lanes>;
+
+    std::size_t laneCount(std::size_t blockParticle) const
+    {
+        const std::size_t first = blockParticle / _particleCount * lanes;
+        return worldCount - first < std::size_t(lanes) ? worldCount - first : std::size_t(lanes);
+    }
+
+    Block_particle &particle(std::size_t w, std::size_t i) { return blockParticles[w / lanes * _particleCount + i]; }
+    const Block_particle &particle(std::size_t w, std::size_t i) const { return blockParticles[w / lanes * _particleCount + i]; }
+
+    static Vec_t get(const T (&values)[Dim][lanes], std::size_t w)
+    {
+        Vec_t v;
+        for (int a = 0; a < Dim; ++a)
+            v[a] = values[a][w % lanes];
+        return v;
+    }
+    static void set(T (&values)[Dim][lanes], std::size_t w, const Vec_t &v)
+    {
+        for (int a = 0; a < Dim; ++a)
+            values[a][w % lanes] = v[a];
+    }
+
+    void subStep(simd::Isa isa, std::size_t block, T dt)
+    {
+        Block_particle *ps = blockParticles.data() + block * _particleCount;
+#ifdef MP_SIMD_X86
+        switch (isa)
+        {
+            case simd::Isa::AVX2:
+                detail::ensemble_sub_step_avx2<Dim, T, lanes>(ps, _particleCount, parameters[block], constraints, dt, iterationCount);
+                return;
+            case simd::Isa::SSE4:
+                detail::ensemble_sub_step_sse4<Dim, T, lanes>(ps, _particleCount, parameters[block], constraints, dt, iterationCount);
+                return;
+            default:
+                break;
+        }
+#endif
+        detail::ensemble_sub_step_scalar<Dim, T, lanes>(ps, _particleCount, parameters[block], constraints, dt, iterationCount);
+    }
+
+    std::size_t worldCount;
+    std::size_t _particleCount;
+    std::size_t blockCount;
+    std::vector<Block_particle, aligned_allocator<Block_particle>> blockParticles;
+    std::vector<Block_parameters, aligned_allocator<Block_parameters>> parameters;
+    Executor *executor = nullptr;
+    std::size_t grainSize = 1;
+    std::uint64_t completedWorldSteps = 0;
+};
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "constraint.hpp"
+#include "../utility/range.hpp"
+
+namespace mp {
+
+// Greedy colouring of the constraint graph: no two constraints of the same
+// colour share a particle, so each colour can be solved in parallel. Constraints
+// that would need more than maxColours colours are kept in a remainder solved
+// serially after the colours. C is the constraint type the colours point to.
+template <typename C>
+class basic_colouring
+{
+public:
+    static constexpr std::size_t maxColours = 64;
+
+    // Range is anything iterable whose elements convert to C &
+    template <typename Range>
+    void build(Range &&constraints)
+    {
+        std::vector<std::vector<C *>> colours;
+        std::unordered_map<const void *, std::uint64_t> usedColours;
+        usedColours.reserve(constraints.size() * 2);
+        _remainder.clear();
+
+        for (C &constraint : constraints)
+        {
+            std::uint64_t &used1 = usedColours[&constraint.p1];
+            std::uint64_t &used2 = usedColours[&constraint.p2];
+            const std::uint64_t used = used1 | used2;
+            if (~used == 0)
+            {
+                _remainder.push_back(&constraint);
+                continue;
+            }
+
+            std::size_t colour = 0;
+            while (used & (std::uint64_t{1} << colour))
+                ++colour;
+            if (colour == colours.size())
+                colours.emplace_back();
+            colours[colour].push_back(&constraint);
+            used1 |= std::uint64_t{1} << colour;
+            used2 |= std::uint64_t{1} << colour;
+        }
+
+        // flatten into one array indexed by colour offsets
+        _ordered.clear();
+        _ordered.reserve(constraints.size());
+        _offsets.assign(1, 0);
+        for (const std::vector<C *> &colour : colours)
+        {
+            _ordered.insert(_ordered.end(), colour.begin(), colour.end());
+            _offsets.push_back(_ordered.size());
+        }
+        valid = true;
+    }
+
+    bool isValid() const { return valid; }
+    void invalidate() { valid = false; }
+
+    std::size_t colourCount() const { return _offsets.empty() ? 0 : _offsets.size() - 1; }
+
+    contiguous_range<C *> colour(std::size_t c)
+    {
+        return {_ordered.data() + _offsets[c], _ordered.data() + _offsets[c + 1]};
+    }
+
+    contiguous_range<C *> remainder() { return {_remainder}; }
+
+protected:
+    std::vector<C *> _ordered;
+    std::vector<std::size_t> _offsets;
+    std::vector<C *> _remainder;
+    bool valid = false;
+};
+
+// colouring of the range of constraint references World is given
+template <int Dim, typename T>
+class ConstraintColouring : public basic_colouring<Constraint<Dim, T>>
+{
+public:
+    using Constraint_t = Constraint<Dim, T>;
+
+    void build(contiguous_range<std::reference_wrapper<Constraint_t>> constraints)
+    {
+        basic_colouring<Constraint_t>::build(constraints);
+        source = constraints.begin();
+        sourceSize = constraints.size();
+    }
+
+    // true if the cached colouring was built from this constraint range and
+    // has not been invalidated since
+    bool isBuiltFor(contiguous_range<std::reference_wrapper<Constraint_t>> constraints) const
+    {
+        return this->valid && source == constraints.begin() && sourceSize == constraints.size();
+    }
+
+private:
+    const std::reference_wrapper<Constraint_t> *source = nullptr;
+    std::size_t sourceSize = 0;
+};
+
+}
@@ -1,17 +1,125 @@
 #pragma once
 
 #include "../dynamics/particle.hpp"
+#include "../utility/maths.hpp"
 #include <utility>
 
 namespace mp {
 
+namespace detail {
+
+// the impulse along offsetDir, set here, that removes a distance constraint's
+// velocity error, without applying it. constraintMass must be > 0.
+template <int Dim, typename T, typename P1, typename P2>
+T distance_impulse(const P1 &p1, const P2 &p2, Vec<Dim, T> relativePosition, T length, T strength, T biasFactor, T dt,
+    T constraintMass, Vec<Dim, T> &offsetDir, T &error)
+{
+    T distance = relativePosition.length();
+    T offset = length - distance;
+    offset *= strength;
+    // same as relativePosition.normalised() without taking the sqrt again
+    offsetDir = distance > T{0} ? relativePosition / distance : relativePosition;
+    Vec<Dim, T> relativeVelocity = p1.linearVelocity - p2.linearVelocity;
+    T velocityDot = Vec<Dim, T>::dot(relativeVelocity, offsetDir);
+    T bias = -(biasFactor / dt) * offset;
+    error = velocityDot + bias;
+    return -error / constraintMass;
+}
+
+// impulse-based distance solve shared by reference and index based constraints.
+// P1 and P2 are Particle & or a particle_ref proxy. The impulse applied is added
+// to accumulated, and the velocity error corrected returned. Static particles
+// are never written, so constraints sharing one can be solved on different
+// threads, as islands are.
+template <int Dim, typename T, typename P1, typename P2>
+T solve_distance(P1 &&p1, P2 &&p2, Vec<Dim, T> relativePosition, T length, T strength, T biasFactor, T dt, T &accumulated)
+{
+    T constraintMass = p1.inverseMass + p2.inverseMass;
+    if (constraintMass <= 0)
+        return T{0};
+
+    Vec<Dim, T> offsetDir;
+    T error;
+    T lambda = distance_impulse(p1, p2, relativePosition, length, strength, biasFactor, dt, constraintMass, offsetDir, error);
+    if (p1.inverseMass != T{0})
+        p1.applyImpulse(offsetDir * lambda);
+    if (p2.inverseMass != T{0})
+        p2.applyImpulse(-offsetDir * lambda);
+    accumulated += lambda;
+    return error;
+}
+
+// XPBD projection of a distance constraint: move the particles towards length,
+// softened by compliance (inverse stiffness) so the stiffness does not depend
+// on the iteration count. lambda accumulates the Lagrange multiplier over the
+// sub-step of length dt. Returns the position error corrected.
+template <int Dim, typename T, typename P1, typename P2>
+T project_distance(P1 &&p1, P2 &&p2, Vec<Dim, T> relativePosition, T length, T compliance, T dt, T &lambda)
+{
+    T constraintMass = p1.inverseMass + p2.inverseMass;
+    if (constraintMass <= 0)
+        return T{0};
+
+    T distance = relativePosition.length();
+    Vec<Dim, T> direction = distance > T{0} ? relativePosition / distance : relativePosition;
+    T error = distance - length;
+    T alpha = compliance / (dt * dt);
+    T deltaLambda = -(error + alpha * lambda) / (constraintMass + alpha);
+    lambda += deltaLambda;
+    if (p1.inverseMass != T{0})
+        p1.applyCorrection(direction * deltaLambda);
+    if (p2.inverseMass != T{0})
+        p2.applyCorrection(-direction * deltaLambda);
+    return error;
+}
+
+// scale the impulse accumulated over the last sub-step by factor and apply it
+// again along the constraint's current direction
+template <int Dim, typename T, typename P1, typename P2>
+void warm_start_distance(P1 &&p1, P2 &&p2, Vec<Dim, T> relativePosition, T factor, T &accumulated)
+{
+    accumulated *= factor;
+    if (accumulated == T{0} || p1.inverseMass + p2.inverseMass <= 0)
+        return;
+    T distance = relativePosition.length();
+    Vec<Dim, T> offsetDir = distance > T{0} ? relativePosition / distance : relativePosition;
+    if (p1.inverseMass != T{0})
+        p1.applyImpulse(offsetDir * accumulated);
+    if (p2.inverseMass != T{0})
+        p2.applyImpulse(-offsetDir * accumulated);
+}
+
+// shortest difference on a torus along each axis with a range > 0
+template <int Dim, typename T>
+Vec<Dim, T> wrap_axes(Vec<Dim, T> diff, const Vec<Dim, T> &range)
+{
+    for (int i = 0; i < Dim; ++i)
+        if (range[i] > T{0})
+            diff[i] = wrapped_distance<T>(range[i])(diff[i]);
+    return diff;
+}
+
+} // namespace detail
+
 template <int Dim, typename T>
 class Constraint
 {
 public:
+    using scalar_type = T;
+    static constexpr int dimension = Dim;
 
     Constraint(Particle<Dim, T> &p1, Particle<Dim, T> &p2) : p1(p1), p2(p2) {}
-    virtual void solve(T dt) = 0;
+    // returns the error it corrected, in velocity units, for SolverResidual
+    virtual T solve(T dt) = 0;
+    // Called before the first iteration of a sub-step: reapply factor times the
+    // impulse the solves of the last sub-step added up to, and start
+    // accumulating from there. Constraints without a cached impulse do nothing.
+    virtual void warmStart(T) {}
+    // SolverMode::XPBD: resetMultiplier at the start of each sub-step of length
+    // dt, then solvePosition once per iteration, returning the position error
+    // corrected. Constraints without a position solve do nothing.
+    virtual void resetMultiplier() {}
+    virtual T solvePosition(T) { return T(0); }
     Particle<Dim, T> &p1;
     Particle<Dim, T> &p2;
 };
@@ -22,31 +130,74 @@ template <int Dim, typename T>
 class DistanceConstraint : public Constraint<Dim, T>
 {
 public:
-    DistanceConstraint(Particle<Dim, T> &p1, Particle<Dim, T> &p2) 
-        : Constraint<Dim, T>(p1, p2), length((p1.position - p2.position).length()) {}
-    void solve(T dt) override
+    DistanceConstraint(Particle<Dim, T> &p1, Particle<Dim, T> &p2, T strength = 0.2, T biasFactor = 0.3) 
+        : Constraint<Dim, T>(p1, p2), length((p1.position - p2.position).length()), 
+        strength(strength), biasFactor(biasFactor) {}
+    T solve(T dt) override
     {
-        T constraintMass = this->p1.inverseMass + this->p2.inverseMass;
-        if (constraintMass <= 0)
-            return;
-
-        Vec<Dim, T> relativePosition = this->p1.position - this->p2.position;
-        T distance = relativePosition.length();
-        T offset = length - distance;
-        offset *= strength;
-        Vec<Dim, T> offsetDir = relativePosition.normalised();
-        Vec<Dim, T> relativeVelocity = this->p1.linearVelocity - this->p2.linearVelocity;
-        T velocityDot = Vec<Dim, T>::dot(relativeVelocity, offsetDir);
-        T bias = -(biasFactor / dt) * offset;
-        T lambda = -(velocityDot + bias) / constraintMass;
-        
-        this->p1.applyImpulse(offsetDir * lambda);
-        this->p2.applyImpulse(-offsetDir * lambda);
+        return solveRelative(relativePosition(), dt);
     }
-private:
+    void warmStart(T factor) override
+    {
+        detail::warm_start_distance(this->p1, this->p2, relativePosition(), factor, impulse);
+    }
+    void resetMultiplier() override { impulse = 0; }
+    T solvePosition(T dt) override
+    {
+        return detail::project_distance(this->p1, this->p2, relativePosition(), length, compliance, dt, impulse);
+    }
+    Vec<Dim, T> relativePosition() const { return this->p1.position - this->p2.position; }
+    T restLength() const { return length; }
+    T getStrength() const { return strength; }
+    T getBiasFactor() const { return biasFactor; }
+    // impulse applied along the constraint since the last warm start, or in
+    // XPBD mode the Lagrange multiplier of the current sub-step
+    T accumulatedImpulse() const { return impulse; }
+    void accumulateImpulse(T lambda) { impulse += lambda; }
+    // XPBD compliance, the inverse of stiffness; 0 is rigid
+    void setCompliance(T c) { compliance = c; }
+    T getCompliance() const { return compliance; }
+
+protected:
+    DistanceConstraint(Particle<Dim, T> &p1, Particle<Dim, T> &p2, T length, T strength, T biasFactor) 
+        : Constraint<Dim, T>(p1, p2), length(length), strength(strength), biasFactor(biasFactor) {}
+
+    T solveRelative(Vec<Dim, T> relativePosition, T dt)
+    {
+        return detail::solve_distance(this->p1, this->p2, relativePosition, length, strength, biasFactor, dt, impulse);
+    }
+
     T length;
-    T strength = 0.2;
-    T biasFactor = 0.3;
+    T strength;
+    T biasFactor;
+    T impulse = 0;
+    T compliance = 0;
+};
+
+// distance constraint measured on a torus: each axis with a wrapRange > 0 takes
+// the shortest way round, as for the looped string
+template <int Dim, typename T>
+class WrappedDistanceConstraint : public DistanceConstraint<Dim, T>
+{
+public:
+    WrappedDistanceConstraint(Particle<Dim, T> &p1, Particle<Dim, T> &p2, Vec<Dim, T> wrapRange, T strength = 0.2, T biasFactor = 0.3)
+        : DistanceConstraint<Dim, T>(p1, p2, detail::wrap_axes(p1.position - p2.position, wrapRange).length(), strength, biasFactor), 
+        wrapRange(wrapRange) {}
+    T solve(T dt) override
+    {
+        return this->solveRelative(relativePosition(), dt);
+    }
+    void warmStart(T factor) override
+    {
+        detail::warm_start_distance(this->p1, this->p2, relativePosition(), factor, this->impulse);
+    }
+    T solvePosition(T dt) override
+    {
+        return detail::project_distance(this->p1, this->p2, relativePosition(), this->length, this->compliance, dt, this->impulse);
+    }
+    Vec<Dim, T> relativePosition() const { return detail::wrap_axes(this->p1.position - this->p2.position, wrapRange); }
+
+    Vec<Dim, T> wrapRange;
 };
 
 }
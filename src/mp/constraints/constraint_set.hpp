@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "constraint.hpp"
+#include "colouring.hpp"
+#include "distance_batch.hpp"
+#include "residual.hpp"
+#include "../parallel/executor.hpp"
+
+namespace mp {
+
+// Type-erased handle World keeps for a block of constraints. solve() is one
+// virtual call per block per iteration rather than one per constraint.
+template <int Dim, typename T>
+class ConstraintGroup
+{
+public:
+    virtual ~ConstraintGroup() {}
+    // with an executor each constraint type is solved colour by colour, split
+    // across threads. With a residual, each constraint's error is added to it.
+    virtual void solve(T dt, Executor *executor, std::size_t grain, SolverResidual<T> *residual) = 0;
+    // Constraint::warmStart for every constraint, in parallel by colour with an executor
+    virtual void warmStart(T factor, Executor *executor, std::size_t grain) = 0;
+    // Constraint::resetMultiplier and Constraint::solvePosition for every
+    // constraint, for SolverMode::XPBD. Colours and threads as solve.
+    virtual void resetMultipliers() = 0;
+    virtual void solvePositions(T dt, Executor *executor, std::size_t grain, SolverResidual<T> *residual) = 0;
+    virtual std::size_t size() const = 0;
+    // append every constraint, for World's sleep tracking; valid until revision changes
+    virtual void collect(std::vector<Constraint<Dim, T> *> &out) = 0;
+    // changes whenever constraints are added or invalidated
+    virtual std::size_t revision() const = 0;
+};
+
+namespace detail {
+
+template <typename C>
+struct is_batched_distance : std::false_type {};
+template <int Dim, typename T>
+struct is_batched_distance<DistanceConstraint<Dim, T>> : std::true_type {};
+template <int Dim, typename T>
+struct is_batched_distance<WrappedDistanceConstraint<Dim, T>> : std::true_type {};
+
+// run of independent constraints of one concrete type; the qualified call
+// cannot go through the vtable
+template <typename C, typename T>
+void solve_run(C *const *run, std::size_t count, T dt, SolverResidual<T> *residual, std::false_type)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const T error = run[i]->C::solve(dt);
+        if (residual != nullptr)
+            residual->add(error);
+    }
+}
+
+template <typename C, typename T>
+void solve_run(C *const *run, std::size_t count, T dt, SolverResidual<T> *residual, std::true_type)
+{
+    solveDistanceBatch(run, count, dt, residual);
+}
+
+template <typename C, typename T>
+void solve_constraints(std::vector<C> &constraints, basic_colouring<C> &colouring, T dt, Executor *executor, std::size_t grain,
+    SolverResidual<T> *residual, std::vector<SolverResidual<T>> &slots)
+{
+    using batched = is_batched_distance<C>;
+    // the vectorised kernels need independent constraints so always go by colour
+    if (executor == nullptr && !batched::value)
+    {
+        for (C &constraint : constraints)
+        {
+            const T error = constraint.C::solve(dt);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+        return;
+    }
+
+    if (!colouring.isValid())
+        colouring.build(constraints);
+    for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+    {
+        contiguous_range<C *> group = colouring.colour(c);
+        if (residual == nullptr)
+        {
+            parallel_for(executor, 0, group.size(), grain, [&](std::size_t begin, std::size_t end) {
+                solve_run(group.begin() + begin, end - begin, dt, residual, batched{});
+            });
+            continue;
+        }
+        parallel_residual(executor, 0, group.size(), grain, *residual, slots,
+            [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                solve_run(group.begin() + begin, end - begin, dt, &chunk, batched{});
+            });
+    }
+    contiguous_range<C *> remainder = colouring.remainder();
+    solve_run(remainder.begin(), remainder.size(), dt, residual, std::false_type{});
+}
+
+template <typename C, typename T>
+void warm_start_constraints(std::vector<C> &constraints, basic_colouring<C> &colouring, T factor, Executor *executor, std::size_t grain)
+{
+    if (executor == nullptr)
+    {
+        for (C &constraint : constraints)
+            constraint.C::warmStart(factor);
+        return;
+    }
+
+    if (!colouring.isValid())
+        colouring.build(constraints);
+    for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+    {
+        contiguous_range<C *> group = colouring.colour(c);
+        parallel_for(executor, 0, group.size(), grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                group[i]->C::warmStart(factor);
+        });
+    }
+    for (C *constraint : colouring.remainder())
+        constraint->C::warmStart(factor);
+}
+
+template <typename C, typename T>
+void solve_positions(std::vector<C> &constraints, basic_colouring<C> &colouring, T dt, Executor *executor, std::size_t grain,
+    SolverResidual<T> *residual, std::vector<SolverResidual<T>> &slots)
+{
+    const auto run = [dt](C *const *constraints, std::size_t count, SolverResidual<T> *r) {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const T error = constraints[i]->C::solvePosition(dt);
+            if (r != nullptr)
+                r->add(error);
+        }
+    };
+    if (executor == nullptr)
+    {
+        for (C &constraint : constraints)
+        {
+            const T error = constraint.C::solvePosition(dt);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+        return;
+    }
+
+    if (!colouring.isValid())
+        colouring.build(constraints);
+    for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+    {
+        contiguous_range<C *> group = colouring.colour(c);
+        if (residual == nullptr)
+        {
+            parallel_for(executor, 0, group.size(), grain, [&](std::size_t begin, std::size_t end) {
+                run(group.begin() + begin, end - begin, nullptr);
+            });
+            continue;
+        }
+        parallel_residual(executor, 0, group.size(), grain, *residual, slots,
+            [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                run(group.begin() + begin, end - begin, &chunk);
+            });
+    }
+    contiguous_range<C *> remainder = colouring.remainder();
+    run(remainder.begin(), remainder.size(), residual);
+}
+
+} // namespace detail
+
+// Stores each concrete constraint type contiguously in its own vector and
+// solves them with statically dispatched calls. Distance constraints go through
+// the SIMD batch kernel. All types must share the same Dim and T.
+template <typename First, typename... Rest>
+class ConstraintSet : public ConstraintGroup<First::dimension, typename First::scalar_type>
+{
+    using T = typename First::scalar_type;
+    static constexpr int Dim = First::dimension;
+    static_assert(meta::all_true<std::is_base_of<Constraint<Dim, T>, First>::value,
+                                 std::is_base_of<Constraint<Dim, T>, Rest>::value...>::value,
+        "ConstraintSet types must be constraints of the same dimension and scalar type");
+
+public:
+    // construct a C in place; invalidates references to other constraints of type C
+    template <typename C, typename... Args>
+    C &emplace(Args &&...args)
+    {
+        std::get<index_of<C>()>(colourings).invalidate();
+        ++_revision;
+        std::vector<C> &v = get<C>();
+        v.emplace_back(std::forward<Args>(args)...);
+        return v.back();
+    }
+
+    template <typename C>
+    void reserve(std::size_t n) { get<C>().reserve(n); }
+
+    // direct access to the storage for one type; call invalidate() after adding
+    // or removing through it
+    template <typename C>
+    std::vector<C> &get() { return std::get<index_of<C>()>(storage); }
+
+    void invalidate()
+    {
+        ++_revision;
+        invalidate(std::index_sequence_for<First, Rest...>{});
+    }
+
+    void solve(T dt, Executor *executor = nullptr, std::size_t grain = 256, SolverResidual<T> *residual = nullptr) override
+    {
+        solve(dt, executor, grain, residual, std::index_sequence_for<First, Rest...>{});
+    }
+
+    void warmStart(T factor, Executor *executor = nullptr, std::size_t grain = 256) override
+    {
+        warmStart(factor, executor, grain, std::index_sequence_for<First, Rest...>{});
+    }
+
+    void resetMultipliers() override { resetMultipliers(std::index_sequence_for<First, Rest...>{}); }
+
+    void solvePositions(T dt, Executor *executor = nullptr, std::size_t grain = 256, SolverResidual<T> *residual = nullptr) override
+    {
+        solvePositions(dt, executor, grain, residual, std::index_sequence_for<First, Rest...>{});
+    }
+
+    std::size_t size() const override { return size(std::index_sequence_for<First, Rest...>{}); }
+
+    void collect(std::vector<Constraint<Dim, T> *> &out) override { collect(out, std::index_sequence_for<First, Rest...>{}); }
+
+    std::size_t revision() const override { return _revision; }
+
+private:
+    template <typename C>
+    static constexpr std::size_t index_of() { return meta::index_of<C, First, Rest...>::value; }
+
+    template <std::size_t... Is>
+    void solve(T dt, Executor *executor, std::size_t grain, SolverResidual<T> *residual, std::index_sequence<Is...>)
+    {
+        int expand[] = {0, (detail::solve_constraints(std::get<Is>(storage), std::get<Is>(colourings), dt, executor, grain,
+            residual, residualSlots), 0)...};
+        (void)expand;
+    }
+
+    template <std::size_t... Is>
+    void warmStart(T factor, Executor *executor, std::size_t grain, std::index_sequence<Is...>)
+    {
+        int expand[] = {0, (detail::warm_start_constraints(std::get<Is>(storage), std::get<Is>(colourings), factor, executor, grain), 0)...};
+        (void)expand;
+    }
+
+    template <std::size_t... Is>
+    void resetMultipliers(std::index_sequence<Is...>)
+    {
+        int expand[] = {0, (resetMultipliers(std::get<Is>(storage)), 0)...};
+        (void)expand;
+    }
+
+    template <typename C>
+    static void resetMultipliers(std::vector<C> &constraints)
+    {
+        for (C &constraint : constraints)
+            constraint.C::resetMultiplier();
+    }
+
+    template <std::size_t... Is>
+    void solvePositions(T dt, Executor *executor, std::size_t grain, SolverResidual<T> *residual, std::index_sequence<Is...>)
+    {
+        int expand[] = {0, (detail::solve_positions(std::get<Is>(storage), std::get<Is>(colourings), dt, executor, grain,
+            residual, residualSlots), 0)...};
+        (void)expand;
+    }
+
+    template <std::size_t... Is>
+    void invalidate(std::index_sequence<Is...>)
+    {
+        int expand[] = {0, (std::get<Is>(colourings).invalidate(), 0)...};
+        (void)expand;
+    }
+
+    template <std::size_t... Is>
+    void collect(std::vector<Constraint<Dim, T> *> &out, std::index_sequence<Is...>)
+    {
+        int expand[] = {0, (collect(out, std::get<Is>(storage)), 0)...};
+        (void)expand;
+    }
+
+    template <typename C>
+    static void collect(std::vector<Constraint<Dim, T> *> &out, std::vector<C> &constraints)
+    {
+        for (C &constraint : constraints)
+            out.push_back(&constraint);
+    }
+
+    template <std::size_t... Is>
+    std::size_t size(std::index_sequence<Is...>) const
+    {
+        std::size_t sizes[] = {std::get<Is>(storage).size()...};
+        std::size_t total = 0;
+        for (std::size_t s : sizes)
+            total += s;
+        return total;
+    }
+
+    std::tuple<std::vector<First>, std::vector<Rest>...> storage;
+    std::tuple<basic_colouring<First>, basic_colouring<Rest>...> colourings;
+    // per-chunk residuals of a parallel solve
+    std::vector<SolverResidual<T>> residualSlots;
+    std::size_t _revision = 0;
+};
+
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <cstddef>
+#include "constraint.hpp"
+#include "residual.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MP_SIMD_X86 1
+#include <immintrin.h>
+#define MP_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define MP_TARGET_AVX2 __attribute__((target("avx2")))
+#define MP_SIMD_INLINE __attribute__((always_inline)) inline
+#else
+#define MP_SIMD_INLINE inline
+#endif
+
+namespace mp {
+namespace simd {
+
+enum class Isa { Scalar, SSE4, AVX2 };
+
+inline Isa &maxIsa()
+{
+    static Isa isa = Isa::AVX2;
+    return isa;
+}
+
+// cap the instruction set used by the batch kernels, mostly for testing
+inline void setMaxIsa(Isa isa) { maxIsa() = isa; }
+
+inline Isa detectIsa()
+{
+#ifdef MP_SIMD_X86
+    static const Isa detected = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return Isa::AVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return Isa::SSE4;
+        return Isa::Scalar;
+    }();
+    return detected;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+inline Isa activeIsa()
+{
+    const Isa detected = detectIsa();
+    return static_cast<int>(detected) < static_cast<int>(maxIsa()) ? detected : maxIsa();
+}
+
+} // namespace simd
+
+namespace detail {
+
+// one batch of distance constraints gathered into lanes
+template <int Dim, typename T, int Width>
+struct distance_lanes
+{
+    alignas(32) T inverseMass1[Width];
+    alignas(32) T inverseMass2[Width];
+    alignas(32) T length[Width];
+    alignas(32) T strength[Width];
+    alignas(32) T biasScale[Width];
+    alignas(32) T relativePosition[Dim][Width];
+    alignas(32) T relativeVelocity[Dim][Width];
+    // output: impulse along the constraint, applied +/- to the two particles
+    alignas(32) T impulse[Dim][Width];
+    // output: velocity error corrected, as returned by the scalar solve
+    alignas(32) T error[Width];
+    // output: impulse magnitude, added to the constraint's accumulated impulse
+    alignas(32) T lambda[Width];
+};
+
+#ifdef MP_SIMD_X86
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+struct sse4_double
+{
+    using scalar = double;
+    using reg = __m128d;
+    static constexpr int width = 2;
+    MP_TARGET_SSE4 static reg load(const double *p) { return _mm_load_pd(p); }
+    MP_TARGET_SSE4 static void store(double *p, reg a) { _mm_store_pd(p, a); }
+    MP_TARGET_SSE4 static reg zero() { return _mm_setzero_pd(); }
+    MP_TARGET_SSE4 static reg broadcast(double a) { return _mm_set1_pd(a); }
+    MP_TARGET_SSE4 static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+    MP_TARGET_SSE4 static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+    MP_TARGET_SSE4 static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+    MP_TARGET_SSE4 static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+    MP_TARGET_SSE4 static reg sqrt(reg a) { return _mm_sqrt_pd(a); }
+    MP_TARGET_SSE4 static reg neg(reg a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+    MP_TARGET_SSE4 static reg greater(reg a, reg b) { return _mm_cmpgt_pd(a, b); }
+    MP_TARGET_SSE4 static reg greaterEqual(reg a, reg b) { return _mm_cmpge_pd(a, b); }
+    MP_TARGET_SSE4 static reg select(reg mask, reg a, reg b) { return _mm_blendv_pd(b, a, mask); }
+};
+
+struct sse4_float
+{
+    using scalar = float;
+    using reg = __m128;
+    static constexpr int width = 4;
+    MP_TARGET_SSE4 static reg load(const float *p) { return _mm_load_ps(p); }
+    MP_TARGET_SSE4 static void store(float *p, reg a) { _mm_store_ps(p, a); }
+    MP_TARGET_SSE4 static reg zero() { return _mm_setzero_ps(); }
+    MP_TARGET_SSE4 static reg broadcast(float a) { return _mm_set1_ps(a); }
+    MP_TARGET_SSE4 static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    MP_TARGET_SSE4 static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    MP_TARGET_SSE4 static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    MP_TARGET_SSE4 static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+    MP_TARGET_SSE4 static reg sqrt(reg a) { return _mm_sqrt_ps(a); }
+    MP_TARGET_SSE4 static reg neg(reg a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    MP_TARGET_SSE4 static reg greater(reg a, reg b) { return _mm_cmpgt_ps(a, b); }
+    MP_TARGET_SSE4 static reg greaterEqual(reg a, reg b) { return _mm_cmpge_ps(a, b); }
+    MP_TARGET_SSE4 static reg select(reg mask, reg a, reg b) { return _mm_blendv_ps(b, a, mask); }
+};
+
+struct avx2_double
+{
+    using scalar = double;
+    using reg = __m256d;
+    static constexpr int width = 4;
+    MP_TARGET_AVX2 static reg load(const double *p) { return _mm256_load_pd(p); }
+    MP_TARGET_AVX2 static void store(double *p, reg a) { _mm256_store_pd(p, a); }
+    MP_TARGET_AVX2 static reg zero() { return _mm256_setzero_pd(); }
+    MP_TARGET_AVX2 static reg broadcast(double a) { return _mm256_set1_pd(a); }
+    MP_TARGET_AVX2 static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    MP_TARGET_AVX2 static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    MP_TARGET_AVX2 static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    MP_TARGET_AVX2 static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+    MP_TARGET_AVX2 static reg sqrt(reg a) { return _mm256_sqrt_pd(a); }
+    MP_TARGET_AVX2 static reg neg(reg a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+    MP_TARGET_AVX2 static reg greater(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    MP_TARGET_AVX2 static reg greaterEqual(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    MP_TARGET_AVX2 static reg select(reg mask, reg a, reg b) { return _mm256_blendv_pd(b, a, mask); }
+};
+
+struct avx2_float
+{
+    using scalar = float;
+    using reg = __m256;
+    static constexpr int width = 8;
+    MP_TARGET_AVX2 static reg load(const float *p) { return _mm256_load_ps(p); }
+    MP_TARGET_AVX2 static void store(float *p, reg a) { _mm256_store_ps(p, a); }
+    MP_TARGET_AVX2 static reg zero() { return _mm256_setzero_ps(); }
+    MP_TARGET_AVX2 static reg broadcast(float a) { return _mm256_set1_ps(a); }
+    MP_TARGET_AVX2 static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    MP_TARGET_AVX2 static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    MP_TARGET_AVX2 static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    MP_TARGET_AVX2 static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    MP_TARGET_AVX2 static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+    MP_TARGET_AVX2 static reg neg(reg a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    MP_TARGET_AVX2 static reg greater(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    MP_TARGET_AVX2 static reg greaterEqual(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    MP_TARGET_AVX2 static reg select(reg mask, reg a, reg b) { return _mm256_blendv_ps(b, a, mask); }
+};
+
+// The maths of DistanceConstraint::solveRelative across Ops::width lanes, in the
+// same operation order so results match the scalar path. Always inlined into
+// the target-specific entry points below.
+template <typename Ops, int Dim>
+MP_SIMD_INLINE void distance_kernel(distance_lanes<Dim, typename Ops::scalar, Ops::width> &lanes)
+{
+    using reg = typename Ops::reg;
+    const reg zero = Ops::zero();
+    const reg constraintMass = Ops::add(Ops::load(lanes.inverseMass1), Ops::load(lanes.inverseMass2));
+
+    reg relativePosition[Dim];
+    for (int a = 0; a < Dim; ++a)
+        relativePosition[a] = Ops::load(lanes.relativePosition[a]);
+
+    reg distanceSquared = Ops::mul(relativePosition[0], relativePosition[0]);
+    for (int a = 1; a < Dim; ++a)
+        distanceSquared = Ops::add(distanceSquared, Ops::mul(relativePosition[a], relativePosition[a]));
+    const reg distance = Ops::sqrt(distanceSquared);
+    const reg offset = Ops::mul(Ops::sub(Ops::load(lanes.length), distance), Ops::load(lanes.strength));
+
+    const reg hasLength = Ops::greater(distance, zero);
+    reg offsetDir[Dim];
+    for (int a = 0; a < Dim; ++a)
+        offsetDir[a] = Ops::select(hasLength, Ops::div(relativePosition[a], distance), relativePosition[a]);
+
+    reg velocityDot = Ops::mul(Ops::load(lanes.relativeVelocity[0]), offsetDir[0]);
+    for (int a = 1; a < Dim; ++a)
+        velocityDot = Ops::add(velocityDot, Ops::mul(Ops::load(lanes.relativeVelocity[a]), offsetDir[a]));
+
+    const reg bias = Ops::mul(Ops::load(lanes.biasScale), offset);
+    const reg error = Ops::add(velocityDot, bias);
+    const reg lambda = Ops::div(Ops::neg(error), constraintMass);
+    for (int a = 0; a < Dim; ++a)
+        Ops::store(lanes.impulse[a], Ops::mul(offsetDir[a], lambda));
+    Ops::store(lanes.error, error);
+    Ops::store(lanes.lambda, lambda);
+}
+
+template <int Dim>
+MP_TARGET_SSE4 void distance_kernel_sse4(distance_lanes<Dim, double, 2> &lanes) { distance_kernel<sse4_double, Dim>(lanes); }
+template <int Dim>
+MP_TARGET_SSE4 void distance_kernel_sse4(distance_lanes<Dim, float, 4> &lanes) { distance_kernel<sse4_float, Dim>(lanes); }
+template <int Dim>
+MP_TARGET_AVX2 void distance_kernel_avx2(distance_lanes<Dim, double, 4> &lanes) { distance_kernel<avx2_double, Dim>(lanes); }
+template <int Dim>
+MP_TARGET_AVX2 void distance_kernel_avx2(distance_lanes<Dim, float, 8> &lanes) { distance_kernel<avx2_float, Dim>(lanes); }
+
+#pragma GCC diagnostic pop
+
+#endif // MP_SIMD_X86
+
+template <int Dim, typename T, int Width, typename C>
+void gather_distance_lane(distance_lanes<Dim, T, Width> &lanes, int lane, C &constraint, T dt)
+{
+    const Vec<Dim, T> relativePosition = constraint.relativePosition();
+    const Vec<Dim, T> relativeVelocity = constraint.p1.linearVelocity - constraint.p2.linearVelocity;
+    lanes.inverseMass1[lane] = constraint.p1.inverseMass;
+    lanes.inverseMass2[lane] = constraint.p2.inverseMass;
+    lanes.length[lane] = constraint.restLength();
+    lanes.strength[lane] = constraint.getStrength();
+    lanes.biasScale[lane] = -(constraint.getBiasFactor() / dt);
+    for (int a = 0; a < Dim; ++a)
+    {
+        lanes.relativePosition[a][lane] = relativePosition[a];
+        lanes.relativeVelocity[a][lane] = relativeVelocity[a];
+    }
+}
+
+// fill unused lanes with a harmless constraint so the kernel never divides by zero
+template <int Dim, typename T, int Width>
+void pad_distance_lane(distance_lanes<Dim, T, Width> &lanes, int lane)
+{
+    lanes.inverseMass1[lane] = T{1};
+    lanes.inverseMass2[lane] = T{1};
+    lanes.length[lane] = T{0};
+    lanes.strength[lane] = T{0};
+    lanes.biasScale[lane] = T{0};
+    for (int a = 0; a < Dim; ++a)
+    {
+        lanes.relativePosition[a][lane] = T{0};
+        lanes.relativeVelocity[a][lane] = T{0};
+    }
+}
+
+template <int Width, typename C, int Dim, typename T, typename Kernel>
+void solve_distance_lanes(C *const *constraints, std::size_t count, T dt, SolverResidual<T> *residual, Kernel kernel)
+{
+    distance_lanes<Dim, T, Width> lanes;
+    C *batch[Width];
+    std::size_t i = 0;
+    while (i < count)
+    {
+        int n = 0;
+        for (; i < count && n < Width; ++i)
+        {
+            C &constraint = *constraints[i];
+            // immovable pairs are skipped, as in the scalar solve
+            if (constraint.p1.inverseMass + constraint.p2.inverseMass <= 0)
+            {
+                if (residual != nullptr)
+                    residual->add(T{0});
+                continue;
+            }
+            gather_distance_lane(lanes, n, constraint, dt);
+            batch[n++] = &constraint;
+        }
+        if (n == 0)
+            break;
+        for (int lane = n; lane < Width; ++lane)
+            pad_distance_lane(lanes, lane);
+
+        kernel(lanes);
+
+        for (int lane = 0; lane < n; ++lane)
+        {
+            Vec<Dim, T> impulse;
+            for (int a = 0; a < Dim; ++a)
+                impulse[a] = lanes.impulse[a][lane];
+            batch[lane]->p1.applyImpulse(impulse);
+            batch[lane]->p2.applyImpulse(-impulse);
+            batch[lane]->accumulateImpulse(lanes.lambda[lane]);
+        }
+        if (residual != nullptr)
+            for (int lane = 0; lane < n; ++lane)
+                residual->add(lanes.error[lane]);
+    }
+}
+
+template <typename C, int Dim, typename T>
+void solve_distance_batch(C *const *constraints, std::size_t count, T dt, SolverResidual<T> *residual)
+{
+#ifdef MP_SIMD_X86
+    constexpr int sseWidth = 16 / sizeof(T);
+    constexpr int avxWidth = 32 / sizeof(T);
+    switch (simd::activeIsa())
+    {
+        case simd::Isa::AVX2:
+            solve_distance_lanes<avxWidth, C, Dim>(constraints, count, dt, residual,
+                [](distance_lanes<Dim, T, avxWidth> &lanes) { distance_kernel_avx2<Dim>(lanes); });
+            return;
+        case simd::Isa::SSE4:
+            solve_distance_lanes<sseWidth, C, Dim>(constraints, count, dt, residual,
+                [](distance_lanes<Dim, T, sseWidth> &lanes) { distance_kernel_sse4<Dim>(lanes); });
+            return;
+        default:
+            break;
+    }
+#endif
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const T error = constraints[i]->C::solve(dt);
+        if (residual != nullptr)
+            residual->add(error);
+    }
+}
+
+} // namespace detail
+
+// Solve a run of distance constraints several at a time with SSE/AVX2, picked
+// at runtime from what the CPU supports. No two constraints in the run may
+// share a particle, e.g. one colour from ConstraintColouring. Falls back to
+// calling solve() on each constraint off x86. With a residual, each
+// constraint's error is added to it.
+template <int Dim, typename T>
+void solveDistanceBatch(DistanceConstraint<Dim, T> *const *constraints, std::size_t count, T dt,
+    SolverResidual<T> *residual = nullptr)
+{
+    detail::solve_distance_batch<DistanceConstraint<Dim, T>, Dim>(constraints, count, dt, residual);
+}
+
+template <int Dim, typename T>
+void solveDistanceBatch(WrappedDistanceConstraint<Dim, T> *const *constraints, std::size_t count, T dt,
+    SolverResidual<T> *residual = nullptr)
+{
+    detail::solve_distance_batch<WrappedDistanceConstraint<Dim, T>, Dim>(constraints, count, dt, residual);
+}
+
+}
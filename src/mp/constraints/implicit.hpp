@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "constraint.hpp"
+#include "indexed.hpp"
+#include "../parallel/executor.hpp"
+
+namespace mp {
+
+// Backward Euler integration of springs for SolverMode::Implicit. Every
+// constraint of an IndexedDistanceSet with compliance > 0 is a spring of
+// stiffness 1 / compliance, and the velocity change dv over a sub-step of
+// length h solves
+//   (M - h^2 K) dv = h (f + h K v)
+// where f is the spring forces and K their Jacobian. The transverse stiffness
+// of a compressed spring is dropped so the system stays symmetric positive
+// definite, and it is solved by conjugate gradient preconditioned with its
+// diagonal. Particles with inverse mass 0 do not move.
+//
+// The sparsity pattern, Dim x Dim blocks in CSR form, is built the first time
+// and whenever a set changes; each sub-step only refreshes the values.
+// Assembly is serial; the conjugate gradient splits across the executor in
+// chunks of grain particles, and sums dot products over fixed blocks of
+// particles so the result does not depend on the executor or the grain.
+template <int Dim, typename T>
+class ImplicitSolver
+{
+public:
+    using Vec_t = Vec<Dim, T>;
+    using IndexedDistanceSet_t = IndexedDistanceSet<Dim, T>;
+
+    // call if a set's constraints change without its revision changing, e.g.
+    // when it is replaced by another
+    void invalidate() { layout.clear(); }
+
+    // Step the springs of sets over a sub-step of length h, adding dv to the
+    // particles' velocities. Positions are left to the usual integration.
+    template <typename Particles>
+    void solve(const std::vector<IndexedDistanceSet_t *> &sets, Particles &particles, T h, Executor *executor,
+        std::size_t grain)
+    {
+        if (!isBuiltFor(sets, particles.size()))
+            build(sets, particles.size());
+        assemble(sets, particles, h);
+        iterations = conjugateGradient(executor, std::max<std::size_t>(grain, 1));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (preconditioner[i * Dim] == T(0))
+                continue;
+            auto &&particle = particles[i];
+            for (int a = 0; a < Dim; ++a)
+                particle.linearVelocity[a] += x[i * Dim + a];
+        }
+    }
+
+    // conjugate gradient iterations of the last solve
+    int lastIterations() const { return iterations; }
+    // times the sparsity pattern has been built
+    std::size_t builds() const { return buildCount; }
+
+    // conjugate gradient stops after maxIterations, or once the residual is
+    // within tolerance of the right hand side
+    int maxIterations = 100;
+    T tolerance = T(1e-6);
+
+private:
+    struct set_key
+    {
+        const IndexedDistanceSet_t *set;
+        std::size_t revision;
+        std::size_t size;
+    };
+
+    static bool isSpring(const IndexedDistanceSet_t &set) { return set.compliance > T(0); }
+
+    bool isBuiltFor(const std::vector<IndexedDistanceSet_t *> &sets, std::size_t particleCount) const
+    {
+        if (layout.size() != sets.size() || count != particleCount)
+            return false;
+        for (std::size_t s = 0; s < sets.size(); ++s)
+        {
+            const set_key &k = layout[s];
+            if (k.set != sets[s] || k.revision != sets[s]->revision() || k.size != sets[s]->size())
+                return false;
+        }
+        return true;
+    }
+
+    void build(const std::vector<IndexedDistanceSet_t *> &sets, std::size_t particleCount)
+    {
+        count = particleCount;
+        layout.clear();
+        for (const IndexedDistanceSet_t *set : sets)
+            layout.push_back({set, set->revision(), set->size()});
+
+        // every block, as row << 32 | column, including the diagonal
+        std::vector<std::uint64_t> blocks;
+        for (std::size_t i = 0; i < count; ++i)
+            blocks.push_back(key(i, i));
+        for (const IndexedDistanceSet_t *set : sets)
+        {
+            if (!isSpring(*set))
+                continue;
+            for (const IndexedDistanceConstraint<T> &c : set->constraints)
+            {
+                blocks.push_back(key(c.p1, c.p2));
+                blocks.push_back(key(c.p2, c.p1));
+            }
+        }
+        std::sort(blocks.begin(), blocks.end());
+        blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+        rowStart.assign(count + 1, 0);
+        column.resize(blocks.size());
+        for (std::size_t b = 0; b < blocks.size(); ++b)
+        {
+            ++rowStart[(blocks[b] >> 32) + 1];
+            column[b] = static_cast<std::uint32_t>(blocks[b]);
+        }
+        for (std::size_t i = 0; i < count; ++i)
+            rowStart[i + 1] += rowStart[i];
+
+        diagonal.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+            diagonal[i] = find(static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(i));
+        // where each spring's four blocks live
+        springBlocks.clear();
+        for (const IndexedDistanceSet_t *set : sets)
+        {
+            if (!isSpring(*set))
+                continue;
+            for (const IndexedDistanceConstraint<T> &c : set->constraints)
+            {
+                springBlocks.push_back(find(c.p1, c.p1));
+                springBlocks.push_back(find(c.p2, c.p2));
+                springBlocks.push_back(find(c.p1, c.p2));
+                springBlocks.push_back(find(c.p2, c.p1));
+            }
+        }
+        values.resize(column.size() * Dim * Dim);
+        for (std::vector<T> *v : {&b, &x, &r, &z, &p, &ap, &preconditioner})
+            v->resize(count * Dim);
+        ++buildCount;
+    }
+
+    static std::uint64_t key(std::size_t row, std::size_t col)
+    {
+        return static_cast<std::uint64_t>(row) << 32 | static_cast<std::uint64_t>(col);
+    }
+
+    std::uint32_t find(std::uint32_t row, std::uint32_t col) const
+    {
+        const std::uint32_t *first = column.data() + rowStart[row];
+        const std::uint32_t *last = column.data() + rowStart[row + 1];
+        return static_cast<std::uint32_t>(std::lower_bound(first, last, col) - column.data());
+    }
+
+    // add s times hessian to block
+    void addBlock(std::uint32_t block, const T (&hessian)[Dim][Dim], T s)
+    {
+        T *m = values.data() + static_cast<std::size_t>(block) * Dim * Dim;
+        for (int a = 0; a < Dim; ++a)
+            for (int c = 0; c < Dim; ++c)
+                m[a * Dim + c] += s * hessian[a][c];
+    }
+
+    template <typename Particles>
+    void assemble(const std::vector<IndexedDistanceSet_t *> &sets, Particles &particles, T h)
+    {
+        std::fill(values.begin(), values.end(), T(0));
+        std::fill(b.begin(), b.end(), T(0));
+        // mass on the diagonal; fixed particles keep an identity row and no right hand side
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const T inverseMass = particles[i].inverseMass;
+            T *m = values.data() + static_cast<std::size_t>(diagonal[i]) * Dim * Dim;
+            for (int a = 0; a < Dim; ++a)
+                m[a * Dim + a] = inverseMass > T(0) ? T(1) / inverseMass : T(1);
+        }
+
+        std::size_t spring = 0;
+        for (const IndexedDistanceSet_t *set : sets)
+        {
+            if (!isSpring(*set))
+                continue;
+            const T stiffness = T(1) / set->compliance;
+            const T s = h * h * stiffness;
+            for (const IndexedDistanceConstraint<T> &c : set->constraints)
+            {
+                const std::uint32_t *blocks = springBlocks.data() + 4 * spring++;
+                auto &&p1 = particles[c.p1];
+                auto &&p2 = particles[c.p2];
+                const Vec_t relative = detail::wrap_axes<Dim, T>(p1.position - p2.position, set->wrapRange);
+                const T distance = relative.length();
+                if (distance <= T(0))
+                    continue;
+                const Vec_t n = relative / distance;
+                // no transverse stiffness under compression
+                const T transverse = std::max(T(0), T(1) - c.length / distance);
+                T hessian[Dim][Dim];
+                for (int a = 0; a < Dim; ++a)
+                    for (int d = 0; d < Dim; ++d)
+                        hessian[a][d] = (T(1) - transverse) * n[a] * n[d] + (a == d ? transverse : T(0));
+                addBlock(blocks[0], hessian, s);
+                addBlock(blocks[1], hessian, s);
+                addBlock(blocks[2], hessian, -s);
+                addBlock(blocks[3], hessian, -s);
+
+                // h f - h^2 K v for this spring, on p1 and negated on p2
+                const Vec_t force = n * (-stiffness * (distance - c.length));
+                const Vec_t relativeVelocity = p1.linearVelocity - p2.linearVelocity;
+                for (int a = 0; a < Dim; ++a)
+                {
+                    T hv = 0;
+                    for (int d = 0; d < Dim; ++d)
+                        hv += hessian[a][d] * relativeVelocity[d];
+                    const T rhs = h * force[a] - s * hv;
+                    b[c.p1 * Dim + a] += rhs;
+                    b[c.p2 * Dim + a] -= rhs;
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const bool fixed = !(particles[i].inverseMass > T(0));
+            const T *m = values.data() + static_cast<std::size_t>(diagonal[i]) * Dim * Dim;
+            for (int a = 0; a < Dim; ++a)
+            {
+                preconditioner[i * Dim + a] = fixed ? T(0) : T(1) / m[a * Dim + a];
+                if (fixed)
+                    b[i * Dim + a] = T(0);
+            }
+        }
+    }
+
+    // out = A in, with fixed particles' rows zeroed
+    void multiply(const std::vector<T> &in, std::vector<T> &out, Executor *executor, std::size_t grain) const
+    {
+        parallel_for(executor, 0, count, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                T sum[Dim] = {};
+                for (std::uint32_t e = rowStart[i]; e < rowStart[i + 1]; ++e)
+                {
+                    const T *m = values.data() + static_cast<std::size_t>(e) * Dim * Dim;
+                    const T *v = in.data() + static_cast<std::size_t>(column[e]) * Dim;
+                    for (int a = 0; a < Dim; ++a)
+                        for (int c = 0; c < Dim; ++c)
+                            sum[a] += m[a * Dim + c] * v[c];
+                }
+                for (int a = 0; a < Dim; ++a)
+                    out[i * Dim + a] = preconditioner[i * Dim] == T(0) ? T(0) : sum[a];
+            }
+        });
+    }
+
+    // particles per partial sum of a dot product
+    static constexpr std::size_t dotBlock = 64;
+
+    // summed block by block, then the blocks in order
+    T dot(const std::vector<T> &u, const std::vector<T> &v, Executor *executor, std::size_t grain)
+    {
+        const std::size_t blocks = (count + dotBlock - 1) / dotBlock;
+        partial.assign(blocks, T(0));
+        const std::size_t blockGrain = std::max<std::size_t>(1, grain / dotBlock);
+        parallel_for(executor, 0, blocks, blockGrain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; ++k)
+            {
+                T sum = 0;
+                const std::size_t last = std::min(count, (k + 1) * dotBlock) * Dim;
+                for (std::size_t j = k * dotBlock * Dim; j < last; ++j)
+                    sum += u[j] * v[j];
+                partial[k] = sum;
+            }
+        });
+        T total = 0;
+        for (T s : partial)
+            total += s;
+        return total;
+    }
+
+    template <typename Fn>
+    void forEach(Executor *executor, std::size_t grain, Fn &&fn)
+    {
+        parallel_for(executor, 0, count, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t j = begin * Dim; j < end * Dim; ++j)
+                fn(j);
+        });
+    }
+
+    // solve for x from 0, returning the iterations run
+    int conjugateGradient(Executor *executor, std::size_t grain)
+    {
+        std::fill(x.begin(), x.end(), T(0));
+        r = b;
+        forEach(executor, grain, [&](std::size_t j) { z[j] = preconditioner[j] * r[j]; });
+        p = z;
+        T rz = dot(r, z, executor, grain);
+        const T limit = tolerance * tolerance * dot(b, b, executor, grain);
+        int i = 0;
+        while (i < maxIterations && dot(r, r, executor, grain) > limit)
+        {
+            multiply(p, ap, executor, grain);
+            const T pap = dot(p, ap, executor, grain);
+            if (!(pap > T(0)))
+                break;
+            const T alpha = rz / pap;
+            forEach(executor, grain, [&](std::size_t j) {
+                x[j] += alpha * p[j];
+                r[j] -= alpha * ap[j];
+                z[j] = preconditioner[j] * r[j];
+            });
+            const T rzNext = dot(r, z, executor, grain);
+            const T beta = rzNext / rz;
+            rz = rzNext;
+            forEach(executor, grain, [&](std::size_t j) { p[j] = z[j] + beta * p[j]; });
+            ++i;
+        }
+        return i;
+    }
+
+    std::vector<set_key> layout;
+    std::size_t count = 0;
+    std::vector<std::uint32_t> rowStart;
+    std::vector<std::uint32_t> column;
+    std::vector<std::uint32_t> diagonal;
+    // each spring's p1 p1, p2 p2, p1 p2 and p2 p1 block
+    std::vector<std::uint32_t> springBlocks;
+    // Dim x Dim row major per block
+    std::vector<T> values;
+    std::vector<T> b, x, r, z, p, ap;
+    // inverse diagonal, 0 for fixed particles
+    std::vector<T> preconditioner;
+    std::vector<T> partial;
+    int iterations = 0;
+    std::size_t buildCount = 0;
+};
+
+}
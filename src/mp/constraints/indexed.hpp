@@ -0,0 +1,356 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "constraint.hpp"
+#include "residual.hpp"
+#include "../parallel/executor.hpp"
+
+namespace mp {
+
+// distance constraint between two particles named by their index in World's
+// particle storage. Plain data, so it can be copied, sorted and serialised.
+template <typename T>
+struct IndexedDistanceConstraint
+{
+    std::uint32_t p1;
+    std::uint32_t p2;
+    T length;
+};
+
+// A block of index based distance constraints sharing one set of parameters.
+// World resolves the indices against whichever particle storage it steps, so
+// this works with contiguous_range<Particle> and ParticleStore alike.
+template <int Dim, typename T>
+class IndexedDistanceSet
+{
+public:
+    using Constraint_t = IndexedDistanceConstraint<T>;
+
+    IndexedDistanceSet(T strength = 0.2, T biasFactor = 0.3, Vec<Dim, T> wrapRange = {})
+        : strength(strength), biasFactor(biasFactor), wrapRange(wrapRange) {}
+
+    void add(std::uint32_t p1, std::uint32_t p2, T length)
+    {
+        constraints.push_back({p1, p2, length});
+        coloured = false;
+        ++_revision;
+    }
+
+    // rest length taken from the current particle positions
+    template <typename Particles>
+    void add(Particles &particles, std::uint32_t p1, std::uint32_t p2)
+    {
+        add(p1, p2, relativePosition(particles[p1], particles[p2]).length());
+    }
+
+    void clear()
+    {
+        constraints.clear();
+        impulses.clear();
+        coloured = false;
+        ++_revision;
+    }
+
+    std::size_t size() const { return constraints.size(); }
+
+    // Give every constraint a cached impulse, 0 for those added since the
+    // last call. Warm starting and XPBD call this; solves only accumulate
+    // impulses while they are allocated.
+    void cacheImpulses()
+    {
+        if (impulses.size() != constraints.size())
+            impulses.resize(constraints.size(), T{0});
+    }
+    // free the cached impulses once nothing reads them
+    void dropImpulses() { std::vector<T>().swap(impulses); }
+    bool cachesImpulses() const { return !impulses.empty() && impulses.size() == constraints.size(); }
+    // changes whenever constraints are added or reordered, invalidating indices into them
+    std::size_t revision() const { return _revision; }
+
+    // order by first particle index so consecutive solves touch nearby memory.
+    // Discards any colouring.
+    void sortByParticle()
+    {
+        std::vector<std::uint32_t> order(constraints.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            order[i] = static_cast<std::uint32_t>(i);
+        std::stable_sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b) {
+            const Constraint_t &ca = constraints[a], &cb = constraints[b];
+            return ca.p1 != cb.p1 ? ca.p1 < cb.p1 : ca.p2 < cb.p2;
+        });
+        permute(order);
+        coloured = false;
+        ++_revision;
+    }
+
+    // Reorder the constraints so each colour is a contiguous run sharing no
+    // particles. Done automatically the first time an executor is used.
+    void colour()
+    {
+        std::uint32_t particleCount = 0;
+        for (const Constraint_t &c : constraints)
+            particleCount = std::max(particleCount, std::max(c.p1, c.p2) + 1);
+
+        std::vector<std::uint64_t> used(particleCount, 0);
+        std::vector<std::uint8_t> colours(constraints.size());
+        std::size_t colourCount = 0;
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+        {
+            const Constraint_t &c = constraints[i];
+            const std::uint64_t taken = used[c.p1] | used[c.p2];
+            std::uint8_t colour = 0;
+            // the last colour doubles as the serial remainder once the others are full
+            while (colour < 63 && (taken & (std::uint64_t{1} << colour)))
+                ++colour;
+            used[c.p1] |= std::uint64_t{1} << colour;
+            used[c.p2] |= std::uint64_t{1} << colour;
+            colours[i] = colour;
+            colourCount = std::max<std::size_t>(colourCount, colour + 1);
+        }
+
+        std::vector<std::uint32_t> order(constraints.size());
+        offsets.assign(colourCount + 1, 0);
+        for (std::uint8_t colour : colours)
+            ++offsets[colour + 1];
+        for (std::size_t c = 0; c < colourCount; ++c)
+            offsets[c + 1] += offsets[c];
+        std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+            order[next[colours[i]]++] = static_cast<std::uint32_t>(i);
+        permute(order);
+        coloured = true;
+        ++_revision;
+    }
+
+    // with a residual, each constraint's error is added to it
+    template <typename Particles>
+    void solve(Particles &particles, T dt, Executor *executor = nullptr, std::size_t grain = 256,
+        SolverResidual<T> *residual = nullptr)
+    {
+        if (executor == nullptr)
+        {
+            solveRange(particles, 0, constraints.size(), dt, residual);
+            return;
+        }
+
+        if (!coloured || offsets.back() != constraints.size())
+            colour();
+        const std::size_t colourCount = offsets.size() - 1;
+        for (std::size_t c = 0; c < colourCount; ++c)
+        {
+            // colour 63 may hold constraints sharing particles
+            if (c == 63)
+            {
+                solveRange(particles, offsets[c], offsets[c + 1], dt, residual);
+                break;
+            }
+            if (residual == nullptr)
+            {
+                parallel_for(executor, offsets[c], offsets[c + 1], grain, [&](std::size_t begin, std::size_t end) {
+                    solveRange(particles, begin, end, dt, residual);
+                });
+                continue;
+            }
+            detail::parallel_residual(executor, offsets[c], offsets[c + 1], grain, *residual, residualSlots,
+                [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                    solveRange(particles, begin, end, dt, &chunk);
+                });
+        }
+    }
+
+    // Constraint::warmStart for every constraint, in parallel by colour with an executor
+    template <typename Particles>
+    void warmStart(Particles &particles, T factor, Executor *executor = nullptr, std::size_t grain = 256)
+    {
+        cacheImpulses();
+        if (executor == nullptr)
+        {
+            warmStartRange(particles, 0, constraints.size(), factor);
+            return;
+        }
+
+        if (!coloured || offsets.back() != constraints.size())
+            colour();
+        const std::size_t colourCount = offsets.size() - 1;
+        for (std::size_t c = 0; c < colourCount; ++c)
+        {
+            if (c == 63)
+            {
+                warmStartRange(particles, offsets[c], offsets[c + 1], factor);
+                break;
+            }
+            parallel_for(executor, offsets[c], offsets[c + 1], grain, [&](std::size_t begin, std::size_t end) {
+                warmStartRange(particles, begin, end, factor);
+            });
+        }
+    }
+
+    // SolverMode::XPBD: resetMultipliers at the start of each sub-step of length
+    // dt, then solvePositions once per iteration. Colours and threads as solve,
+    // adding position errors to residual.
+    void resetMultipliers() { impulses.assign(constraints.size(), T{0}); }
+
+    template <typename Particles>
+    void solvePositions(Particles &particles, T dt, Executor *executor = nullptr, std::size_t grain = 256,
+        SolverResidual<T> *residual = nullptr)
+    {
+        if (executor == nullptr)
+        {
+            solvePositionRange(particles, 0, constraints.size(), dt, residual);
+            return;
+        }
+
+        if (!coloured || offsets.back() != constraints.size())
+            colour();
+        const std::size_t colourCount = offsets.size() - 1;
+        for (std::size_t c = 0; c < colourCount; ++c)
+        {
+            if (c == 63)
+            {
+                solvePositionRange(particles, offsets[c], offsets[c + 1], dt, residual);
+                break;
+            }
+            if (residual == nullptr)
+            {
+                parallel_for(executor, offsets[c], offsets[c + 1], grain, [&](std::size_t begin, std::size_t end) {
+                    solvePositionRange(particles, begin, end, dt, residual);
+                });
+                continue;
+            }
+            detail::parallel_residual(executor, offsets[c], offsets[c + 1], grain, *residual, residualSlots,
+                [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                    solvePositionRange(particles, begin, end, dt, &chunk);
+                });
+        }
+    }
+
+    // needs cacheImpulses first, so islands can share the set across threads
+    template <typename Particles>
+    void warmStartIndices(Particles &particles, const std::uint32_t *indices, std::size_t count, T factor)
+    {
+        if (!cachesImpulses())
+            return;
+        for (std::size_t i = 0; i < count; ++i)
+            warmStartOne(particles, indices[i], factor);
+    }
+
+    // solve constraints[indices[i]] for each of the count indices, in order
+    template <typename Particles>
+    void solveIndices(Particles &particles, const std::uint32_t *indices, std::size_t count, T dt,
+        SolverResidual<T> *residual = nullptr)
+    {
+        T *cached = cachedImpulses();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const T error = solveOne(particles, indices[i], dt, cached);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+    }
+
+    std::vector<Constraint_t> constraints;
+    // parallel to constraints: the impulse applied since the last warm start,
+    // or in XPBD mode the Lagrange multiplier of the current sub-step. Empty
+    // unless something reads them, so constraints stay 16 bytes for doubles.
+    std::vector<T> impulses;
+    T strength;
+    T biasFactor;
+    // XPBD compliance, the inverse of stiffness; 0 is rigid. In Implicit mode
+    // a set with compliance > 0 is springs of stiffness 1 / compliance.
+    T compliance = 0;
+    // axes with a range > 0 are measured the shortest way round, as WrappedDistanceConstraint
+    Vec<Dim, T> wrapRange;
+
+private:
+    template <typename P>
+    Vec<Dim, T> relativePosition(const P &p1, const P &p2) const
+    {
+        return detail::wrap_axes<Dim, T>(p1.position - p2.position, wrapRange);
+    }
+
+    // the cached impulses, or null while none are kept
+    T *cachedImpulses() { return cachesImpulses() ? impulses.data() : nullptr; }
+
+    // reorder the constraints, and their impulses if cached, so the i'th is the order[i]'th
+    void permute(const std::vector<std::uint32_t> &order)
+    {
+        std::vector<Constraint_t> ordered(constraints.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            ordered[i] = constraints[order[i]];
+        constraints.swap(ordered);
+        if (impulses.empty())
+            return;
+        cacheImpulses();
+        std::vector<T> reordered(impulses.size());
+        for (std::size_t i = 0; i < order.size(); ++i)
+            reordered[i] = impulses[order[i]];
+        impulses.swap(reordered);
+    }
+
+    template <typename Particles>
+    void solveRange(Particles &particles, std::size_t begin, std::size_t end, T dt, SolverResidual<T> *residual)
+    {
+        T *cached = cachedImpulses();
+        if (residual == nullptr)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+                solveOne(particles, i, dt, cached);
+            return;
+        }
+        for (std::size_t i = begin; i < end; ++i)
+            residual->add(solveOne(particles, i, dt, cached));
+    }
+
+    template <typename Particles>
+    T solveOne(Particles &particles, std::size_t i, T dt, T *cached)
+    {
+        const Constraint_t &c = constraints[i];
+        auto &&p1 = particles[c.p1];
+        auto &&p2 = particles[c.p2];
+        T unused = 0;
+        return detail::solve_distance(p1, p2, relativePosition(p1, p2), c.length, strength, biasFactor, dt,
+            cached != nullptr ? cached[i] : unused);
+    }
+
+    template <typename Particles>
+    void solvePositionRange(Particles &particles, std::size_t begin, std::size_t end, T dt, SolverResidual<T> *residual)
+    {
+        T *cached = cachedImpulses();
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const Constraint_t &c = constraints[i];
+            auto &&p1 = particles[c.p1];
+            auto &&p2 = particles[c.p2];
+            T unused = 0;
+            const T error = detail::project_distance(p1, p2, relativePosition(p1, p2), c.length, compliance, dt,
+                cached != nullptr ? cached[i] : unused);
+            if (residual != nullptr)
+                residual->add(error);
+        }
+    }
+
+    template <typename Particles>
+    void warmStartRange(Particles &particles, std::size_t begin, std::size_t end, T factor)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            warmStartOne(particles, i, factor);
+    }
+
+    template <typename Particles>
+    void warmStartOne(Particles &particles, std::size_t i, T factor)
+    {
+        const Constraint_t &c = constraints[i];
+        auto &&p1 = particles[c.p1];
+        auto &&p2 = particles[c.p2];
+        detail::warm_start_distance(p1, p2, relativePosition(p1, p2), factor, impulses[i]);
+    }
+
+    std::vector<std::size_t> offsets;
+    std::vector<SolverResidual<T>> residualSlots;
+    bool coloured = false;
+    std::size_t _revision = 0;
+};
+
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "constraint.hpp"
+#include "indexed.hpp"
+#include "residual.hpp"
+#include "../utility/range.hpp"
+#include "../utility/union_find.hpp"
+
+namespace mp {
+
+// Connected components of the constraint graph. Particles are merged with
+// union_find as constraints are connected; static particles (inverse mass 0)
+// are never merged through, so two ropes hanging from the same anchor are
+// separate islands. Islands share no dynamic particles, so each can be solved
+// in full, every iteration, independently of the others.
+//
+// Detection is not incremental: any change to the inputs rebuilds every island
+// with one union_find pass over all the constraints, linear in their number.
+// Adding constraints every step therefore costs a rebuild every step.
+template <int Dim, typename T>
+class Islands
+{
+public:
+    using Constraint_t = Constraint<Dim, T>;
+    using IndexedDistanceSet_t = IndexedDistanceSet<Dim, T>;
+    using ConstraintRange_t = contiguous_range<std::reference_wrapper<Constraint_t>>;
+
+    enum : std::uint32_t { none = 0xffffffffu };
+
+    // ends[i] holds the particle indices of constraints[i], or none if the
+    // constraint's particles are not in particles. Those are kept aside in loose().
+    template <typename Particles>
+    void build(Particles &particles, ConstraintRange_t constraints,
+        const std::vector<std::pair<std::uint32_t, std::uint32_t>> &ends,
+        const std::vector<IndexedDistanceSet_t *> &indexed)
+    {
+        const std::size_t n = particles.size();
+        isStatic.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+            isStatic[i] = particles[i].inverseMass == T{};
+        sets.reset(n);
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+            if (ends[i].first != none)
+                connect(ends[i].first, ends[i].second);
+        for (IndexedDistanceSet_t *set : indexed)
+            for (const typename IndexedDistanceSet_t::Constraint_t &c : set->constraints)
+                connect(c.p1, c.p2);
+
+        // number the islands that own a constraint in order of their lowest particle
+        std::vector<std::uint32_t> rootIsland(n, none);
+        std::vector<std::uint8_t> owns(n, 0);
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+            if (ends[i].first != none)
+                markOwner(owns, ends[i].first, ends[i].second);
+        for (IndexedDistanceSet_t *set : indexed)
+            for (const typename IndexedDistanceSet_t::Constraint_t &c : set->constraints)
+                markOwner(owns, c.p1, c.p2);
+
+        particleIsland.assign(n, none);
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (isStatic[i])
+                continue;
+            const std::uint32_t root = sets.find(static_cast<std::uint32_t>(i));
+            if (!owns[root])
+                continue;
+            if (rootIsland[root] == none)
+                rootIsland[root] = static_cast<std::uint32_t>(count++);
+            particleIsland[i] = rootIsland[root];
+        }
+
+        particleOffsets.assign(count + 1, 0);
+        for (std::uint32_t island : particleIsland)
+            if (island != none)
+                ++particleOffsets[island + 1];
+        prefixSum(particleOffsets);
+        particleList.resize(particleOffsets.back());
+        std::vector<std::size_t> next(particleOffsets.begin(), particleOffsets.end() - 1);
+        for (std::size_t i = 0; i < n; ++i)
+            if (particleIsland[i] != none)
+                particleList[next[particleIsland[i]]++] = static_cast<std::uint32_t>(i);
+
+        // range constraints per island, keeping their order
+        rangeOffsets.assign(count + 1, 0);
+        _loose.clear();
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+        {
+            const std::uint32_t island = ends[i].first == none ? none : owner(ends[i].first, ends[i].second);
+            if (island != none)
+                ++rangeOffsets[island + 1];
+            else if (ends[i].first == none)
+                _loose.push_back(&constraints[i].get());
+        }
+        prefixSum(rangeOffsets);
+        rangeList.resize(rangeOffsets.back());
+        next.assign(rangeOffsets.begin(), rangeOffsets.end() - 1);
+        for (std::size_t i = 0; i < constraints.size(); ++i)
+        {
+            const std::uint32_t island = ends[i].first == none ? none : owner(ends[i].first, ends[i].second);
+            if (island != none)
+                rangeList[next[island]++] = &constraints[i].get();
+        }
+
+        // indexed constraints per island, grouped by set then in order
+        setCount = indexed.size();
+        indexedOffsets.assign(count * setCount + 1, 0);
+        for (std::size_t s = 0; s < setCount; ++s)
+        {
+            for (const typename IndexedDistanceSet_t::Constraint_t &c : indexed[s]->constraints)
+            {
+                const std::uint32_t island = owner(c.p1, c.p2);
+                if (island != none)
+                    ++indexedOffsets[island * setCount + s + 1];
+            }
+        }
+        prefixSum(indexedOffsets);
+        indexedList.resize(indexedOffsets.back());
+        next.assign(indexedOffsets.begin(), indexedOffsets.end() - 1);
+        for (std::size_t s = 0; s < setCount; ++s)
+        {
+            const std::vector<typename IndexedDistanceSet_t::Constraint_t> &cs = indexed[s]->constraints;
+            for (std::size_t i = 0; i < cs.size(); ++i)
+            {
+                const std::uint32_t island = owner(cs[i].p1, cs[i].p2);
+                if (island != none)
+                    indexedList[next[island * setCount + s]++] = static_cast<std::uint32_t>(i);
+            }
+        }
+
+        islandIterations.assign(count, 0);
+        source = constraints.begin();
+        sourceSize = constraints.size();
+        sources = indexed;
+        revisions.clear();
+        for (IndexedDistanceSet_t *set : indexed)
+            revisions.push_back(set->revision());
+        valid = true;
+    }
+
+    void invalidate() { valid = false; }
+
+    // true if built from these constraints and none have been added or reordered since
+    bool isBuiltFor(ConstraintRange_t constraints, const std::vector<IndexedDistanceSet_t *> &indexed) const
+    {
+        if (!valid || source != constraints.begin() || sourceSize != constraints.size() || sources != indexed)
+            return false;
+        for (std::size_t s = 0; s < indexed.size(); ++s)
+            if (indexed[s]->revision() != revisions[s])
+                return false;
+        return true;
+    }
+
+    std::size_t size() const { return islandIterations.size(); }
+    // island holding particle i, or none for static and unconstrained particles
+    std::uint32_t islandOf(std::size_t i) const { return particleIsland[i]; }
+    contiguous_range<const std::uint32_t> particles(std::size_t island) const
+    {
+        return {particleList.data() + particleOffsets[island], particleList.data() + particleOffsets[island + 1]};
+    }
+    std::size_t constraintCount(std::size_t island) const
+    {
+        return rangeOffsets[island + 1] - rangeOffsets[island] + indexedOffsets[(island + 1) * setCount] - indexedOffsets[island * setCount];
+    }
+    std::size_t constraintCount() const { return rangeList.size() + indexedList.size(); }
+    // range constraints whose particles World cannot index, solved outside the islands
+    contiguous_range<Constraint_t *> loose() { return {_loose}; }
+
+    // iterations for one island, 0 to use World's iterationCount. Reset when rebuilt.
+    void setIterations(std::size_t island, int iterations) { islandIterations[island] = iterations; }
+    int iterations(std::size_t island) const { return islandIterations[island]; }
+    // the most passes any island runs when the default is defaultIterations
+    int maxIterations(int defaultIterations) const
+    {
+        int n = defaultIterations;
+        for (int i : islandIterations)
+            n = i > n ? i : n;
+        return n;
+    }
+
+    // Constraint::warmStart for every constraint of one island
+    template <typename Particles>
+    void warmStart(std::size_t island, Particles &particles, T factor)
+    {
+        for (std::size_t i = rangeOffsets[island]; i < rangeOffsets[island + 1]; ++i)
+            rangeList[i]->warmStart(factor);
+        for (std::size_t s = 0; s < setCount; ++s)
+        {
+            const std::size_t begin = indexedOffsets[island * setCount + s];
+            const std::size_t end = indexedOffsets[island * setCount + s + 1];
+            if (begin != end)
+                sources[s]->warmStartIndices(particles, indexedList.data() + begin, end - begin, factor);
+        }
+    }
+
+    // run the iterations of one island over dt, Gauss-Seidel in the order the
+    // constraints were added. With a tolerance > 0 the island stops after a pass
+    // corrects no error above it. With a history, the residual of pass k is
+    // merged into history[k]. Returns the passes run.
+    template <typename Particles>
+    int solve(std::size_t island, Particles &particles, T dt, int defaultIterations, T tolerance = 0,
+        SolverResidual<T> *history = nullptr)
+    {
+        const int n = islandIterations[island] > 0 ? islandIterations[island] : defaultIterations;
+        const T iterationDt = dt / static_cast<T>(n);
+        for (int it = 0; it < n; ++it)
+        {
+            SolverResidual<T> residual;
+            SolverResidual<T> *measure = tolerance > T(0) || history != nullptr ? &residual : nullptr;
+            for (std::size_t i = rangeOffsets[island]; i < rangeOffsets[island + 1]; ++i)
+            {
+                const T error = rangeList[i]->solve(iterationDt);
+                if (measure != nullptr)
+                    measure->add(error);
+            }
+            for (std::size_t s = 0; s < setCount; ++s)
+            {
+                const std::size_t begin = indexedOffsets[island * setCount + s];
+                const std::size_t end = indexedOffsets[island * setCount + s + 1];
+                if (begin != end)
+                    sources[s]->solveIndices(particles, indexedList.data() + begin, end - begin, iterationDt, measure);
+            }
+            if (history != nullptr)
+                history[it].merge(residual);
+            if (tolerance > T(0) && residual.max <= tolerance)
+                return it + 1;
+        }
+        return n;
+    }
+
+private:
+    void connect(std::uint32_t a, std::uint32_t b)
+    {
+        if (!isStatic[a] && !isStatic[b])
+            sets.unite(a, b);
+    }
+
+    void markOwner(std::vector<std::uint8_t> &owns, std::uint32_t a, std::uint32_t b)
+    {
+        if (!isStatic[a])
+            owns[sets.find(a)] = 1;
+        else if (!isStatic[b])
+            owns[sets.find(b)] = 1;
+    }
+
+    // island of a constraint, none if both its particles are static
+    std::uint32_t owner(std::uint32_t a, std::uint32_t b) const
+    {
+        return !isStatic[a] ? particleIsland[a] : !isStatic[b] ? particleIsland[b] : none;
+    }
+
+    static void prefixSum(std::vector<std::size_t> &offsets)
+    {
+        for (std::size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+    }
+
+    union_find sets;
+    std::vector<std::uint8_t> isStatic;
+    std::vector<std::uint32_t> particleIsland;
+    std::vector<std::size_t> particleOffsets;
+    std::vector<std::uint32_t> particleList;
+    std::vector<std::size_t> rangeOffsets;
+    std::vector<Constraint_t *> rangeList;
+    std::vector<Constraint_t *> _loose;
+    std::size_t setCount = 0;
+    std::vector<std::size_t> indexedOffsets;
+    std::vector<std::uint32_t> indexedList;
+    std::vector<int> islandIterations;
+
+    const std::reference_wrapper<Constraint_t> *source = nullptr;
+    std::size_t sourceSize = 0;
+    std::vector<IndexedDistanceSet_t *> sources;
+    std::vector<std::size_t> revisions;
+    bool valid = false;
+};
+
+}
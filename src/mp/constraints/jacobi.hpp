@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "constraint.hpp"
+#include "indexed.hpp"
+#include "residual.hpp"
+#include "../parallel/executor.hpp"
+
+namespace mp {
+
+// Jacobi solve of IndexedDistanceSets for SolverMode::Jacobi. A pass works out
+// every constraint's impulse from the velocities at the start of the pass into
+// a buffer, then each particle gathers its share through a particle to
+// constraint adjacency (CSR). Neither stage writes where another chunk does, so
+// both split across the executor without colouring and give the same result
+// however they are split. Each set is solved as one block.
+//
+// A particle held by several constraints gets all their corrections at once, so
+// with averaging its share is divided by how many constraints it is in, and
+// every share is scaled by relaxation. Needs more passes than Gauss-Seidel.
+template <int Dim, typename T>
+class JacobiSolver
+{
+public:
+    using Vec_t = Vec<Dim, T>;
+    using IndexedDistanceSet_t = IndexedDistanceSet<Dim, T>;
+
+    // call if a set's constraints change without its revision changing, e.g.
+    // when it is replaced by another
+    void invalidate() { blocks.clear(); }
+
+    // one pass over set s of the sets solved, adding each constraint's error to residual
+    template <typename Particles>
+    void solve(std::size_t s, IndexedDistanceSet_t &set, Particles &particles, T dt, Executor *executor,
+        std::size_t grain, SolverResidual<T> *residual = nullptr)
+    {
+        block &b = prepare(s, set);
+        T *cached = set.cachesImpulses() ? set.impulses.data() : nullptr;
+        const auto impulses = [&](std::size_t begin, std::size_t end, SolverResidual<T> *r) {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const IndexedDistanceConstraint<T> &c = set.constraints[i];
+                auto &&p1 = particles[c.p1];
+                auto &&p2 = particles[c.p2];
+                const T constraintMass = p1.inverseMass + p2.inverseMass;
+                T error = 0;
+                b.lambda[i] = constraintMass > T(0) ? detail::distance_impulse(p1, p2, relativePosition(set, p1, p2),
+                    c.length, set.strength, set.biasFactor, dt, constraintMass, b.direction[i], error) : T(0);
+                if (cached != nullptr)
+                    cached[i] += b.lambda[i];
+                if (r != nullptr)
+                    r->add(error);
+            }
+        };
+        if (residual == nullptr)
+            parallel_for(executor, 0, set.constraints.size(), grain, [&](std::size_t begin, std::size_t end) {
+                impulses(begin, end, nullptr);
+            });
+        else
+            detail::parallel_residual(executor, 0, set.constraints.size(), grain, *residual, residualSlots,
+                [&](std::size_t begin, std::size_t end, SolverResidual<T> &chunk) {
+                    impulses(begin, end, &chunk);
+                });
+        gather(b, particles, executor, grain);
+    }
+
+    // Constraint::warmStart for every constraint of set s: a pass applying the
+    // scaled cached impulses, shared out as the passes that cached them were
+    template <typename Particles>
+    void warmStart(std::size_t s, IndexedDistanceSet_t &set, Particles &particles, T factor, Executor *executor,
+        std::size_t grain)
+    {
+        block &b = prepare(s, set);
+        set.cacheImpulses();
+        T *cached = set.impulses.data();
+        parallel_for(executor, 0, set.constraints.size(), grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const IndexedDistanceConstraint<T> &c = set.constraints[i];
+                auto &&p1 = particles[c.p1];
+                auto &&p2 = particles[c.p2];
+                cached[i] *= factor;
+                b.lambda[i] = p1.inverseMass + p2.inverseMass > T(0) ? cached[i] : T(0);
+                const Vec_t relative = relativePosition(set, p1, p2);
+                const T distance = relative.length();
+                b.direction[i] = distance > T(0) ? relative / distance : relative;
+            }
+        });
+        gather(b, particles, executor, grain);
+    }
+
+    // divide each particle's share by its constraint count
+    bool averaging = true;
+    // scale applied to every share
+    T relaxation = 1;
+
+private:
+    struct block
+    {
+        const IndexedDistanceSet_t *set = nullptr;
+        std::size_t revision = 0;
+        std::size_t size = 0;
+        // constraints of particle k are entries[offsets[k], offsets[k + 1]), each
+        // a constraint index times 2, plus 1 if the particle is its p2
+        std::vector<std::uint32_t> offsets;
+        std::vector<std::uint32_t> entries;
+        std::vector<T> lambda;
+        std::vector<Vec_t> direction;
+    };
+
+    template <typename P>
+    static Vec_t relativePosition(const IndexedDistanceSet_t &set, const P &p1, const P &p2)
+    {
+        return detail::wrap_axes<Dim, T>(p1.position - p2.position, set.wrapRange);
+    }
+
+    // the adjacency of set s, rebuilt if the set has changed
+    block &prepare(std::size_t s, const IndexedDistanceSet_t &set)
+    {
+        if (blocks.size() <= s)
+            blocks.resize(s + 1);
+        block &b = blocks[s];
+        if (b.set == &set && b.revision == set.revision() && b.size == set.size())
+            return b;
+
+        std::uint32_t particleCount = 0;
+        for (const IndexedDistanceConstraint<T> &c : set.constraints)
+            particleCount = std::max(particleCount, std::max(c.p1, c.p2) + 1);
+        b.offsets.assign(particleCount + 1, 0);
+        for (const IndexedDistanceConstraint<T> &c : set.constraints)
+        {
+            ++b.offsets[c.p1 + 1];
+            ++b.offsets[c.p2 + 1];
+        }
+        for (std::uint32_t k = 0; k < particleCount; ++k)
+            b.offsets[k + 1] += b.offsets[k];
+        b.entries.resize(b.offsets.back());
+        std::vector<std::uint32_t> next(b.offsets.begin(), b.offsets.end() - 1);
+        for (std::size_t i = 0; i < set.constraints.size(); ++i)
+        {
+            const IndexedDistanceConstraint<T> &c = set.constraints[i];
+            b.entries[next[c.p1]++] = static_cast<std::uint32_t>(2 * i);
+            b.entries[next[c.p2]++] = static_cast<std::uint32_t>(2 * i + 1);
+        }
+        b.lambda.resize(set.size());
+        b.direction.resize(set.size());
+        b.set = &set;
+        b.revision = set.revision();
+        b.size = set.size();
+        return b;
+    }
+
+    // add each particle's share of the buffered impulses to its velocity
+    template <typename Particles>
+    void gather(const block &b, Particles &particles, Executor *executor, std::size_t grain)
+    {
+        parallel_for(executor, 0, b.offsets.size() - 1, grain, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; ++k)
+            {
+                const std::uint32_t first = b.offsets[k];
+                const std::uint32_t last = b.offsets[k + 1];
+                if (first == last)
+                    continue;
+                Vec_t impulse{};
+                for (std::uint32_t e = first; e < last; ++e)
+                {
+                    const std::uint32_t i = b.entries[e] >> 1;
+                    const T lambda = (b.entries[e] & 1) != 0 ? -b.lambda[i] : b.lambda[i];
+                    impulse += b.direction[i] * lambda;
+                }
+                impulse *= averaging ? relaxation / static_cast<T>(last - first) : relaxation;
+                particles[k].applyImpulse(impulse);
+            }
+        });
+    }
+
+    std::vector<block> blocks;
+    std::vector<SolverResidual<T>> residualSlots;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "../parallel/executor.hpp"
+
+namespace mp {
+
+// How much one pass of the solver had to correct: the largest and the root
+// mean square velocity error over the constraints it solved. Constraints that
+// cannot move count as 0.
+template <typename T>
+struct SolverResidual
+{
+    T max = 0;
+    T sumSquares = 0;
+    std::size_t count = 0;
+
+    void add(T error)
+    {
+        const T e = error < T(0) ? -error : error;
+        max = e > max ? e : max;
+        sumSquares += e * e;
+        ++count;
+    }
+    void merge(const SolverResidual &other)
+    {
+        max = other.max > max ? other.max : max;
+        sumSquares += other.sumSquares;
+        count += other.count;
+    }
+    T rms() const { return count > 0 ? std::sqrt(sumSquares / static_cast<T>(count)) : T(0); }
+};
+
+namespace detail {
+
+// parallel_for passing each chunk its own residual to add to, merged into
+// residual afterwards. Chunks start at begin + k * grain, so each finds its
+// slot without any locking.
+template <typename T, typename Fn>
+void parallel_residual(Executor *executor, std::size_t begin, std::size_t end, std::size_t grain,
+    SolverResidual<T> &residual, std::vector<SolverResidual<T>> &slots, Fn &&fn)
+{
+    if (end <= begin)
+        return;
+    grain = grain < 1 ? 1 : grain;
+    slots.assign((end - begin + grain - 1) / grain, SolverResidual<T>{});
+    parallel_for(executor, begin, end, grain, [&](std::size_t b, std::size_t e) {
+        fn(b, e, slots[(b - begin) / grain]);
+    });
+    for (const SolverResidual<T> &slot : slots)
+        residual.merge(slot);
+}
+
+} // namespace detail
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mp {
+
+// A force applied to a span [begin, end) of World's particle storage once per
+// step, adding into each particle's force accumulator.
+template <typename Particles>
+class Force
+{
+public:
+    virtual ~Force() {}
+    virtual void apply(Particles &particles, std::size_t begin, std::size_t end) = 0;
+};
+
+namespace detail {
+
+// true if F can be called as f(particles, begin, end)
+template <typename F, typename Particles, typename = void>
+struct is_span_force : std::false_type {};
+template <typename F, typename Particles>
+struct is_span_force<F, Particles, decltype(void(std::declval<F &>()(
+    std::declval<Particles &>(), std::size_t{}, std::size_t{})))> : std::true_type {};
+
+// callable taking the whole span
+template <typename Particles, typename F>
+class span_force : public Force<Particles>
+{
+public:
+    span_force(F f) : f(std::move(f)) {}
+    void apply(Particles &particles, std::size_t begin, std::size_t end) override
+    {
+        f(particles, begin, end);
+    }
+private:
+    F f;
+};
+
+// callable returning the force on one particle, looped over the span here so
+// the call can be inlined
+template <typename Particles, typename F>
+class particle_force : public Force<Particles>
+{
+public:
+    particle_force(F f) : f(std::move(f)) {}
+    void apply(Particles &particles, std::size_t begin, std::size_t end) override
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            auto &&particle = particles[i];
+            particle.forceAccumulator += f(particle);
+        }
+    }
+private:
+    F f;
+};
+
+} // namespace detail
+
+// Sum of several per-particle forces evaluated in a single pass. Registering
+// fuse(drag, buoyancy) costs one indirect call per span rather than one per
+// force, and lets the compiler combine the loops.
+template <typename... Fs>
+class fused_force
+{
+public:
+    fused_force(Fs... fs) : forces(std::move(fs)...) {}
+
+    template <typename P>
+    auto operator()(P &&particle) { return sum<0>(particle); }
+
+private:
+    template <std::size_t I, typename P>
+    auto sum(P &particle) -> std::enable_if_t<I + 1 == sizeof...(Fs), decltype(std::get<I>(std::declval<std::tuple<Fs...> &>())(particle))>
+    {
+        return std::get<I>(forces)(particle);
+    }
+    template <std::size_t I, typename P>
+    auto sum(P &particle) -> std::enable_if_t<(I + 1 < sizeof...(Fs)), decltype(std::get<I>(std::declval<std::tuple<Fs...> &>())(particle))>
+    {
+        auto force = std::get<I>(forces)(particle);
+        force += sum<I + 1>(particle);
+        return force;
+    }
+
+    std::tuple<Fs...> forces;
+};
+
+template <typename... Fs>
+fused_force<Fs...> fuse(Fs... fs)
+{
+    static_assert(sizeof...(Fs) > 0, "fuse needs at least one force");
+    return fused_force<Fs...>(std::move(fs)...);
+}
+
+// Owning list of forces World applies to each span of particles before
+// velocity integration.
+template <typename Particles>
+class ForceRegistry
+{
+public:
+    using Force_t = Force<Particles>;
+
+    // F is either called as f(particles, begin, end) and adds to the force
+    // accumulators itself, or called as f(particle) and returns a force
+    template <typename F>
+    Force_t &add(F f)
+    {
+        using Force_impl = typename std::conditional<detail::is_span_force<F, Particles>::value,
+            detail::span_force<Particles, F>, detail::particle_force<Particles, F>>::type;
+        forces.emplace_back(new Force_impl(std::move(f)));
+        return *forces.back();
+    }
+
+    void remove(const Force_t &force)
+    {
+        for (auto it = forces.begin(); it != forces.end(); ++it)
+        {
+            if (it->get() == &force)
+            {
+                forces.erase(it);
+                return;
+            }
+        }
+    }
+
+    void clear() { forces.clear(); }
+    bool empty() const { return forces.empty(); }
+    std::size_t size() const { return forces.size(); }
+
+    void apply(Particles &particles, std::size_t begin, std::size_t end)
+    {
+        for (const std::unique_ptr<Force_t> &force : forces)
+            force->apply(particles, begin, end);
+    }
+
+private:
+    std::vector<std::unique_ptr<Force_t>> forces;
+};
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include "../utility/clock.hpp"
+
+namespace mp {
+
+// what World::step does when the time accumulated needs more sub-steps than
+// it is allowed to run
+enum class OverloadPolicy
+{
+    // run the allowed sub-steps and discard the rest of the time
+    DropTime,
+    // run the allowed sub-steps, each covering more time, up to maxStretch
+    StretchTime,
+    // fewer constraint iterations per sub-step so more sub-steps fit the budget.
+    // Only helps when the budget is what limits the sub-steps; against
+    // maxSubSteps alone it drops time as DropTime does.
+    ReduceIterations
+};
+
+// per World report on the last call to step
+template <typename T>
+struct StepStatus
+{
+    int subSteps = 0;
+    int neededSubSteps = 0;
+    int iterations = 0;
+    // constraint passes actually run over all sub-steps, fewer than
+    // subSteps * iterations when a solver tolerance stopped some early
+    int iterationsRun = 0;
+    // length of each sub-step relative to stepSize
+    T stretch = 1;
+    // simulated time discarded by the last call
+    T droppedTime = 0;
+    // measured seconds per sub-step at the full iteration count
+    T subStepCost = 0;
+    bool overloaded = false;
+    // overloaded calls since the World was made
+    std::uint32_t overloadCount = 0;
+};
+
+// Decides how many sub-steps a call to World::step may run. maxSubSteps is a
+// hard cap, and with a budget the measured cost of a sub-step limits them
+// further, so a slow frame can never make the next one slower. With neither,
+// every sub-step needed is run, as World always did.
+template <typename T>
+class StepGovernor
+{
+public:
+    using clock_fn = std::uint32_t (*)(void);
+
+    struct Plan
+    {
+        int subSteps;
+        int iterations;
+        T stretch;
+        T droppedSteps;
+        bool overloaded;
+    };
+
+    // sub-steps one call may run, 0 for no limit
+    int maxSubSteps = 0;
+    // seconds of wall time one call may spend sub-stepping, 0 for no limit
+    T budget = 0;
+    OverloadPolicy policy = OverloadPolicy::DropTime;
+    T maxStretch = 4;
+    int minIterations = 1;
+    // weight of each new measurement in the running cost
+    T smoothing = T(0.2);
+    // microsecond clock used to measure sub-steps
+    clock_fn clock = mp_micros;
+
+    // sub-steps that fit this call at the full iteration count
+    int allowedSubSteps() const { return allowedAt(1); }
+
+    // more sub-steps than this are never run in one call under any policy
+    int countLimit() const
+    {
+        if (maxSubSteps < 1)
+            return std::numeric_limits<int>::max();
+        return static_cast<int>(static_cast<T>(maxSubSteps) * (maxStretch > T(1) ? maxStretch : T(1))) + 1;
+    }
+
+    Plan plan(int needed, int iterationCount) const
+    {
+        Plan p{needed, iterationCount, T(1), T(0), false};
+        const int allowed = allowedSubSteps();
+        if (needed <= allowed)
+            return p;
+
+        p.overloaded = true;
+        switch (policy)
+        {
+        case OverloadPolicy::DropTime:
+            p.subSteps = allowed;
+            break;
+        case OverloadPolicy::StretchTime:
+        {
+            p.subSteps = allowed;
+            p.stretch = static_cast<T>(needed) / static_cast<T>(allowed);
+            if (p.stretch > maxStretch)
+                p.stretch = maxStretch;
+            break;
+        }
+        case OverloadPolicy::ReduceIterations:
+        {
+            p.subSteps = allowed;
+            // cheaper sub-steps only help if the budget rather than maxSubSteps is the limit
+            const int target = needed < cap() ? needed : cap();
+            if (allowed >= target)
+                break;
+            // the most iterations at which the sub-steps reach target, or the fewest allowed
+            const int least = minIterations < iterationCount ? minIterations : iterationCount;
+            for (p.iterations = iterationCount; p.iterations > least; --p.iterations)
+                if (allowedAt(scale(p.iterations, iterationCount)) >= target)
+                    break;
+            const int reduced = allowedAt(scale(p.iterations, iterationCount));
+            p.subSteps = target < reduced ? target : reduced;
+            break;
+        }
+        }
+        p.droppedSteps = static_cast<T>(needed) - static_cast<T>(p.subSteps) * p.stretch;
+        return p;
+    }
+
+    // feed back the time taken by the sub-steps of a plan
+    void record(std::uint32_t elapsedMicros, const Plan &p, int iterationCount)
+    {
+        if (p.subSteps == 0)
+            return;
+        T perStep = static_cast<T>(elapsedMicros) * T(1e-6) / static_cast<T>(p.subSteps);
+        perStep *= static_cast<T>(1 + iterationCount) / static_cast<T>(1 + p.iterations);
+        cost = cost == T(0) ? perStep : cost + (perStep - cost) * smoothing;
+    }
+
+    T subStepCost() const { return cost; }
+
+private:
+    int cap() const { return maxSubSteps < 1 ? std::numeric_limits<int>::max() : maxSubSteps; }
+
+    // a sub-step costs roughly its integration plus one share per iteration
+    static T scale(int iterations, int iterationCount)
+    {
+        return static_cast<T>(1 + iterations) / static_cast<T>(1 + iterationCount);
+    }
+
+    int allowedAt(T costScale) const
+    {
+        int allowed = cap();
+        if (budget > T(0) && cost > T(0))
+        {
+            const T fit = budget / (cost * costScale);
+            if (fit < static_cast<T>(allowed))
+                allowed = fit < T(1) ? 1 : static_cast<int>(fit);
+        }
+        return allowed;
+    }
+
+    T cost = 0;
+};
+
+}
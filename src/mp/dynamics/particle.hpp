@@ -16,6 +16,11 @@ struct Particle
     { 
         linearVelocity += impulse * inverseMass; 
     }
+    // move by a position-level impulse, for XPBD
+    void applyCorrection(const Vec_t &correction)
+    {
+        position += correction * inverseMass;
+    }
     void applyForce(const Vec_t &force)
     {
         forceAccumulator += force;
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "../common/vec.hpp"
+#include "../utility/memory.hpp"
+#include "../utility/range.hpp"
+#include "particle.hpp"
+
+namespace mp {
+
+// proxy for a Vec whose components live in separate per-axis arrays
+template <int Dim, typename T>
+struct vec_ref
+{
+    using Vec_t = Vec<Dim, T>;
+
+    vec_ref(T *const *axes, std::size_t index)
+    {
+        for (int i = 0; i < Dim; ++i)
+            elements[i] = axes[i] + index;
+    }
+    vec_ref(const vec_ref &) = default;
+
+    T &operator[](int i) const { return *elements[i]; }
+
+    template <int D = Dim>
+    typename std::enable_if<(D > 0), T &>::type
+    x() const { return *elements[0]; }
+
+    template <int D = Dim>
+    typename std::enable_if<(D > 1), T &>::type
+    y() const { return *elements[1]; }
+
+    template <int D = Dim>
+    typename std::enable_if<(D > 2), T &>::type
+    z() const { return *elements[2]; }
+
+    template <int D = Dim>
+    typename std::enable_if<(D > 3), T &>::type
+    w() const { return *elements[3]; }
+
+    Vec_t value() const
+    {
+        Vec_t v;
+        for (int i = 0; i < Dim; ++i)
+            v[i] = *elements[i];
+        return v;
+    }
+    operator Vec_t() const { return value(); }
+
+    // assignment writes through to the underlying arrays
+    const vec_ref &operator=(const Vec_t &v) const
+    {
+        for (int i = 0; i < Dim; ++i)
+            *elements[i] = v[i];
+        return *this;
+    }
+    const vec_ref &operator=(const vec_ref &other) const { return *this = other.value(); }
+
+    const vec_ref &operator+=(const Vec_t &v) const { return *this = value() + v; }
+    const vec_ref &operator-=(const Vec_t &v) const { return *this = value() - v; }
+    const vec_ref &operator*=(const T s) const { return *this = value() * s; }
+    const vec_ref &operator/=(const T s) const { return *this = value() / s; }
+
+    T lengthSquared(void) const { return value().lengthSquared(); }
+    T length(void) const { return value().length(); }
+    Vec_t normalised(void) const { return value().normalised(); }
+    Vec_t operator-(void) const { return -value(); }
+
+    friend Vec_t operator+(const vec_ref &lhs, const vec_ref &rhs) { return lhs.value() + rhs.value(); }
+    friend Vec_t operator-(const vec_ref &lhs, const vec_ref &rhs) { return lhs.value() - rhs.value(); }
+    friend Vec_t operator*(const vec_ref &lhs, const T rhs) { return lhs.value() * rhs; }
+    friend Vec_t operator*(const T lhs, const vec_ref &rhs) { return lhs * rhs.value(); }
+    friend Vec_t operator/(const vec_ref &lhs, const T rhs) { return lhs.value() / rhs; }
+
+private:
+    std::array<T *, Dim> elements;
+};
+
+// proxy giving a Particle-like interface onto one slot of a ParticleStore
+template <int Dim, typename T>
+struct particle_ref
+{
+    using Vec_t = Vec<Dim, T>;
+    using Particle_t = Particle<Dim, T>;
+
+    particle_ref(T *inverseMass, T *const *position, T *const *linearVelocity, T *const *forceAccumulator, std::size_t index)
+        : inverseMass(inverseMass[index]), position(position, index),
+        linearVelocity(linearVelocity, index), forceAccumulator(forceAccumulator, index) {}
+
+    T &inverseMass;
+    vec_ref<Dim, T> position, linearVelocity, forceAccumulator;
+
+    void applyImpulse(const Vec_t &impulse) const
+    {
+        linearVelocity += impulse * inverseMass;
+    }
+    void applyCorrection(const Vec_t &correction) const
+    {
+        position += correction * inverseMass;
+    }
+    void applyForce(const Vec_t &force) const
+    {
+        forceAccumulator += force;
+    }
+    void integrateVelocity(T dt) const
+    {
+        const Vec_t acceleration = forceAccumulator * inverseMass;
+        linearVelocity += acceleration * dt;
+        forceAccumulator = Vec_t{};
+    }
+    void integratePosition(T dt) const
+    {
+        position += linearVelocity * dt;
+    }
+
+    operator Particle_t() const
+    {
+        Particle_t p;
+        p.inverseMass = inverseMass;
+        p.position = position;
+        p.linearVelocity = linearVelocity;
+        p.forceAccumulator = forceAccumulator;
+        return p;
+    }
+    const particle_ref &operator=(const Particle_t &p) const
+    {
+        inverseMass = p.inverseMass;
+        position = p.position;
+        linearVelocity = p.linearVelocity;
+        forceAccumulator = p.forceAccumulator;
+        return *this;
+    }
+};
+
+// structure-of-arrays particle container. Each axis of position, velocity and
+// force lives in its own cache-line aligned array so the phases of World::step
+// only pull in the fields they touch.
+template <int Dim, typename T>
+class ParticleStore
+{
+    template <typename U>
+    using array_t = std::vector<U, aligned_allocator<U>>;
+
+public:
+    using Vec_t = Vec<Dim, T>;
+    using Particle_t = Particle<Dim, T>;
+    using reference = particle_ref<Dim, T>;
+
+    // non-owning view of a store, the SoA counterpart to contiguous_range<Particle_t>.
+    // Invalidated if the store is resized.
+    class range
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Particle_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = particle_ref<Dim, T>;
+
+            iterator(const range *r, std::size_t index) : r(r), index(index) {}
+            reference operator*() const { return (*r)[index]; }
+            iterator &operator++() { ++index; return *this; }
+            iterator operator++(int) { iterator tmp = *this; ++index; return tmp; }
+            bool operator==(const iterator &other) const { return index == other.index; }
+            bool operator!=(const iterator &other) const { return index != other.index; }
+        private:
+            const range *r;
+            std::size_t index;
+        };
+
+        range() : _inverseMass(nullptr), _position{}, _linearVelocity{}, _forceAccumulator{}, _size(0) {}
+        range(ParticleStore &store)
+            : _inverseMass(store._inverseMass.data()), _size(store.size())
+        {
+            for (int i = 0; i < Dim; ++i)
+            {
+                _position[i] = store._position[i].data();
+                _linearVelocity[i] = store._linearVelocity[i].data();
+                _forceAccumulator[i] = store._forceAccumulator[i].data();
+            }
+        }
+
+        // over arrays held elsewhere, e.g. a mapped Checkpoint
+        range(T *inverseMass, const std::array<T *, Dim> &position, const std::array<T *, Dim> &linearVelocity,
+            const std::array<T *, Dim> &forceAccumulator, std::size_t size)
+            : _inverseMass(inverseMass), _position(position), _linearVelocity(linearVelocity),
+            _forceAccumulator(forceAccumulator), _size(size) {}
+
+        reference operator[](std::size_t i) const
+        {
+            return reference(_inverseMass, _position.data(), _linearVelocity.data(), _forceAccumulator.data(), i);
+        }
+        iterator begin() const { return iterator(this, 0); }
+        iterator end() const { return iterator(this, _size); }
+        std::size_t size() const { return _size; }
+
+        T *inverseMass() const { return _inverseMass; }
+        T *position(int axis) const { return _position[axis]; }
+        T *linearVelocity(int axis) const { return _linearVelocity[axis]; }
+        T *forceAccumulator(int axis) const { return _forceAccumulator[axis]; }
+
+    private:
+        T *_inverseMass;
+        std::array<T *, Dim> _position, _linearVelocity, _forceAccumulator;
+        std::size_t _size;
+    };
+
+    ParticleStore() = default;
+    explicit ParticleStore(std::size_t n) { resize(n); }
+    ParticleStore(contiguous_range<Particle_t> particles)
+    {
+        reserve(particles.size());
+        for (const Particle_t &p : particles)
+            push_back(p);
+    }
+
+    void reserve(std::size_t n)
+    {
+        _inverseMass.reserve(n);
+        for (int i = 0; i < Dim; ++i)
+        {
+            _position[i].reserve(n);
+            _linearVelocity[i].reserve(n);
+            _forceAccumulator[i].reserve(n);
+        }
+    }
+
+    // new particles match the defaults of Particle
+    void resize(std::size_t n)
+    {
+        _inverseMass.resize(n, T{1.0});
+        for (int i = 0; i < Dim; ++i)
+        {
+            _position[i].resize(n);
+            _linearVelocity[i].resize(n);
+            _forceAccumulator[i].resize(n);
+        }
+    }
+
+    void push_back(const Particle_t &p)
+    {
+        _inverseMass.push_back(p.inverseMass);
+        for (int i = 0; i < Dim; ++i)
+        {
+            _position[i].push_back(p.position[i]);
+            _linearVelocity[i].push_back(p.linearVelocity[i]);
+            _forceAccumulator[i].push_back(p.forceAccumulator[i]);
+        }
+    }
+
+    std::size_t size() const { return _inverseMass.size(); }
+    reference operator[](std::size_t i) { return range(*this)[i]; }
+    Particle_t get(std::size_t i) const
+    {
+        Particle_t p;
+        p.inverseMass = _inverseMass[i];
+        for (int d = 0; d < Dim; ++d)
+        {
+            p.position[d] = _position[d][i];
+            p.linearVelocity[d] = _linearVelocity[d][i];
+            p.forceAccumulator[d] = _forceAccumulator[d][i];
+        }
+        return p;
+    }
+
+    T *inverseMass() { return _inverseMass.data(); }
+    T *position(int axis) { return _position[axis].data(); }
+    T *linearVelocity(int axis) { return _linearVelocity[axis].data(); }
+    T *forceAccumulator(int axis) { return _forceAccumulator[axis].data(); }
+    const T *inverseMass() const { return _inverseMass.data(); }
+    const T *position(int axis) const { return _position[axis].data(); }
+    const T *linearVelocity(int axis) const { return _linearVelocity[axis].data(); }
+    const T *forceAccumulator(int axis) const { return _forceAccumulator[axis].data(); }
+
+private:
+    array_t<T> _inverseMass;
+    std::array<array_t<T>, Dim> _position, _linearVelocity, _forceAccumulator;
+};
+
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "../common/vec.hpp"
+#include "../utility/range.hpp"
+
+namespace mp {
+
+namespace detail {
+
+// index of particle within AoS storage, false if it lives elsewhere
+template <typename P>
+bool particle_index(contiguous_range<P> &particles, const P &particle, std::uint32_t &index)
+{
+    if (&particle < particles.begin() || &particle >= particles.end())
+        return false;
+    index = static_cast<std::uint32_t>(&particle - particles.begin());
+    return true;
+}
+
+// other storage cannot be referred to by a Particle &
+template <typename Particles, typename P>
+bool particle_index(Particles &, const P &, std::uint32_t &)
+{
+    return false;
+}
+
+} // namespace detail
+
+// Per-particle sleep tracking. A particle is quiet once its kinetic energy has
+// stayed below threshold for window steps, and a connected group of particles
+// is put to sleep, velocities zeroed, when all of it is quiet. Sleeping a whole
+// group at once means no constraint joins a sleeping particle to an awake one.
+// Awake particles are kept as runs of consecutive indices so the step loops
+// skip sleeping ones entirely. Static particles (inverse mass 0) never sleep and
+// do not join groups, but stay in the runs so kinematic ones keep moving; one
+// given a velocity wakes the groups it touches.
+//
+// Nothing scans the sleeping particles for wakes. A group wakes through wake(),
+// through a moving static particle, or through a touch point: a sleeping
+// particle joined by a constraint World cannot track, checked for velocity
+// every step.
+template <int Dim, typename T>
+class SleepState
+{
+public:
+    using run = std::pair<std::size_t, std::size_t>;
+
+    // kinetic energy below which a particle counts as quiet
+    T threshold = T(1e-4);
+    // consecutive quiet steps before a particle may sleep
+    std::uint32_t window = 60;
+
+    // start tracking particles with everything awake, discarding any
+    // connections and touch points
+    template <typename Particles>
+    void reset(Particles &particles)
+    {
+        const std::size_t n = particles.size();
+        asleep.assign(n, 0);
+        quietSteps.assign(n, 0);
+        visited.assign(n, 0);
+        epoch = 0;
+        statics.clear();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (particles[i].inverseMass != T{})
+                continue;
+            asleep[i] = isStatic;
+            statics.push_back(static_cast<std::uint32_t>(i));
+        }
+        touchPoints.clear();
+        edges.clear();
+        offsets.assign(n + 1, 0);
+        neighbours.clear();
+        rebuildRuns();
+    }
+
+    // record a constraint between particles a and b; call buildNeighbours when done
+    void connect(std::uint32_t a, std::uint32_t b) { edges.emplace_back(a, b); }
+    // record a constraint between particle i and one that is not tracked
+    void touch(std::uint32_t i) { touchPoints.push_back(i); }
+
+    void buildNeighbours()
+    {
+        offsets.assign(asleep.size() + 1, 0);
+        for (const std::pair<std::uint32_t, std::uint32_t> &edge : edges)
+        {
+            ++offsets[edge.first + 1];
+            ++offsets[edge.second + 1];
+        }
+        for (std::size_t i = 1; i < offsets.size(); ++i)
+            offsets[i] += offsets[i - 1];
+        neighbours.resize(offsets.back());
+        std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+        for (const std::pair<std::uint32_t, std::uint32_t> &edge : edges)
+        {
+            neighbours[next[edge.first]++] = edge.second;
+            neighbours[next[edge.second]++] = edge.first;
+        }
+    }
+
+    bool isAsleep(std::size_t i) const { return asleep[i] == sleeping; }
+    // asleep or static; a constraint between two resting particles need not be solved
+    bool isResting(std::size_t i) const { return asleep[i] != 0; }
+    std::size_t size() const { return asleep.size(); }
+    // awake particles that are not static
+    std::size_t awakeCount() const { return awake; }
+    const std::vector<run> &awakeRuns() const { return runs; }
+
+    // wake i and everything connected to it, taking effect from the next step
+    void wake(std::size_t i)
+    {
+        if (asleep[i] != sleeping)
+            return;
+        ++epoch;
+        collectGroup(i);
+        for (std::uint32_t j : group)
+        {
+            asleep[j] = 0;
+            quietSteps[j] = 0;
+        }
+        changed = true;
+        runsDirty = true;
+    }
+
+    // true once after the set of sleeping particles changes
+    bool takeChanged()
+    {
+        const bool c = changed;
+        changed = false;
+        return c;
+    }
+
+    // wake the groups around static particles that are moving, and of touch
+    // points given a velocity since they fell asleep
+    template <typename Particles>
+    void wakeDisturbed(Particles &particles)
+    {
+        for (std::uint32_t i : statics)
+        {
+            if (particles[i].linearVelocity.lengthSquared() == T{})
+                continue;
+            for (std::size_t n = offsets[i]; n < offsets[i + 1]; ++n)
+                wake(neighbours[n]);
+        }
+        for (std::uint32_t i : touchPoints)
+        {
+            if (asleep[i] == sleeping && particles[i].linearVelocity.lengthSquared() != T{})
+                wake(i);
+        }
+        if (runsDirty)
+            rebuildRuns();
+    }
+
+    // count quiet steps for awake particles and put to sleep groups that are
+    // entirely quiet
+    template <typename Particles>
+    void update(Particles &particles)
+    {
+        bool anyQuiet = false;
+        for (const run &r : runs)
+        {
+            for (std::size_t i = r.first; i < r.second; ++i)
+            {
+                if (asleep[i] == isStatic)
+                    continue;
+                if (isQuiet(particles[i]))
+                    anyQuiet |= ++quietSteps[i] >= window;
+                else
+                    quietSteps[i] = 0;
+            }
+        }
+        if (!anyQuiet)
+            return;
+
+        bool slept = false;
+        ++epoch;
+        for (const run &r : runs)
+        {
+            for (std::size_t i = r.first; i < r.second; ++i)
+            {
+                if (asleep[i] == isStatic || quietSteps[i] < window || visited[i] == epoch)
+                    continue;
+                collectGroup(i);
+                bool groupQuiet = true;
+                for (std::uint32_t j : group)
+                    groupQuiet = groupQuiet && quietSteps[j] >= window;
+                if (!groupQuiet)
+                    continue;
+                for (std::uint32_t j : group)
+                {
+                    particles[j].linearVelocity = Vec<Dim, T>{};
+                    asleep[j] = sleeping;
+                }
+                slept = true;
+            }
+        }
+        if (slept)
+        {
+            changed = true;
+            rebuildRuns();
+        }
+    }
+
+private:
+    template <typename P>
+    bool isQuiet(const P &particle) const
+    {
+        // 0.5 v^2 / inverseMass < threshold, without the divide
+        return T(0.5) * particle.linearVelocity.lengthSquared() < threshold * particle.inverseMass;
+    }
+
+    // fill group with the non static particles connected to i, marking them
+    // visited in the current epoch
+    void collectGroup(std::size_t i)
+    {
+        group.clear();
+        group.push_back(static_cast<std::uint32_t>(i));
+        visited[i] = epoch;
+        for (std::size_t g = 0; g < group.size(); ++g)
+        {
+            const std::uint32_t p = group[g];
+            for (std::size_t n = offsets[p]; n < offsets[p + 1]; ++n)
+            {
+                const std::uint32_t q = neighbours[n];
+                if (visited[q] == epoch || asleep[q] == isStatic)
+                    continue;
+                visited[q] = epoch;
+                group.push_back(q);
+            }
+        }
+    }
+
+    void rebuildRuns()
+    {
+        runsDirty = false;
+        runs.clear();
+        awake = 0;
+        std::size_t i = 0;
+        while (i < asleep.size())
+        {
+            if (asleep[i] == sleeping)
+            {
+                ++i;
+                continue;
+            }
+            const std::size_t begin = i;
+            for (; i < asleep.size() && asleep[i] != sleeping; ++i)
+                awake += asleep[i] == 0 ? 1 : 0;
+            runs.emplace_back(begin, i);
+        }
+    }
+
+    // values of asleep; 0 when awake
+    enum : std::uint8_t { sleeping = 1, isStatic = 2 };
+
+    std::vector<std::uint8_t> asleep;
+    std::vector<std::uint32_t> quietSteps;
+    std::vector<std::uint32_t> statics;
+    std::vector<std::uint32_t> touchPoints;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint32_t> neighbours;
+    std::vector<run> runs;
+    std::vector<std::uint32_t> visited;
+    std::vector<std::uint32_t> group;
+    std::uint32_t epoch = 0;
+    std::size_t awake = 0;
+    bool changed = false;
+    bool runsDirty = false;
+};
+
+}
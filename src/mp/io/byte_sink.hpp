@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace mp {
+
+// Somewhere bytes can be written: a file, a pipe, a serial port
+class ByteSink
+{
+public:
+    virtual ~ByteSink() {}
+    // false if not every byte could be written
+    virtual bool write(const std::uint8_t *data, std::size_t size) = 0;
+    virtual void flush() {}
+};
+
+// appends to a vector, e.g. to test or to send on by other means
+class VectorSink : public ByteSink
+{
+public:
+    bool write(const std::uint8_t *data, std::size_t size) override
+    {
+        bytes.insert(bytes.end(), data, data + size);
+        return true;
+    }
+
+    std::vector<std::uint8_t> bytes;
+};
+
+// writes to a stdio stream the caller opened and closes
+class FileSink : public ByteSink
+{
+public:
+    explicit FileSink(std::FILE *file) : file(file) {}
+    bool write(const std::uint8_t *data, std::size_t size) override
+    {
+        return std::fwrite(data, 1, size, file) == size;
+    }
+    void flush() override { std::fflush(file); }
+
+private:
+    std::FILE *file;
+};
+
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "../World.hpp"
+
+namespace mp {
+
+namespace detail {
+
+enum : std::uint32_t { checkpoint_version = 7, checkpoint_byte_order = 0x01020304 };
+// sections and SoA arrays start on cache line boundaries
+enum : std::size_t { checkpoint_alignment = 64 };
+
+enum class checkpoint_layout : std::uint8_t { Particles = 0, Store = 1 };
+
+inline std::size_t checkpoint_align(std::size_t n)
+{
+    return (n + checkpoint_alignment - 1) & ~std::size_t(checkpoint_alignment - 1);
+}
+
+// the start of every checkpoint, written as is so it can be read in place
+template <int Dim, typename T>
+struct checkpoint_header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t size;
+    std::uint64_t particleCount;
+    std::uint64_t particleOffset;
+    std::uint64_t setOffset;
+    std::uint64_t tickAccumulator;
+    std::uint32_t setCount;
+    std::uint32_t tickRate;
+    std::int32_t iterationCount;
+    std::int32_t maxSubSteps;
+    std::int32_t minIterations;
+    std::int32_t implicitMaxIterations;
+    std::uint8_t dim;
+    std::uint8_t scalarSize;
+    std::uint8_t layout;
+    std::uint8_t solverMode;
+    std::uint8_t policy;
+    std::uint8_t sleeping;
+    std::uint8_t accumulateForces;
+    std::uint8_t warmStarted;
+    std::uint8_t jacobiAveraging;
+    T gravity[Dim];
+    T damping;
+    T stepSize;
+    T timeStretch;
+    T dtAccumulator;
+    T tickCarry;
+    T budget;
+    T maxStretch;
+    T smoothing;
+    T solverTolerance;
+    T warmStartFactor;
+    T jacobiRelaxation;
+    T implicitTolerance;
+};
+
+// one IndexedDistanceSet; its constraints are count IndexedDistanceConstraint<T> at offset,
+// and its cached impulses count T at impulseOffset, or 0 if it kept none
+template <int Dim, typename T>
+struct checkpoint_set
+{
+    std::uint64_t offset;
+    std::uint64_t count;
+    std::uint64_t impulseOffset;
+    T strength;
+    T biasFactor;
+    T compliance;
+    T wrapRange[Dim];
+};
+
+// bytes of one SoA array of n particles, padded to the alignment
+template <typename T>
+std::size_t checkpoint_array_size(std::size_t n) { return checkpoint_align(n * sizeof(T)); }
+
+template <int Dim, typename T>
+std::size_t checkpoint_particles_size(contiguous_range<Particle<Dim, T>> &particles)
+{
+    return checkpoint_align(particles.size() * sizeof(Particle<Dim, T>));
+}
+
+template <int Dim, typename T>
+std::size_t checkpoint_particles_size(typename ParticleStore<Dim, T>::range &particles)
+{
+    return checkpoint_array_size<T>(particles.size()) * (1 + 3 * Dim);
+}
+
+template <int Dim, typename T>
+checkpoint_layout write_checkpoint_particles(contiguous_range<Particle<Dim, T>> &particles, std::uint8_t *out)
+{
+    static_assert(std::is_trivially_copyable<Particle<Dim, T>>::value, "Particle is written as raw bytes");
+    std::memcpy(out, particles.begin(), particles.size() * sizeof(Particle<Dim, T>));
+    return checkpoint_layout::Particles;
+}
+
+template <int Dim, typename T>
+checkpoint_layout write_checkpoint_particles(typename ParticleStore<Dim, T>::range &particles, std::uint8_t *out)
+{
+    const std::size_t n = particles.size();
+    const std::size_t stride = checkpoint_array_size<T>(n);
+    std::memcpy(out, particles.inverseMass(), n * sizeof(T));
+    for (int a = 0; a < Dim; ++a)
+    {
+        std::memcpy(out + stride * (1 + a), particles.position(a), n * sizeof(T));
+        std::memcpy(out + stride * (1 + Dim + a), particles.linearVelocity(a), n * sizeof(T));
+        std::memcpy(out + stride * (1 + 2 * Dim + a), particles.forceAccumulator(a), n * sizeof(T));
+    }
+    return checkpoint_layout::Store;
+}
+
+} // namespace detail
+
+// Write world to out as a checkpoint: its particles, the IndexedDistanceSets
+// added to it and its parameters, time accumulators included. Particles are
+// kept in the World's own layout, Particle structs or ParticleStore arrays, so
+// a Checkpoint can hand them back without copying. Range constraints,
+// ConstraintGroups, forces, callbacks and sleep state are not saved.
+template <int Dim, typename T, typename Particles>
+void writeCheckpoint(World<Dim, T, Particles> &world, std::vector<std::uint8_t> &out)
+{
+    using Header_t = detail::checkpoint_header<Dim, T>;
+    using Set_t = detail::checkpoint_set<Dim, T>;
+    using Constraint_t = IndexedDistanceConstraint<T>;
+    static_assert(std::is_trivially_copyable<Constraint_t>::value, "constraints are written as raw bytes");
+
+    const std::vector<IndexedDistanceSet<Dim, T> *> &sets = world.indexedConstraints;
+    const std::size_t particleOffset = detail::checkpoint_align(sizeof(Header_t));
+    const std::size_t setOffset = particleOffset + detail::checkpoint_particles_size<Dim, T>(world.particles);
+    std::size_t size = detail::checkpoint_align(setOffset + sets.size() * sizeof(Set_t));
+    std::vector<Set_t> table(sets.size());
+    for (std::size_t s = 0; s < sets.size(); ++s)
+    {
+        std::memset(&table[s], 0, sizeof(Set_t));
+        table[s].offset = size;
+        table[s].count = sets[s]->constraints.size();
+        table[s].strength = sets[s]->strength;
+        table[s].biasFactor = sets[s]->biasFactor;
+        table[s].compliance = sets[s]->compliance;
+        for (int a = 0; a < Dim; ++a)
+            table[s].wrapRange[a] = sets[s]->wrapRange[a];
+        size = detail::checkpoint_align(size + sets[s]->constraints.size() * sizeof(Constraint_t));
+        if (sets[s]->cachesImpulses())
+        {
+            table[s].impulseOffset = size;
+            size = detail::checkpoint_align(size + sets[s]->impulses.size() * sizeof(T));
+        }
+    }
+
+    // zeroed so padding is written the same every time
+    out.assign(size, 0);
+    Header_t header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "MPCHKPT", 8);
+    header.version = detail::checkpoint_version;
+    header.byteOrder = detail::checkpoint_byte_order;
+    header.size = size;
+    header.particleCount = world.particles.size();
+    header.particleOffset = particleOffset;
+    header.setOffset = setOffset;
+    header.tickAccumulator = world.tickAccumulator;
+    header.setCount = static_cast<std::uint32_t>(sets.size());
+    header.tickRate = world.getTickRate();
+    header.iterationCount = world.iterationCount;
+    header.maxSubSteps = world.governor.maxSubSteps;
+    header.minIterations = world.governor.minIterations;
+    header.dim = static_cast<std::uint8_t>(Dim);
+    header.scalarSize = static_cast<std::uint8_t>(sizeof(T));
+    header.layout = static_cast<std::uint8_t>(detail::write_checkpoint_particles<Dim, T>(world.particles, out.data() + particleOffset));
+    header.solverMode = static_cast<std::uint8_t>(world.solverMode);
+    header.policy = static_cast<std::uint8_t>(world.governor.policy);
+    header.sleeping = world.sleeping;
+    header.accumulateForces = world.accumulateForces;
+    header.warmStarted = world.warmStarted;
+    header.jacobiAveraging = world.jacobi.averaging;
+    for (int a = 0; a < Dim; ++a)
+        header.gravity[a] = world.gravity[a];
+    header.damping = world.damping;
+    header.stepSize = world.stepSize;
+    header.timeStretch = world.timeStretch;
+    header.dtAccumulator = world.dtAccumulator;
+    header.tickCarry = world.tickCarry;
+    header.budget = world.governor.budget;
+    header.maxStretch = world.governor.maxStretch;
+    header.smoothing = world.governor.smoothing;
+    header.solverTolerance = world.getSolverTolerance();
+    header.warmStartFactor = world.getWarmStarting();
+    header.jacobiRelaxation = world.jacobi.relaxation;
+    header.implicitMaxIterations = world.implicit.maxIterations;
+    header.implicitTolerance = world.implicit.tolerance;
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    if (!table.empty())
+        std::memcpy(out.data() + setOffset, table.data(), table.size() * sizeof(Set_t));
+    for (std::size_t s = 0; s < sets.size(); ++s)
+    {
+        if (table[s].count > 0)
+            std::memcpy(out.data() + table[s].offset, sets[s]->constraints.data(), table[s].count * sizeof(Constraint_t));
+        if (table[s].impulseOffset != 0)
+            std::memcpy(out.data() + table[s].impulseOffset, sets[s]->impulses.data(), table[s].count * sizeof(T));
+    }
+}
+
+// writeCheckpoint to a file, false if it could not be written in full
+template <int Dim, typename T, typename Particles>
+bool saveCheckpoint(World<Dim, T, Particles> &world, const char *path)
+{
+    std::vector<std::uint8_t> bytes;
+    writeCheckpoint(world, bytes);
+    std::FILE *file = std::fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && written;
+}
+
+// A checkpoint read in place, e.g. from a mapped_file. Particles are used where
+// they lie, so a World stepping them writes into the checkpoint's memory; map
+// copy-on-write to leave the file untouched. Nothing is parsed, so opening one
+// costs only the pages the World goes on to touch. valid() checks the header
+// and that every section lies within size before anything else is read; the
+// particle indices of the constraints are checked as loadIndexedSet copies them.
+template <int Dim, typename T>
+class Checkpoint
+{
+public:
+    using Particle_t = Particle<Dim, T>;
+    using IndexedDistanceSet_t = IndexedDistanceSet<Dim, T>;
+
+    // data must outlive the Checkpoint and any particles taken from it
+    Checkpoint(void *data, std::size_t size) : bytes(static_cast<std::uint8_t *>(data)), size(size)
+    {
+        _valid = check();
+    }
+
+    bool valid() const { return _valid; }
+    std::size_t particleCount() const { return _valid ? static_cast<std::size_t>(header().particleCount) : 0; }
+    // particles were saved from a World over ParticleStore arrays
+    bool isStore() const { return _valid && header().layout == static_cast<std::uint8_t>(detail::checkpoint_layout::Store); }
+
+    // the saved Particle structs, empty if the checkpoint holds ParticleStore arrays
+    contiguous_range<Particle_t> particles() const
+    {
+        if (!_valid || isStore())
+            return {};
+        return {reinterpret_cast<Particle_t *>(bytes + header().particleOffset), particleCount()};
+    }
+
+    // the saved ParticleStore arrays, empty if the checkpoint holds Particle structs
+    typename ParticleStore<Dim, T>::range store() const
+    {
+        if (!_valid || !isStore())
+            return {};
+        const std::size_t n = particleCount();
+        const std::size_t stride = detail::checkpoint_array_size<T>(n);
+        T *base = reinterpret_cast<T *>(bytes + header().particleOffset);
+        const std::size_t step = stride / sizeof(T);
+        std::array<T *, Dim> position, linearVelocity, forceAccumulator;
+        for (int a = 0; a < Dim; ++a)
+        {
+            position[a] = base + step * (1 + a);
+            linearVelocity[a] = base + step * (1 + Dim + a);
+            forceAccumulator[a] = base + step * (1 + 2 * Dim + a);
+        }
+        return {base, position, linearVelocity, forceAccumulator, n};
+    }
+
+    std::size_t indexedSetCount() const { return _valid ? header().setCount : 0; }
+
+    // Copy saved set s into set, replacing its constraints and parameters.
+    // False, leaving set empty, if a constraint names a particle out of range.
+    bool loadIndexedSet(std::size_t s, IndexedDistanceSet_t &set) const
+    {
+        set.clear();
+        if (s >= indexedSetCount())
+            return false;
+        const detail::checkpoint_set<Dim, T> entry = setEntry(s);
+        const IndexedDistanceConstraint<T> *first = reinterpret_cast<const IndexedDistanceConstraint<T> *>(bytes + entry.offset);
+        const std::uint64_t n = header().particleCount;
+        set.constraints.reserve(static_cast<std::size_t>(entry.count));
+        for (std::uint64_t c = 0; c < entry.count; ++c)
+        {
+            if (first[c].p1 >= n || first[c].p2 >= n)
+            {
+                set.clear();
+                return false;
+            }
+            set.constraints.push_back(first[c]);
+        }
+        if (entry.impulseOffset != 0)
+        {
+            const T *impulses = reinterpret_cast<const T *>(bytes + entry.impulseOffset);
+            set.impulses.assign(impulses, impulses + entry.count);
+        }
+        else
+            set.dropImpulses();
+        set.strength = entry.strength;
+        set.biasFactor = entry.biasFactor;
+        set.compliance = entry.compliance;
+        for (int a = 0; a < Dim; ++a)
+            set.wrapRange[a] = entry.wrapRange[a];
+        return true;
+    }
+
+    // set world's parameters, governor settings and time accumulators to the saved ones
+    template <typename Particles>
+    void restore(World<Dim, T, Particles> &world) const
+    {
+        if (!_valid)
+            return;
+        const detail::checkpoint_header<Dim, T> &h = header();
+        for (int a = 0; a < Dim; ++a)
+            world.gravity[a] = h.gravity[a];
+        world.damping = h.damping;
+        world.stepSize = h.stepSize;
+        world.timeStretch = h.timeStretch;
+        world.iterationCount = h.iterationCount;
+        world.solverMode = static_cast<SolverMode>(h.solverMode);
+        world.setSleeping(h.sleeping != 0);
+        world.setForceAccumulation(h.accumulateForces != 0);
+        world.governor.maxSubSteps = h.maxSubSteps;
+        world.governor.minIterations = h.minIterations;
+        world.governor.policy = static_cast<OverloadPolicy>(h.policy);
+        world.governor.budget = h.budget;
+        world.governor.maxStretch = h.maxStretch;
+        world.governor.smoothing = h.smoothing;
+        world.setSolverTolerance(h.solverTolerance);
+        world.setWarmStarting(h.warmStartFactor);
+        world.jacobi.averaging = h.jacobiAveraging != 0;
+        world.jacobi.relaxation = h.jacobiRelaxation;
+        world.implicit.maxIterations = h.implicitMaxIterations;
+        world.implicit.tolerance = h.implicitTolerance;
+        world.setTickRate(h.tickRate);
+        world.dtAccumulator = h.dtAccumulator;
+        world.tickAccumulator = h.tickAccumulator;
+        world.tickCarry = h.tickCarry;
+        world.warmStarted = h.warmStarted != 0;
+    }
+
+private:
+    const detail::checkpoint_header<Dim, T> &header() const
+    {
+        return *reinterpret_cast<const detail::checkpoint_header<Dim, T> *>(bytes);
+    }
+
+    detail::checkpoint_set<Dim, T> setEntry(std::size_t s) const
+    {
+        detail::checkpoint_set<Dim, T> entry;
+        std::memcpy(&entry, bytes + header().setOffset + s * sizeof(entry), sizeof(entry));
+        return entry;
+    }
+
+    bool within(std::uint64_t offset, std::uint64_t length) const
+    {
+        return offset <= size && length <= size - offset && offset % detail::checkpoint_alignment == 0;
+    }
+
+    bool check() const
+    {
+        using Header_t = detail::checkpoint_header<Dim, T>;
+        // in place access needs the start aligned as the writer laid it out
+        if (bytes == nullptr || size < sizeof(Header_t) ||
+            reinterpret_cast<std::uintptr_t>(bytes) % alignof(std::max_align_t) != 0)
+            return false;
+        const Header_t &h = header();
+        if (std::memcmp(h.magic, "MPCHKPT", 8) != 0 || h.version != detail::checkpoint_version ||
+            h.byteOrder != detail::checkpoint_byte_order || h.dim != Dim || h.scalarSize != sizeof(T) || h.size != size)
+            return false;
+        // restore casts these straight to the enums
+        if (h.solverMode > static_cast<std::uint8_t>(SolverMode::Implicit) ||
+            h.policy > static_cast<std::uint8_t>(OverloadPolicy::ReduceIterations))
+            return false;
+
+        const std::uint64_t n = h.particleCount;
+        std::uint64_t particleBytes;
+        if (h.layout == static_cast<std::uint8_t>(detail::checkpoint_layout::Particles))
+            particleBytes = n * sizeof(Particle_t);
+        else if (h.layout == static_cast<std::uint8_t>(detail::checkpoint_layout::Store))
+            particleBytes = detail::checkpoint_array_size<T>(static_cast<std::size_t>(n)) * (1 + 3 * Dim);
+        else
+            return false;
+        if (n > size || !within(h.particleOffset, particleBytes) ||
+            !within(h.setOffset, static_cast<std::uint64_t>(h.setCount) * sizeof(detail::checkpoint_set<Dim, T>)))
+            return false;
+        for (std::size_t s = 0; s < h.setCount; ++s)
+        {
+            const detail::checkpoint_set<Dim, T> entry = setEntry(s);
+            if (entry.count > size || !within(entry.offset, entry.count * sizeof(IndexedDistanceConstraint<T>)) ||
+                (entry.impulseOffset != 0 && !within(entry.impulseOffset, entry.count * sizeof(T))))
+                return false;
+        }
+        return true;
+    }
+
+    std::uint8_t *bytes;
+    std::size_t size;
+    bool _valid = false;
+};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MP_HAS_MMAP 1
+#endif
+
+namespace mp {
+
+#ifdef MP_HAS_MMAP
+
+// A whole file mapped copy-on-write: pages are read in as they are first
+// touched, and writes through data() stay private to the process and never
+// reach the file.
+class mapped_file
+{
+public:
+    mapped_file() = default;
+    explicit mapped_file(const char *path) { open(path); }
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+    mapped_file(mapped_file &&other) noexcept { swap(other); }
+    mapped_file &operator=(mapped_file &&other) noexcept
+    {
+        close();
+        swap(other);
+        return *this;
+    }
+
+    bool open(const char *path)
+    {
+        close();
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *mapped = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                _data = mapped;
+                _size = static_cast<std::size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+        return _data != nullptr;
+    }
+
+    void close()
+    {
+        if (_data != nullptr)
+            ::munmap(_data, _size);
+        _data = nullptr;
+        _size = 0;
+    }
+
+    bool isOpen() const { return _data != nullptr; }
+    void *data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+private:
+    void swap(mapped_file &other)
+    {
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+    }
+
+    void *_data = nullptr;
+    std::size_t _size = 0;
+};
+
+#endif // MP_HAS_MMAP
+
+}
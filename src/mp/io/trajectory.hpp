@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../common/vec.hpp"
+#include "../replay/input_log.hpp"
+
+namespace mp {
+
+// Trajectory stream, built from the input log encoding:
+//   header  "MPTJ", u8 version, u8 Dim, varint particle count,
+//           f32 min[Dim], f32 max[Dim], u8 delta
+//   frame   u8 kind (1 key, 2 delta), varint frame number, then per axis
+//           u8 bits and every particle's value for that axis packed into
+//           bits bits each, least significant first
+// Positions are quantised to 16 bits across [min, max]. A key frame packs the
+// quantised values. A delta frame packs the zigzag encoded difference from a
+// prediction that each particle keeps the velocity of the last two frames, so
+// smooth motion costs a few bits per axis. A header starts the stream and is
+// repeated if the particle count changes.
+enum : std::uint8_t { trajectory_version = 1, trajectory_key = 1, trajectory_delta = 2 };
+
+namespace detail {
+
+// appends values of up to 16 bits to a byte vector, least significant bit first
+struct bit_packer
+{
+    explicit bit_packer(std::vector<std::uint8_t> &bytes) : bytes(bytes) {}
+
+    void put(std::uint32_t value, int bits)
+    {
+        pending |= value << pendingBits;
+        pendingBits += bits;
+        while (pendingBits >= 8)
+        {
+            bytes.push_back(static_cast<std::uint8_t>(pending));
+            pending >>= 8;
+            pendingBits -= 8;
+        }
+    }
+    void finish()
+    {
+        if (pendingBits > 0)
+            bytes.push_back(static_cast<std::uint8_t>(pending));
+        pending = 0;
+        pendingBits = 0;
+    }
+
+    std::vector<std::uint8_t> &bytes;
+    std::uint32_t pending = 0;
+    int pendingBits = 0;
+};
+
+inline int bit_width(std::uint32_t v)
+{
+    int bits = 0;
+    while (v != 0)
+    {
+        ++bits;
+        v >>= 1;
+    }
+    return bits;
+}
+
+// the value at the next frame if it moves as it did between the last two,
+// wrapping like the quantised values themselves
+inline std::uint16_t predict(std::uint16_t previous, std::uint16_t before)
+{
+    return static_cast<std::uint16_t>(2 * previous - before);
+}
+
+inline std::uint16_t zigzag(std::uint16_t current, std::uint16_t predicted)
+{
+    const std::int16_t d = static_cast<std::int16_t>(static_cast<std::uint16_t>(current - predicted));
+    return static_cast<std::uint16_t>((static_cast<std::uint16_t>(d) << 1) ^ static_cast<std::uint16_t>(d >> 15));
+}
+
+inline std::uint16_t unzigzag(std::uint16_t z, std::uint16_t predicted)
+{
+    const std::uint16_t d = static_cast<std::uint16_t>((z >> 1) ^ static_cast<std::uint16_t>(-(z & 1)));
+    return static_cast<std::uint16_t>(predicted + d);
+}
+
+} // namespace detail
+
+// Turns frames of positions into the trajectory stream. Keeps the last two
+// frames for delta encoding, so one encoder serves one stream.
+template <int Dim, typename T>
+class TrajectoryEncoder
+{
+public:
+    using Vec_t = Vec<Dim, T>;
+
+    // positions outside [min, max] are clamped. With delta, every keyInterval'th
+    // frame is still a key frame so a reader can start part way through.
+    TrajectoryEncoder(const Vec_t &min, const Vec_t &max, bool delta = true, std::uint32_t keyInterval = 60)
+        : min(min), max(max), delta(delta), keyInterval(keyInterval)
+    {
+        for (int a = 0; a < Dim; ++a)
+        {
+            const float range = static_cast<float>(max[a] - min[a]);
+            scale[a] = range > 0.0f ? 65535.0f / range : 0.0f;
+        }
+    }
+
+    // append the frame, preceded by a header if needed, to out
+    void encode(const Vec_t *positions, std::size_t n, std::uint64_t frame, std::vector<std::uint8_t> &out)
+    {
+        input_log_writer log(out);
+        if (!started || n != previous.size() / Dim)
+        {
+            writeHeader(log, n);
+            previous.assign(n * Dim, 0);
+            before.assign(n * Dim, 0);
+            sinceKey = 0;
+        }
+        const bool key = !delta || sinceKey == 0;
+        // 0 never repeats the key frame
+        sinceKey = keyInterval == 0 ? 1 : (sinceKey + 1) % keyInterval;
+
+        log.u8(key ? trajectory_key : trajectory_delta);
+        log.varint(frame);
+        current.resize(n);
+        for (int a = 0; a < Dim; ++a)
+        {
+            std::uint16_t widest = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                const std::size_t k = i * Dim + a;
+                const std::uint16_t q = quantise(positions[i][a], a);
+                current[i] = key ? q : detail::zigzag(q, detail::predict(previous[k], before[k]));
+                widest = current[i] > widest ? current[i] : widest;
+                // after a key frame the prediction starts from rest
+                before[k] = key ? q : previous[k];
+                previous[k] = q;
+            }
+            const int bits = detail::bit_width(widest);
+            log.u8(static_cast<std::uint8_t>(bits));
+            detail::bit_packer packer(out);
+            if (bits > 0)
+                for (std::size_t i = 0; i < n; ++i)
+                    packer.put(current[i], bits);
+            packer.finish();
+        }
+    }
+
+    // forget the previous frame, so the next is a key frame
+    void reset() { started = false; }
+
+private:
+    std::uint16_t quantise(T value, int axis) const
+    {
+        const float q = (static_cast<float>(value - min[axis])) * scale[axis] + 0.5f;
+        return q <= 0.0f ? 0 : q >= 65535.0f ? 65535 : static_cast<std::uint16_t>(q);
+    }
+
+    void writeHeader(input_log_writer &log, std::size_t n)
+    {
+        log.u8('M');
+        log.u8('P');
+        log.u8('T');
+        log.u8('J');
+        log.u8(trajectory_version);
+        log.u8(static_cast<std::uint8_t>(Dim));
+        log.varint(n);
+        for (int a = 0; a < Dim; ++a)
+            log.real(static_cast<float>(min[a]));
+        for (int a = 0; a < Dim; ++a)
+            log.real(static_cast<float>(max[a]));
+        log.u8(delta ? 1 : 0);
+        started = true;
+    }
+
+    Vec_t min, max;
+    float scale[Dim];
+    bool delta;
+    std::uint32_t keyInterval;
+    std::uint32_t sinceKey = 0;
+    bool started = false;
+    std::vector<std::uint16_t> previous, before;
+    // this axis' packed values
+    std::vector<std::uint16_t> current;
+};
+
+// Reads frames back from a complete trajectory stream
+template <int Dim, typename T>
+class TrajectoryDecoder
+{
+public:
+    using Vec_t = Vec<Dim, T>;
+
+    TrajectoryDecoder(const std::uint8_t *data, std::size_t size) : log(data, size) {}
+
+    // the next frame into positions; false at the end of the stream or if it is
+    // malformed, see failed()
+    bool next(std::vector<Vec_t> &positions, std::uint64_t &frame)
+    {
+        while (log.ok && !log.atEnd())
+        {
+            const std::uint8_t kind = log.u8();
+            if (kind == 'M')
+            {
+                if (!readHeader())
+                    return fail();
+                continue;
+            }
+            if ((kind != trajectory_key && kind != trajectory_delta) || !haveHeader || (kind == trajectory_delta && !haveKey))
+                return fail();
+            frame = log.varint();
+            const std::size_t n = previous.size() / Dim;
+            positions.resize(n);
+            for (int a = 0; a < Dim; ++a)
+            {
+                const int bits = log.u8();
+                if (bits > 16)
+                    return fail();
+                std::uint32_t pending = 0;
+                int pendingBits = 0;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    while (pendingBits < bits)
+                    {
+                        pending |= static_cast<std::uint32_t>(log.u8()) << pendingBits;
+                        pendingBits += 8;
+                    }
+                    const std::uint16_t v = static_cast<std::uint16_t>(bits > 0 ? pending & ((1u << bits) - 1) : 0);
+                    pending >>= bits;
+                    pendingBits -= bits;
+                    const std::size_t k = i * Dim + a;
+                    const std::uint16_t q = kind == trajectory_key ? v : detail::unzigzag(v, detail::predict(previous[k], before[k]));
+                    before[k] = kind == trajectory_key ? q : previous[k];
+                    previous[k] = q;
+                    positions[i][a] = static_cast<T>(min[a] + static_cast<float>(q) * step[a]);
+                }
+            }
+            if (!log.ok)
+                return false;
+            haveKey = true;
+            return true;
+        }
+        return false;
+    }
+
+    bool failed() const { return !log.ok; }
+
+private:
+    bool readHeader()
+    {
+        const bool magic = log.u8() == 'P' && log.u8() == 'T' && log.u8() == 'J';
+        const bool version = log.u8() == trajectory_version && log.u8() == Dim;
+        const std::uint64_t n = log.varint();
+        for (int a = 0; a < Dim; ++a)
+            min[a] = log.real<float>();
+        for (int a = 0; a < Dim; ++a)
+        {
+            const float max = log.real<float>();
+            step[a] = max > min[a] ? (max - min[a]) / 65535.0f : 0.0f;
+        }
+        log.u8();
+        if (!log.ok || !magic || !version || n > (std::uint64_t{1} << 28))
+            return false;
+        previous.assign(static_cast<std::size_t>(n) * Dim, 0);
+        before.assign(previous.size(), 0);
+        haveHeader = true;
+        haveKey = false;
+        return true;
+    }
+
+    bool fail()
+    {
+        log.ok = false;
+        return false;
+    }
+
+    input_log_reader log;
+    float min[Dim];
+    float step[Dim];
+    std::vector<std::uint16_t> previous, before;
+    bool haveHeader = false;
+    bool haveKey = false;
+};
+
+}
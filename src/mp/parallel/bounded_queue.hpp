@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace mp {
+
+// Fixed capacity FIFO between threads. Values are swapped in and out of
+// preallocated slots, so once every slot has been used, buffers such as
+// vectors keep their storage and nothing allocates. A full queue drops its
+// oldest value: a real-time consumer wants the newest frames.
+template <typename T>
+class bounded_queue
+{
+public:
+    explicit bounded_queue(std::size_t capacity) : slots(capacity < 1 ? 1 : capacity) {}
+
+    // swap value into the queue, leaving a recycled value in its place.
+    // Returns false if the oldest value had to be dropped to make room.
+    bool push(T &value)
+    {
+        bool dropped = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (count == slots.size())
+            {
+                head = (head + 1) % slots.size();
+                --count;
+                dropped = true;
+            }
+            std::swap(slots[(head + count) % slots.size()], value);
+            ++count;
+        }
+        available.notify_one();
+        return !dropped;
+    }
+
+    // swap the oldest value into out if there is one
+    bool try_pop(T &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return popLocked(out);
+    }
+
+    // wait up to timeout for a value
+    template <typename Rep, typename Period>
+    bool wait_pop(T &out, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait_for(lock, timeout, [this] { return count > 0; });
+        return popLocked(out);
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+    std::size_t capacity() const { return slots.size(); }
+
+private:
+    bool popLocked(T &out)
+    {
+        if (count == 0)
+            return false;
+        std::swap(slots[head], out);
+        head = (head + 1) % slots.size();
+        --count;
+        return true;
+    }
+
+    std::vector<T> slots;
+    std::size_t head = 0;
+    std::size_t count = 0;
+    mutable std::mutex mutex;
+    std::condition_variable available;
+};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace mp {
+
+// Interface World uses to run index ranges across threads. Kept free of any
+// threading headers so World still builds where there is no std::thread.
+class Executor
+{
+public:
+    using task_fn = void (*)(void *context, std::size_t begin, std::size_t end);
+
+    virtual ~Executor() {}
+
+    // call fn over [begin, end) in chunks of grain indices starting at
+    // begin + k * grain, the last possibly shorter, or over the whole range at
+    // once. Returns once every chunk has run.
+    virtual void run(std::size_t begin, std::size_t end, std::size_t grain, task_fn fn, void *context) = 0;
+    virtual std::size_t concurrency() const = 0;
+};
+
+// run fn(begin, end) over sub-ranges of [begin, end) on executor, or serially
+// in the calling thread if there is no executor or only one grain of work
+template <typename Fn>
+void parallel_for(Executor *executor, std::size_t begin, std::size_t end, std::size_t grain, Fn &&fn)
+{
+    if (end <= begin)
+        return;
+    if (executor == nullptr || end - begin <= grain)
+    {
+        fn(begin, end);
+        return;
+    }
+    using Fn_t = std::remove_reference_t<Fn>;
+    executor->run(begin, end, grain, [](void *context, std::size_t b, std::size_t e) {
+        (*static_cast<Fn_t *>(context))(b, e);
+    }, const_cast<void *>(static_cast<const void *>(&fn)));
+}
+
+}
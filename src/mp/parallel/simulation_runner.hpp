@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "bounded_queue.hpp"
+#include "snapshot.hpp"
+#include "../World.hpp"
+
+namespace mp {
+
+// Owns a thread that steps a World, either at a fixed rate or on request with
+// stepAsync, and hands a Snapshot of every step to consumers through a
+// bounded_queue. Once a runner is attached, the World and its particles belong
+// to the runner's thread; change them with post() rather than directly.
+//
+// The runner becomes the World's snapshot sink. A sink already attached, such
+// as a TrajectoryWriter, still gets every frame, published on the runner's
+// thread before the runner queues its own, and is attached again when the
+// runner is destroyed. Frame numbers carry on across both swaps. Do not change the World's sink while a runner owns it.
+template <int Dim, typename T, typename Particles = contiguous_range<Particle<Dim, T>>>
+class SimulationRunner : public SnapshotSink<Dim, T>
+{
+public:
+    using World_t = World<Dim, T, Particles>;
+    using Snapshot_t = Snapshot<Dim, T>;
+    using Status_t = StepStatus<T>;
+
+    // frameCapacity is how many frames may wait for a consumer before the
+    // oldest are dropped
+    explicit SimulationRunner(World_t &world, std::size_t frameCapacity = 4)
+        : world(world), frames(frameCapacity), previous(world.swapSnapshotSink(this))
+    {
+        thread = std::thread([this] { loop(); });
+    }
+
+    ~SimulationRunner()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        world.swapSnapshotSink(previous);
+    }
+
+    SimulationRunner(const SimulationRunner &) = delete;
+    SimulationRunner &operator=(const SimulationRunner &) = delete;
+
+    // step every 1 / rate seconds, passing the measured wall time to World::step
+    // so its governor deals with any overload
+    void start(T rate)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<T>(T(1) / rate));
+            running = true;
+            nextTick = clock::now();
+            lastStep = nextTick - period;
+        }
+        wake.notify_one();
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+
+    // step once by dt on the runner's thread
+    std::future<Status_t> stepAsync(T dt)
+    {
+        return post([dt](World_t &w) {
+            w.step(dt);
+            return w.status;
+        });
+    }
+
+    // run fn(world) on the runner's thread between steps, e.g. to apply an impulse
+    template <typename Fn>
+    auto post(Fn fn) -> std::future<decltype(fn(std::declval<World_t &>()))>
+    {
+        using Result = decltype(fn(std::declval<World_t &>()));
+        std::shared_ptr<std::packaged_task<Result()>> task =
+            std::make_shared<std::packaged_task<Result()>>([this, fn]() mutable { return fn(world); });
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([task] { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    // take the oldest waiting frame; out's old buffer is recycled
+    bool tryPopFrame(Snapshot_t &out) { return frames.try_pop(out); }
+    template <typename Rep, typename Period>
+    bool waitFrame(Snapshot_t &out, const std::chrono::duration<Rep, Period> &timeout) { return frames.wait_pop(out, timeout); }
+    // frames dropped because consumers fell behind
+    std::size_t droppedFrames() const { return dropped; }
+
+    // SnapshotSink, called by World::step on the runner's thread
+    Snapshot_t &writeBuffer() override { return scratch; }
+    void publish() override
+    {
+        if (previous != nullptr)
+        {
+            Snapshot_t &chained = previous->writeBuffer();
+            chained.frame = scratch.frame;
+            chained.alpha = scratch.alpha;
+            chained.positions.resize(scratch.positions.size());
+            for (std::size_t i = 0; i < scratch.positions.size(); ++i)
+                chained.positions[i] = scratch.positions[i];
+            previous->publish();
+        }
+        if (!frames.push(scratch))
+            ++dropped;
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            if (running)
+                wake.wait_until(lock, nextTick, [this] { return stopping || !tasks.empty(); });
+            else
+                wake.wait(lock, [this] { return stopping || running || !tasks.empty(); });
+            if (stopping)
+                return;
+
+            while (!tasks.empty())
+            {
+                std::function<void()> task = std::move(tasks.front());
+                tasks.pop_front();
+                lock.unlock();
+                task();
+                lock.lock();
+            }
+
+            if (running && clock::now() >= nextTick)
+            {
+                const clock::time_point now = clock::now();
+                const T dt = std::chrono::duration<T>(now - lastStep).count();
+                lastStep = now;
+                nextTick += period;
+                // after a long stall start the schedule again rather than run to catch up
+                if (nextTick < now)
+                    nextTick = now + period;
+                lock.unlock();
+                world.step(dt);
+                lock.lock();
+            }
+        }
+    }
+
+    World_t &world;
+    bounded_queue<Snapshot_t> frames;
+    Snapshot_t scratch;
+    std::atomic<std::size_t> dropped{0};
+    // sink attached before the runner, fed the same frames
+    SnapshotSink<Dim, T> *previous;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    bool running = false;
+    clock::duration period{};
+    clock::time_point nextTick, lastStep;
+    std::thread thread;
+};
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../common/vec.hpp"
+
+namespace mp {
+
+// read-only copy of the particle positions after a call to World::step
+template <int Dim, typename T>
+struct Snapshot
+{
+    // counts calls to step since the sink was attached
+    std::uint64_t frame = 0;
+    // interpolation factor the positions were taken at, see World::alpha
+    T alpha = 0;
+    std::vector<Vec<Dim, T>> positions;
+};
+
+// Where World publishes snapshots. World fills writeBuffer() and calls
+// publish(); implementations decide how the frame reaches readers. Kept free
+// of threading headers like Executor.
+template <int Dim, typename T>
+class SnapshotSink
+{
+public:
+    virtual ~SnapshotSink() {}
+    // buffer owned by the writer until publish is called
+    virtual Snapshot<Dim, T> &writeBuffer() = 0;
+    virtual void publish() = 0;
+};
+
+}
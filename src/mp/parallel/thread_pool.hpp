@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "executor.hpp"
+#include "../utility/memory.hpp"
+
+namespace mp {
+
+// Work-stealing pool of worker threads implementing Executor. Each run() splits
+// its range into grain sized chunks and deals a contiguous block of chunks to
+// every thread. Threads take chunks from the front of their own block and, once
+// it is empty, steal the back half of another thread's block. The calling thread
+// joins in and returns only once all chunks are done, so each run() acts as a
+// barrier.
+//
+// One job runs at a time: calls from several threads take turns, and a call
+// from inside a task, such as a nested parallel_for, runs serially in the
+// thread of that task.
+class ThreadPool : public Executor
+{
+public:
+    // nThreads counts the calling thread, so ThreadPool(1) runs everything inline
+    explicit ThreadPool(std::size_t nThreads = std::thread::hardware_concurrency())
+        : blocks(std::max<std::size_t>(nThreads, 1))
+    {
+        for (std::size_t i = 1; i < nThreads; ++i)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t concurrency() const override { return workers.size() + 1; }
+
+    void run(std::size_t begin, std::size_t end, std::size_t grain, task_fn fn, void *context) override
+    {
+        grain = std::max<std::size_t>(grain, 1);
+        const std::size_t nChunks = (end - begin + grain - 1) / grain;
+        if (workers.empty() || nChunks < 2 || current() == this)
+        {
+            fn(context, begin, end);
+            return;
+        }
+
+        std::lock_guard<std::mutex> caller(runMutex);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // stragglers from the previous job must be out before it is replaced
+            done.wait(lock, [this] { return activeWorkers == 0; });
+            job.fn = fn;
+            job.context = context;
+            job.begin = begin;
+            job.end = end;
+            job.grain = grain;
+            const std::size_t n = concurrency();
+            for (std::size_t i = 0; i < n; ++i)
+                blocks[i].chunks.store(pack(nChunks * i / n, nChunks * (i + 1) / n), std::memory_order_relaxed);
+            pendingChunks.store(nChunks, std::memory_order_release);
+            ++generation;
+        }
+        wake.notify_all();
+
+        process(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pendingChunks.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct Job
+    {
+        task_fn fn = nullptr;
+        void *context = nullptr;
+        std::size_t begin = 0, end = 0, grain = 1;
+    };
+
+    // [first, last) chunk indices owned by one thread, packed so the owner and
+    // thieves can update it with a single compare-exchange
+    struct alignas(64) Block
+    {
+        std::atomic<std::uint64_t> chunks{0};
+    };
+
+    static std::uint64_t pack(std::uint64_t first, std::uint64_t last) { return (last << 32) | first; }
+    static std::uint32_t first(std::uint64_t chunks) { return static_cast<std::uint32_t>(chunks); }
+    static std::uint32_t last(std::uint64_t chunks) { return static_cast<std::uint32_t>(chunks >> 32); }
+
+    bool pop(std::size_t self, std::size_t &chunk)
+    {
+        std::atomic<std::uint64_t> &own = blocks[self].chunks;
+        std::uint64_t current = own.load(std::memory_order_acquire);
+        while (first(current) < last(current))
+        {
+            if (own.compare_exchange_weak(current, pack(first(current) + 1, last(current)), std::memory_order_acq_rel))
+            {
+                chunk = first(current);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // move the back half of another thread's block into our own (empty) block
+    bool steal(std::size_t self)
+    {
+        const std::size_t n = concurrency();
+        for (std::size_t offset = 1; offset < n; ++offset)
+        {
+            std::atomic<std::uint64_t> &victim = blocks[(self + offset) % n].chunks;
+            std::uint64_t current = victim.load(std::memory_order_acquire);
+            while (first(current) < last(current))
+            {
+                const std::uint32_t count = last(current) - first(current);
+                const std::uint32_t split = last(current) - std::max<std::uint32_t>(count / 2, 1);
+                if (victim.compare_exchange_weak(current, pack(first(current), split), std::memory_order_acq_rel))
+                {
+                    blocks[self].chunks.store(pack(split, last(current)), std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // the pool whose tasks this thread is running, if any
+    static const ThreadPool *&current()
+    {
+        static thread_local const ThreadPool *pool = nullptr;
+        return pool;
+    }
+
+    void process(std::size_t self)
+    {
+        const ThreadPool *outer = current();
+        current() = this;
+        const Job j = job;
+        std::size_t chunk;
+        while (true)
+        {
+            if (!pop(self, chunk))
+            {
+                if (!steal(self))
+                    break;
+                continue;
+            }
+            const std::size_t b = j.begin + chunk * j.grain;
+            const std::size_t e = std::min(j.end, b + j.grain);
+            j.fn(j.context, b, e);
+            if (pendingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.notify_all();
+            }
+        }
+        current() = outer;
+    }
+
+    void workerLoop(std::size_t self)
+    {
+        std::uint64_t seen = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                ++activeWorkers;
+            }
+            process(self);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --activeWorkers;
+            }
+            done.notify_all();
+        }
+    }
+
+    std::vector<Block, aligned_allocator<Block>> blocks;
+    std::vector<std::thread> workers;
+    // held by the thread whose job is running
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    Job job;
+    std::atomic<std::size_t> pendingChunks{0};
+    std::uint64_t generation = 0;
+    std::size_t activeWorkers = 0;
+    bool stopping = false;
+};
+
+}
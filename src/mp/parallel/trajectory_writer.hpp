@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "bounded_queue.hpp"
+#include "snapshot.hpp"
+#include "../io/byte_sink.hpp"
+#include "../io/trajectory.hpp"
+
+namespace mp {
+
+// Streams a World's positions to a ByteSink as a trajectory, see
+// TrajectoryEncoder. Attach with World::setSnapshotSink: each published frame
+// is handed to a background thread that encodes and writes it, so slow I/O
+// never holds up World::step. If the thread falls behind, the oldest waiting
+// frames are dropped; delta frames are predicted from the frames written,
+// so the stream stays decodable.
+template <int Dim, typename T>
+class TrajectoryWriter : public SnapshotSink<Dim, T>
+{
+public:
+    using Vec_t = Vec<Dim, T>;
+    using Snapshot_t = Snapshot<Dim, T>;
+
+    // every frameInterval'th published frame is written, e.g. 10 ms of 1 ms steps
+    TrajectoryWriter(ByteSink &sink, const Vec_t &min, const Vec_t &max, bool delta = true,
+        std::uint32_t frameInterval = 1, std::size_t queueCapacity = 8)
+        : sink(sink), encoder(min, max, delta), frameInterval(frameInterval < 1 ? 1 : frameInterval),
+        frames(queueCapacity)
+    {
+        thread = std::thread([this] { loop(); });
+    }
+
+    // writes out the frames still waiting before returning
+    ~TrajectoryWriter()
+    {
+        stopping = true;
+        thread.join();
+        sink.flush();
+    }
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    // SnapshotSink, called by World::step
+    Snapshot_t &writeBuffer() override { return scratch; }
+    void publish() override
+    {
+        if (published++ % frameInterval != 0)
+            return;
+        if (!frames.push(scratch))
+            ++dropped;
+    }
+
+    std::uint64_t framesWritten() const { return written; }
+    std::uint64_t framesDropped() const { return dropped; }
+    std::uint64_t bytesWritten() const { return bytes; }
+    // a write to the sink failed
+    bool failed() const { return writeFailed; }
+
+private:
+    void loop()
+    {
+        Snapshot_t frame;
+        std::vector<std::uint8_t> encoded;
+        while (true)
+        {
+            // stopping is checked before waiting so the queue is drained first
+            const bool last = stopping;
+            if (!frames.wait_pop(frame, std::chrono::milliseconds(5)))
+            {
+                if (last)
+                    return;
+                continue;
+            }
+            encoded.clear();
+            encoder.encode(frame.positions.data(), frame.positions.size(), frame.frame, encoded);
+            if (!sink.write(encoded.data(), encoded.size()))
+                writeFailed = true;
+            bytes += encoded.size();
+            ++written;
+        }
+    }
+
+    ByteSink &sink;
+    TrajectoryEncoder<Dim, T> encoder;
+    std::uint32_t frameInterval;
+    std::uint64_t published = 0;
+    Snapshot_t scratch;
+    bounded_queue<Snapshot_t> frames;
+    std::atomic<std::uint64_t> written{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<bool> writeFailed{false};
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+}
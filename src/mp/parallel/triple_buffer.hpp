@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "snapshot.hpp"
+
+namespace mp {
+
+// Single producer, single consumer triple buffer. The writer fills its back
+// buffer and swaps it with the shared middle one; the reader swaps the middle
+// with its front buffer when something new has been published. Both sides are
+// wait-free and never see a buffer the other is using.
+template <typename T>
+class triple_buffer
+{
+public:
+    triple_buffer() : middle(1) {}
+
+    triple_buffer(const triple_buffer &) = delete;
+    triple_buffer &operator=(const triple_buffer &) = delete;
+
+    // writer side
+    T &back() { return buffers[backIndex]; }
+    void publish()
+    {
+        backIndex = middle.exchange(backIndex | fresh, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // reader side: latest published value, or the previous one if nothing new
+    const T &read()
+    {
+        update();
+        return buffers[frontIndex];
+    }
+    // true if read would return something not yet seen
+    bool hasNew() const { return (middle.load(std::memory_order_acquire) & fresh) != 0; }
+    // take the newest value if there is one, returning whether there was
+    bool update()
+    {
+        if (!hasNew())
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+    const T &front() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr std::uint8_t fresh = 4;
+    static constexpr std::uint8_t indexMask = 3;
+
+    T buffers[3];
+    std::uint8_t backIndex = 0;
+    std::uint8_t frontIndex = 2;
+    std::atomic<std::uint8_t> middle;
+};
+
+// SnapshotSink handing frames from the stepping thread to one reader thread
+// through a triple_buffer. The reader always gets the newest complete frame
+// and never blocks World::step.
+template <int Dim, typename T>
+class SnapshotBuffer : public SnapshotSink<Dim, T>
+{
+public:
+    using Snapshot_t = Snapshot<Dim, T>;
+
+    Snapshot_t &writeBuffer() override { return buffer.back(); }
+    void publish() override { buffer.publish(); }
+
+    // reader side, see triple_buffer
+    const Snapshot_t &read() { return buffer.read(); }
+    bool hasNew() const { return buffer.hasNew(); }
+
+private:
+    triple_buffer<Snapshot_t> buffer;
+};
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace mp {
+
+// Record types of an input log. The log is a header followed by records, each
+// an opcode byte and its payload, all little endian:
+//   header      "MPIL", u8 version, u8 Dim, u8 sizeof(T), u32 tick rate,
+//               u32 ticks per step, varint particle count
+//   Step        varint ticks, varint sub-steps run
+//   Impulse     varint particle, Dim x T
+//   Gravity     Dim x T
+//   Damping     T
+//   Iterations  varint
+//   TimeStretch T
+enum class InputOp : std::uint8_t
+{
+    Step = 1,
+    Impulse,
+    Gravity,
+    Damping,
+    Iterations,
+    TimeStretch
+};
+
+enum : std::uint8_t { input_log_version = 1 };
+
+// appends values to a byte buffer in the input log encoding
+struct input_log_writer
+{
+    explicit input_log_writer(std::vector<std::uint8_t> &bytes) : bytes(bytes) {}
+
+    void u8(std::uint8_t v) { bytes.push_back(v); }
+    void u32(std::uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            bytes.push_back(static_cast<std::uint8_t>(v >> (8 * i)));
+    }
+    // 7 bits per byte, high bit set on all but the last
+    void varint(std::uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            bytes.push_back(static_cast<std::uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        bytes.push_back(static_cast<std::uint8_t>(v));
+    }
+    // float or double by bit pattern, so values round trip exactly
+    template <typename T>
+    void real(T v)
+    {
+        using bits_t = typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type;
+        bits_t bits;
+        std::memcpy(&bits, &v, sizeof(T));
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+            bytes.push_back(static_cast<std::uint8_t>(bits >> (8 * i)));
+    }
+
+    std::vector<std::uint8_t> &bytes;
+};
+
+// reads values written by input_log_writer. Reading past the end returns
+// zeros and clears ok.
+struct input_log_reader
+{
+    input_log_reader(const std::uint8_t *data, std::size_t size) : data(data), size(size) {}
+
+    bool atEnd() const { return pos >= size; }
+
+    std::uint8_t u8()
+    {
+        if (pos >= size)
+        {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+    std::uint32_t u32()
+    {
+        std::uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= static_cast<std::uint32_t>(u8()) << (8 * i);
+        return v;
+    }
+    std::uint64_t varint()
+    {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const std::uint8_t b = u8();
+            v |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return v;
+    }
+    template <typename T>
+    T real()
+    {
+        using bits_t = typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type;
+        bits_t bits = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+            bits |= static_cast<bits_t>(u8()) << (8 * i);
+        T v;
+        std::memcpy(&v, &bits, sizeof(T));
+        return v;
+    }
+
+    const std::uint8_t *data;
+    std::size_t size;
+    std::size_t pos = 0;
+    bool ok = true;
+};
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "input_log.hpp"
+#include "../World.hpp"
+
+namespace mp {
+
+// Drives a World while logging everything that changes its trajectory: the
+// ticks of each step, impulses and parameter changes. The World runs on an
+// integer tick clock, so an InputReplayer fed the log, starting from the same
+// state, repeats the run bit for bit. The governor must not have a step budget,
+// as that makes the sub-steps run depend on wall time.
+template <int Dim, typename T, typename Particles = contiguous_range<Particle<Dim, T>>>
+class InputRecorder
+{
+public:
+    using World_t = World<Dim, T, Particles>;
+    using Vec_t = Vec<Dim, T>;
+
+    // log to out, which is appended to. World is switched to tickRate ticks
+    // per second unless already on a tick clock.
+    InputRecorder(World_t &world, std::vector<std::uint8_t> &out, std::uint32_t tickRate = 100000)
+        : world(world), log(out)
+    {
+        if (world.getTickRate() == 0)
+            world.setTickRate(tickRate);
+        log.u8('M');
+        log.u8('P');
+        log.u8('I');
+        log.u8('L');
+        log.u8(input_log_version);
+        log.u8(static_cast<std::uint8_t>(Dim));
+        log.u8(static_cast<std::uint8_t>(sizeof(T)));
+        log.u32(world.getTickRate());
+        log.u32(world.ticksPerStep());
+        log.varint(world.particles.size());
+    }
+
+    // wall time is turned into whole ticks here, the fraction carried over
+    void step(T dt)
+    {
+        stepTicks(detail::whole_ticks(dt, world.getTickRate(), carry));
+    }
+
+    void stepTicks(std::uint32_t ticks)
+    {
+        world.stepTicks(ticks);
+        log.u8(static_cast<std::uint8_t>(InputOp::Step));
+        log.varint(ticks);
+        log.varint(static_cast<std::uint64_t>(world.status.subSteps));
+    }
+
+    void applyImpulse(std::size_t i, const Vec_t &impulse)
+    {
+        world.applyImpulse(i, impulse);
+        log.u8(static_cast<std::uint8_t>(InputOp::Impulse));
+        log.varint(i);
+        for (int a = 0; a < Dim; ++a)
+            log.real(impulse[a]);
+    }
+
+    void setGravity(const Vec_t &g)
+    {
+        world.setGravity(g);
+        log.u8(static_cast<std::uint8_t>(InputOp::Gravity));
+        for (int a = 0; a < Dim; ++a)
+            log.real(g[a]);
+    }
+
+    void setDamping(T d)
+    {
+        world.setDamping(d);
+        log.u8(static_cast<std::uint8_t>(InputOp::Damping));
+        log.real(d);
+    }
+
+    void setIterationCount(int n)
+    {
+        world.iterationCount = n;
+        log.u8(static_cast<std::uint8_t>(InputOp::Iterations));
+        log.varint(static_cast<std::uint64_t>(n));
+    }
+
+    void setTimeStretch(T stretch)
+    {
+        world.timeStretch = stretch;
+        log.u8(static_cast<std::uint8_t>(InputOp::TimeStretch));
+        log.real(stretch);
+    }
+
+private:
+    World_t &world;
+    input_log_writer log;
+    T carry{};
+};
+
+// Plays an input log back into a World set up in the state it was recorded from.
+template <int Dim, typename T, typename Particles = contiguous_range<Particle<Dim, T>>>
+class InputReplayer
+{
+public:
+    using World_t = World<Dim, T, Particles>;
+    using Vec_t = Vec<Dim, T>;
+
+    // data must outlive the replayer. Puts world on the log's tick clock.
+    InputReplayer(World_t &world, const std::uint8_t *data, std::size_t size)
+        : world(world), log(data, size)
+    {
+        const bool magic = log.u8() == 'M' && log.u8() == 'P' && log.u8() == 'I' && log.u8() == 'L';
+        const bool version = log.u8() == input_log_version;
+        const bool layout = log.u8() == Dim && log.u8() == sizeof(T);
+        const std::uint32_t tickRate = log.u32();
+        const std::uint32_t ticksPerStep = log.u32();
+        const std::uint64_t particleCount = log.varint();
+        if (log.ok && tickRate != 0)
+            world.setTickRate(tickRate);
+        headerOk = log.ok && magic && version && layout && tickRate != 0 &&
+            world.ticksPerStep() == ticksPerStep && particleCount == world.particles.size();
+    }
+
+    // false if the log is not for this World: another Dim, T, particle count or sub-step length
+    bool valid() const { return headerOk; }
+
+    // apply records up to and including the next step; false at the end of the
+    // log or on a bad record
+    bool next()
+    {
+        if (!headerOk)
+            return false;
+        while (log.ok && !log.atEnd())
+        {
+            const InputOp op = static_cast<InputOp>(log.u8());
+            switch (op)
+            {
+            case InputOp::Step:
+            {
+                const std::uint32_t ticks = static_cast<std::uint32_t>(log.varint());
+                const std::uint64_t subSteps = log.varint();
+                if (!log.ok)
+                    return false;
+                world.stepTicks(ticks);
+                _diverged = _diverged || static_cast<std::uint64_t>(world.status.subSteps) != subSteps;
+                ++_steps;
+                return true;
+            }
+            case InputOp::Impulse:
+            {
+                const std::uint64_t i = log.varint();
+                const Vec_t impulse = readVec();
+                if (!log.ok || i >= world.particles.size())
+                    return fail();
+                world.applyImpulse(static_cast<std::size_t>(i), impulse);
+                break;
+            }
+            case InputOp::Gravity:
+                world.setGravity(readVec());
+                break;
+            case InputOp::Damping:
+                world.setDamping(log.real<T>());
+                break;
+            case InputOp::Iterations:
+                world.iterationCount = static_cast<int>(log.varint());
+                break;
+            case InputOp::TimeStretch:
+                world.timeStretch = log.real<T>();
+                break;
+            default:
+                return fail();
+            }
+        }
+        return false;
+    }
+
+    void run()
+    {
+        while (next())
+            ;
+    }
+
+    std::size_t steps() const { return _steps; }
+    // a step ran a different number of sub-steps than when recorded, e.g. the
+    // governor had a budget or the World was set up differently
+    bool diverged() const { return _diverged; }
+    // the log was cut short or held an unknown record
+    bool failed() const { return !log.ok; }
+
+private:
+    Vec_t readVec()
+    {
+        Vec_t v;
+        for (int a = 0; a < Dim; ++a)
+            v[a] = log.real<T>();
+        return v;
+    }
+
+    bool fail()
+    {
+        log.ok = false;
+        return false;
+    }
+
+    World_t &world;
+    input_log_reader log;
+    bool headerOk = false;
+    bool _diverged = false;
+    std::size_t _steps = 0;
+};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+namespace mp {
+
+    // microseconds since an arbitrary start, wrapping; only differences are meaningful
+    inline std::uint32_t mp_micros()
+    {
+#ifdef ARDUINO
+        return micros();
+#else
+        using namespace std::chrono;
+        return static_cast<std::uint32_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+namespace detail {
+
+    // whole ticks of 1 / rate seconds in dt plus the fraction carried from the
+    // last call, leaving the new fraction in carry. More ticks than a uint32_t
+    // holds are clamped and the rest of the time dropped.
+    template <typename T>
+    std::uint32_t whole_ticks(T dt, std::uint32_t rate, T &carry)
+    {
+        const T ticks = dt * static_cast<T>(rate) + carry;
+        if (ticks >= static_cast<T>(std::numeric_limits<std::uint32_t>::max()))
+        {
+            carry = T(0);
+            return std::numeric_limits<std::uint32_t>::max();
+        }
+        const std::uint32_t whole = ticks > T(0) ? static_cast<std::uint32_t>(ticks) : 0;
+        carry = ticks - static_cast<T>(whole);
+        return whole;
+    }
+
+}
+
+}
@@ -8,11 +8,11 @@
 
 namespace mp {
     
-    float mp_sqrt(float f) { return sqrtf(f); }
-    double mp_sqrt(double d) { return sqrt(d); }
+    inline float mp_sqrt(float f) { return sqrtf(f); }
+    inline double mp_sqrt(double d) { return sqrt(d); }
 
-    float exp_fun(float f) { return expf(f); }
-    double exp_fun(double d) { return exp(d); }
+    inline float exp_fun(float f) { return expf(f); }
+    inline double exp_fun(double d) { return exp(d); }
     template <typename T>
     typename std::enable_if<std::is_integral<T>::value, T>::type
     exp_fun(T i) { return expf(static_cast<float>(i)); }
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace mp {
+
+    // minimal allocator returning storage aligned to Alignment bytes so that
+    // per-axis particle arrays can be loaded with aligned vector instructions
+    template <typename T, std::size_t Alignment = 64>
+    struct aligned_allocator
+    {
+        static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+        static_assert(Alignment >= sizeof(void *), "Alignment must be able to hold a pointer");
+
+        using value_type = T;
+
+        template <typename U>
+        struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+        aligned_allocator() = default;
+        template <typename U>
+        aligned_allocator(const aligned_allocator<U, Alignment> &) {}
+
+        T *allocate(std::size_t n)
+        {
+            // over-allocate and stash the original pointer just before the aligned block
+            void *raw = ::operator new(n * sizeof(T) + Alignment + sizeof(void *));
+            std::uintptr_t address = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *);
+            address = (address + Alignment - 1) & ~static_cast<std::uintptr_t>(Alignment - 1);
+            void **aligned = reinterpret_cast<void **>(address);
+            aligned[-1] = raw;
+            return reinterpret_cast<T *>(aligned);
+        }
+
+        void deallocate(T *ptr, std::size_t)
+        {
+            if (ptr != nullptr)
+                ::operator delete(reinterpret_cast<void **>(ptr)[-1]);
+        }
+
+        template <typename U>
+        bool operator==(const aligned_allocator<U, Alignment> &) const { return true; }
+        template <typename U>
+        bool operator!=(const aligned_allocator<U, Alignment> &) const { return false; }
+    };
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <type_traits>
 
 namespace mp {
@@ -24,6 +25,14 @@ struct unwrap_reference<std::reference_wrapper<U>> { using type = U&; };
 template <typename T>
 using unwrap_reference_t = typename unwrap_reference<T>::type;
 
+// position of T in Ts, incomplete if T is not there
+template <typename T, typename... Ts>
+struct index_of;
+template <typename T, typename... Ts>
+struct index_of<T, T, Ts...> : std::integral_constant<std::size_t, 0> {};
+template <typename T, typename U, typename... Ts>
+struct index_of<T, U, Ts...> : std::integral_constant<std::size_t, 1 + index_of<T, Ts...>::value> {};
+
 
 } // namespace meta
 } // namespace mp
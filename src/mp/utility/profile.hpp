@@ -0,0 +1,245 @@
+#pragma once
+
+// Per-phase timers and counters for World::step. Define MP_USE_PROFILE before
+// including World.hpp to compile them in; otherwise the macros below expand to
+// nothing and World carries no profiler.
+//   MP_PROFILE_SCOPE(profiler, Phase)      time the rest of the enclosing scope
+//   MP_PROFILE_CALL(profiler, Phase, call) time one call, keeping its result
+//   MP_PROFILE_COUNT(profiler, Counter, n) add n to a counter
+#ifdef MP_USE_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "../io/byte_sink.hpp"
+
+#define MP_PROFILE_CONCAT_(a, b) a##b
+#define MP_PROFILE_CONCAT(a, b) MP_PROFILE_CONCAT_(a, b)
+#define MP_PROFILE_SCOPE(profiler, phase) \
+    ::mp::profile_scope MP_PROFILE_CONCAT(mp_profile_scope_, __LINE__)((profiler), ::mp::ProfilePhase::phase)
+#define MP_PROFILE_CALL(profiler, phase, call) (profiler).time(::mp::ProfilePhase::phase, [&]() { return call; })
+#define MP_PROFILE_COUNT(profiler, counter, n) (profiler).add(::mp::ProfileCounter::counter, (n))
+
+namespace mp {
+
+enum class ProfilePhase
+{
+    // a whole call to World::step or stepTicks
+    Step,
+    SubStep,
+    // registered forces and velocity integration, including the force callback
+    Forces,
+    ForceCallback,
+    UserCallback,
+    // all constraint iterations of a sub-step
+    Constraints,
+    Iteration,
+    // position integration, including the position handler
+    Integrate,
+    PositionHandler,
+    Snapshot,
+    count
+};
+
+enum class ProfileCounter
+{
+    Steps,
+    SubSteps,
+    Iterations,
+    count
+};
+
+inline const char *profile_name(ProfilePhase phase)
+{
+    static const char *const names[] = {"step", "sub_step", "forces", "force_cb", "user_cb", "constraints",
+        "iteration", "integrate", "position_handler", "snapshot"};
+    return names[static_cast<int>(phase)];
+}
+
+inline const char *profile_name(ProfileCounter counter)
+{
+    static const char *const names[] = {"steps", "sub_steps", "iterations"};
+    return names[static_cast<int>(counter)];
+}
+
+// Totals per phase and counter, and optionally a trace of every scoped phase
+// for export as Chrome trace-event JSON (chrome://tracing, Perfetto). Totals
+// may be added to from the executor's threads, so callbacks run in parallel
+// can sum to more than the wall time of their phase. Scopes and counters are
+// only traced from the stepping thread.
+class Profiler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Totals
+    {
+        std::uint64_t calls;
+        std::uint64_t nanoseconds;
+    };
+
+    Profiler() : epoch(clock::now()) {}
+
+    Totals phase(ProfilePhase p) const
+    {
+        const phase_totals &t = phases[static_cast<int>(p)];
+        return {t.calls.load(std::memory_order_relaxed), t.nanoseconds.load(std::memory_order_relaxed)};
+    }
+    std::uint64_t count(ProfileCounter c) const { return counters[static_cast<int>(c)].load(std::memory_order_relaxed); }
+
+    // keep up to capacity trace events; 0 stops tracing
+    void enableTrace(std::size_t capacity)
+    {
+        events.clear();
+        events.reserve(capacity);
+        traceCapacity = capacity;
+        droppedEvents = 0;
+    }
+    std::size_t traceSize() const { return events.size(); }
+    // events not kept because the trace was full
+    std::size_t traceDropped() const { return droppedEvents; }
+
+    // clear totals, counters and the trace
+    void reset()
+    {
+        for (phase_totals &t : phases)
+        {
+            t.calls = 0;
+            t.nanoseconds = 0;
+        }
+        for (std::atomic<std::uint64_t> &c : counters)
+            c = 0;
+        events.clear();
+        droppedEvents = 0;
+        epoch = clock::now();
+    }
+
+    void add(ProfileCounter c, std::uint64_t n)
+    {
+        const std::uint64_t total = counters[static_cast<int>(c)].fetch_add(n, std::memory_order_relaxed) + n;
+        trace({event::counter, static_cast<int>(c), now(), total});
+    }
+
+    template <typename Fn>
+    auto time(ProfilePhase p, Fn &&fn) -> decltype(fn())
+    {
+        const call_timer timer(*this, p);
+        return fn();
+    }
+
+    // nanoseconds since construction or reset
+    std::uint64_t now() const
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count());
+    }
+
+    void record(ProfilePhase p, std::uint64_t start, std::uint64_t duration, bool traced)
+    {
+        phase_totals &t = phases[static_cast<int>(p)];
+        t.calls.fetch_add(1, std::memory_order_relaxed);
+        t.nanoseconds.fetch_add(duration, std::memory_order_relaxed);
+        if (traced)
+            trace({event::complete, static_cast<int>(p), start, duration});
+    }
+
+    // the trace as a JSON object of trace events, microsecond timestamps
+    bool writeChromeTrace(ByteSink &sink) const
+    {
+        bool ok = put(sink, "{\"traceEvents\":[\n");
+        char line[160];
+        for (std::size_t i = 0; i < events.size() && ok; ++i)
+        {
+            const event &e = events[i];
+            const char *comma = i + 1 < events.size() ? "," : "";
+            if (e.kind == event::complete)
+                std::snprintf(line, sizeof(line),
+                    "{\"name\":\"%s\",\"cat\":\"mp\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0}%s\n",
+                    profile_name(static_cast<ProfilePhase>(e.id)), e.start * 1e-3, e.value * 1e-3, comma);
+            else
+                std::snprintf(line, sizeof(line),
+                    "{\"name\":\"%s\",\"cat\":\"mp\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"tid\":0,\"args\":{\"total\":%llu}}%s\n",
+                    profile_name(static_cast<ProfileCounter>(e.id)), e.start * 1e-3,
+                    static_cast<unsigned long long>(e.value), comma);
+            ok = put(sink, line);
+        }
+        ok = ok && put(sink, "],\"displayTimeUnit\":\"ns\"}\n");
+        sink.flush();
+        return ok;
+    }
+
+private:
+    struct phase_totals
+    {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> nanoseconds{0};
+    };
+
+    struct event
+    {
+        enum kind_t : std::uint8_t { complete, counter } kind;
+        int id;
+        std::uint64_t start;
+        // duration of a phase or total of a counter
+        std::uint64_t value;
+    };
+
+    // totals only, as it may run on any thread
+    struct call_timer
+    {
+        call_timer(Profiler &profiler, ProfilePhase phase) : profiler(profiler), phase(phase), start(profiler.now()) {}
+        ~call_timer() { profiler.record(phase, start, profiler.now() - start, false); }
+        Profiler &profiler;
+        ProfilePhase phase;
+        std::uint64_t start;
+    };
+
+    void trace(const event &e)
+    {
+        if (traceCapacity == 0)
+            return;
+        if (events.size() < traceCapacity)
+            events.push_back(e);
+        else
+            ++droppedEvents;
+    }
+
+    static bool put(ByteSink &sink, const char *text)
+    {
+        std::size_t size = 0;
+        while (text[size] != '\0')
+            ++size;
+        return sink.write(reinterpret_cast<const std::uint8_t *>(text), size);
+    }
+
+    phase_totals phases[static_cast<int>(ProfilePhase::count)];
+    std::atomic<std::uint64_t> counters[static_cast<int>(ProfileCounter::count)] = {};
+    clock::time_point epoch;
+    std::vector<event> events;
+    std::size_t traceCapacity = 0;
+    std::size_t droppedEvents = 0;
+};
+
+// times its scope into the totals and the trace
+class profile_scope
+{
+public:
+    profile_scope(Profiler &profiler, ProfilePhase phase) : profiler(profiler), phase(phase), start(profiler.now()) {}
+    ~profile_scope() { profiler.record(phase, start, profiler.now() - start, true); }
+    profile_scope(const profile_scope &) = delete;
+    profile_scope &operator=(const profile_scope &) = delete;
+
+private:
+    Profiler &profiler;
+    ProfilePhase phase;
+    std::uint64_t start;
+};
+
+}
+
+#else
+#define MP_PROFILE_SCOPE(profiler, phase) do {(void)0;} while (0)
+#define MP_PROFILE_CALL(profiler, phase, call) (call)
+#define MP_PROFILE_COUNT(profiler, counter, n) do {(void)0;} while (0)
+#endif
@@ -29,6 +29,8 @@ namespace mp {
         contiguous_range(C &c) : contiguous_range(c.data(), c.size()) {}
         T *begin() { return _begin; }
         T *end() { return _begin + _size; }
+        T &operator[](std::size_t i) { return _begin[i]; }
+        const T &operator[](std::size_t i) const { return _begin[i]; }
         std::size_t size() const { return _size; }
 
     private:
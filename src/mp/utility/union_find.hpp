@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mp {
+
+    // disjoint sets over [0, n) with union by size and path halving, so sets
+    // can be merged incrementally as connections are added
+    struct union_find
+    {
+        union_find() = default;
+        explicit union_find(std::size_t n) { reset(n); }
+
+        void reset(std::size_t n)
+        {
+            parent.resize(n);
+            setSize.assign(n, 1);
+            for (std::size_t i = 0; i < n; ++i)
+                parent[i] = static_cast<std::uint32_t>(i);
+        }
+
+        std::uint32_t find(std::uint32_t i)
+        {
+            while (parent[i] != i)
+            {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+
+        // returns the root of the merged set
+        std::uint32_t unite(std::uint32_t a, std::uint32_t b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return a;
+            if (setSize[a] < setSize[b])
+                std::swap(a, b);
+            parent[b] = a;
+            setSize[a] += setSize[b];
+            return a;
+        }
+
+        std::size_t size() const { return parent.size(); }
+
+    private:
+        std::vector<std::uint32_t> parent;
+        std::vector<std::uint32_t> setSize;
+    };
+
+}
@@ -0,0 +1,239 @@
+// Headless benchmark of World::step on the scenes of the SDL programs, from 1k
+// to 1M particles in float and double. Writes JSON results:
+//   bench-world [output.json] [max particles] [simulated seconds]
+// With no output file the JSON goes to stdout. Progress goes to stderr.
+#include "../../src/mp/World.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Result
+{
+    std::string scene;
+    std::string type;
+    std::size_t particles = 0;
+    std::size_t constraints = 0;
+    long subSteps = 0;
+    // constraint passes over all sub-steps
+    long iterations = 0;
+    double seconds = 0;
+};
+
+template <typename T>
+const char *type_name() { return sizeof(T) == sizeof(float) ? "float" : "double"; }
+
+// steps until seconds of simulated time have passed, timing everything after
+// a first untimed step
+template <typename World_t, typename T>
+void run(World_t &world, T seconds, Result &result)
+{
+    world.setMaxSubSteps(1);
+    world.step(world.stepSize);
+    const int steps = static_cast<int>(std::ceil(seconds / world.stepSize));
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s)
+    {
+        world.step(world.stepSize);
+        result.subSteps += world.status.subSteps;
+        result.iterations += static_cast<long>(world.status.subSteps) * world.status.iterations;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the grid of cloth.cpp, three times as wide as it is high and pinned along
+// the top and sides, joined to its right and lower neighbours
+template <typename T>
+std::vector<mp::Particle<3, T>> cloth_grid(std::size_t n, int &width, int &height)
+{
+    height = std::max(2, static_cast<int>(std::lround(std::sqrt(n / 3.0))));
+    width = 3 * height;
+    std::vector<mp::Particle<3, T>> particles(static_cast<std::size_t>(width) * height);
+    const T spacing = T(140) / (width - 1);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            mp::Particle<3, T> &p = particles[x + y * width];
+            p.position = {T(-70) + x * spacing, T(-20) + y * spacing, T(0)};
+            if (y == 0 || x == 0 || x == width - 1)
+                p.inverseMass = T(0);
+        }
+    }
+    return particles;
+}
+
+template <typename World_t>
+void cloth_world(World_t &world)
+{
+    world.setGravity({0, -13, 0});
+    world.stepSize = 0.02f;
+}
+
+// cloth.cpp: a ConstraintSet of DistanceConstraints
+template <typename T>
+Result cloth(std::size_t n, T seconds)
+{
+    using Join = mp::DistanceConstraint<3, T>;
+    int width, height;
+    std::vector<mp::Particle<3, T>> particles = cloth_grid<T>(n, width, height);
+    mp::ConstraintSet<Join> joins;
+    joins.template reserve<Join>(2 * particles.size());
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const int i = x + y * width;
+            if (x + 1 < width)
+                joins.template emplace<Join>(particles[i], particles[i + 1]);
+            if (y + 1 < height)
+                joins.template emplace<Join>(particles[i], particles[i + width]);
+        }
+    }
+    mp::World<3, T> world;
+    world.addParticles({particles});
+    world.addConstraints(joins);
+    cloth_world(world);
+
+    Result result;
+    result.scene = "cloth";
+    result.particles = particles.size();
+    result.constraints = joins.template get<Join>().size();
+    run(world, seconds, result);
+    return result;
+}
+
+// the same cloth as an IndexedDistanceSet
+template <typename T>
+Result cloth_indexed(std::size_t n, T seconds)
+{
+    int width, height;
+    std::vector<mp::Particle<3, T>> particles = cloth_grid<T>(n, width, height);
+    mp::IndexedDistanceSet<3, T> joins;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const int i = x + y * width;
+            if (x + 1 < width)
+                joins.add(particles, i, i + 1);
+            if (y + 1 < height)
+                joins.add(particles, i, i + width);
+        }
+    }
+    mp::World<3, T> world;
+    world.addParticles({particles});
+    world.addConstraints(joins);
+    cloth_world(world);
+
+    Result result;
+    result.scene = "cloth_indexed";
+    result.particles = particles.size();
+    result.constraints = joins.size();
+    run(world, seconds, result);
+    return result;
+}
+
+template <typename T>
+void wrap_string(mp::Particle<2, T> &particle)
+{
+    if (particle.position.x() > T(1))
+        particle.position.x() = T(0);
+    if (particle.position.x() < T(0))
+        particle.position.x() = T(1);
+}
+
+// looped_string.cpp: a loop of WrappedDistanceConstraints through virtual calls
+template <typename T>
+Result looped_string(std::size_t n, T seconds)
+{
+    using Wrapped = mp::WrappedDistanceConstraint<2, T>;
+    std::vector<mp::Particle<2, T>> particles(n);
+    for (std::size_t i = 0; i < n; ++i)
+        particles[i].position = {static_cast<T>(i / static_cast<double>(n)), static_cast<T>(0.01 * std::sin(0.001 * i))};
+    std::vector<Wrapped> constraints;
+    constraints.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        constraints.emplace_back(particles[i], particles[(i + 1) % n], mp::Vec<2, T>{T(1), T(0)}, T(1), T(0.6));
+    std::vector<std::reference_wrapper<mp::Constraint<2, T>>> refs(constraints.begin(), constraints.end());
+
+    mp::World<2, T> world;
+    world.addParticles({particles});
+    world.addConstraints({refs});
+    world.setPositionCB(wrap_string<T>);
+    world.iterationCount = 2;
+    world.stepSize = 0.04f;
+    world.setGravity({0, T(-9.5)});
+    world.setDamping(0.3f);
+
+    Result result;
+    result.scene = "looped_string";
+    result.particles = n;
+    result.constraints = n;
+    run(world, seconds, result);
+    return result;
+}
+
+void print(std::FILE *out, const std::vector<Result> &results, double seconds)
+{
+    std::fprintf(out, "{\n  \"simulated_seconds\": %g,\n  \"results\": [\n", seconds);
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &r = results[i];
+        const double ns = r.seconds * 1e9;
+        std::fprintf(out,
+            "    {\"scene\": \"%s\", \"type\": \"%s\", \"particles\": %zu, \"constraints\": %zu, "
+            "\"sub_steps\": %ld, \"iterations\": %ld, \"seconds\": %.6f, "
+            "\"ns_per_particle_step\": %.3f, \"ns_per_constraint_solve\": %.3f}%s\n",
+            r.scene.c_str(), r.type.c_str(), r.particles, r.constraints, r.subSteps, r.iterations, r.seconds,
+            ns / (static_cast<double>(r.particles) * r.subSteps),
+            ns / (static_cast<double>(r.constraints) * r.iterations),
+            i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+template <typename T>
+void bench(std::vector<Result> &results, std::size_t maxParticles, double seconds)
+{
+    using scene_fn = Result (*)(std::size_t, T);
+    const scene_fn scenes[] = {cloth<T>, cloth_indexed<T>, looped_string<T>};
+    for (std::size_t n = 1000; n <= maxParticles; n *= 10)
+    {
+        for (scene_fn scene : scenes)
+        {
+            Result r = scene(n, static_cast<T>(seconds));
+            r.type = type_name<T>();
+            std::fprintf(stderr, "%-14s %-6s %8zu particles %8.3f s %8.2f ns/particle-step\n",
+                r.scene.c_str(), r.type.c_str(), r.particles, r.seconds,
+                r.seconds * 1e9 / (static_cast<double>(r.particles) * r.subSteps));
+            results.push_back(r);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : nullptr;
+    const std::size_t maxParticles = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    const double seconds = argc > 3 ? std::atof(argv[3]) : 0.4;
+
+    std::vector<Result> results;
+    bench<float>(results, maxParticles, seconds);
+    bench<double>(results, maxParticles, seconds);
+
+    std::FILE *out = path != nullptr ? std::fopen(path, "w") : stdout;
+    if (out == nullptr)
+    {
+        std::fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    print(out, results, seconds);
+    if (out != stdout)
+        std::fclose(out);
+    return 0;
+}
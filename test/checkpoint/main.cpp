@@ -0,0 +1,214 @@
+#include "../../src/mp/io/checkpoint.hpp"
+#include "../../src/mp/io/mapped_file.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using Particle2 = mp::Particle<2, double>;
+using Store2 = mp::ParticleStore<2, double>;
+
+constexpr int side = 20;
+
+// a square of cloth pinned along its top edge
+template <typename Particles>
+void setUp(mp::World<2, double, Particles> &world, Particles particles, mp::IndexedDistanceSet<2, double> &cloth)
+{
+    for (int i = 0; i < side * side; ++i)
+    {
+        particles[i].position = {0.05 * (i % side), -0.05 * (i / side)};
+        particles[i].inverseMass = i < side ? 0.0 : 1.0;
+    }
+    for (int i = 0; i < side * side; ++i)
+    {
+        if (i % side + 1 < side)
+            cloth.add(particles, i, i + 1);
+        if (i + side < side * side)
+            cloth.add(particles, i, i + side);
+    }
+    cloth.strength = 0.5;
+    world.addParticles(particles);
+    world.addConstraints(cloth);
+    world.setGravity({0.3, -9.8});
+    world.setDamping(1.5);
+    world.iterationCount = 4;
+}
+
+template <typename A, typename B>
+bool samePositions(A a, B b, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const mp::Vec<2, double> pa = a[i].position, pb = b[i].position;
+        if (std::memcmp(&pa, &pb, sizeof(pa)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// save part way through, and check a World restored from the checkpoint
+// finishes the run exactly as the original
+bool particlesRoundTrip()
+{
+    std::vector<Particle2> particles(side * side);
+    mp::IndexedDistanceSet<2, double> cloth;
+    mp::World<2, double> world;
+    setUp<mp::contiguous_range<Particle2>>(world, {particles}, cloth);
+    for (int s = 0; s < 50; ++s)
+        world.step(0.013);
+
+    std::vector<std::uint8_t> bytes;
+    mp::writeCheckpoint(world, bytes);
+    for (int s = 0; s < 50; ++s)
+        world.step(0.013);
+
+    mp::Checkpoint<2, double> checkpoint(bytes.data(), bytes.size());
+    if (!checkpoint.valid() || checkpoint.isStore() || checkpoint.particleCount() != particles.size() || checkpoint.indexedSetCount() != 1)
+        return false;
+    mp::IndexedDistanceSet<2, double> restoredCloth;
+    checkpoint.loadIndexedSet(0, restoredCloth);
+    mp::World<2, double> restored;
+    restored.addParticles(checkpoint.particles());
+    restored.addConstraints(restoredCloth);
+    checkpoint.restore(restored);
+    for (int s = 0; s < 50; ++s)
+        restored.step(0.013);
+    return restoredCloth.strength == 0.5 && samePositions(mp::contiguous_range<Particle2>(particles), checkpoint.particles(), particles.size());
+}
+
+// the same for ParticleStore arrays, mapped from a file and stepped in place
+bool storeRoundTrip(const char *path)
+{
+    Store2 store(side * side);
+    mp::IndexedDistanceSet<2, double> cloth;
+    mp::World<2, double, Store2::range> world;
+    setUp<Store2::range>(world, store, cloth);
+    world.setTickRate(1000);
+    for (int s = 0; s < 50; ++s)
+        world.step(0.0137);
+    if (!mp::saveCheckpoint(world, path))
+        return false;
+    std::vector<std::uint8_t> saved;
+    mp::writeCheckpoint(world, saved);
+    for (int s = 0; s < 50; ++s)
+        world.step(0.0137);
+
+    {
+        mp::mapped_file file(path);
+        mp::Checkpoint<2, double> checkpoint(file.data(), file.size());
+        if (!checkpoint.valid() || !checkpoint.isStore())
+            return false;
+        mp::IndexedDistanceSet<2, double> restoredCloth;
+        checkpoint.loadIndexedSet(0, restoredCloth);
+        mp::World<2, double, Store2::range> restored;
+        restored.addParticles(checkpoint.store());
+        restored.addConstraints(restoredCloth);
+        checkpoint.restore(restored);
+        if (restored.getTickRate() != 1000)
+            return false;
+        for (int s = 0; s < 50; ++s)
+            restored.step(0.0137);
+        if (!samePositions(Store2::range(store), checkpoint.store(), store.size()))
+            return false;
+    }
+
+    // stepping the mapping copied pages rather than writing to the file
+    mp::mapped_file again(path);
+    return again.size() == saved.size() && std::memcmp(again.data(), saved.data(), saved.size()) == 0;
+}
+
+bool rejectsBadCheckpoints()
+{
+    std::vector<Particle2> particles(side * side);
+    mp::IndexedDistanceSet<2, double> cloth;
+    mp::World<2, double> world;
+    setUp<mp::contiguous_range<Particle2>>(world, {particles}, cloth);
+    std::vector<std::uint8_t> bytes;
+    mp::writeCheckpoint(world, bytes);
+
+    mp::Checkpoint<2, double> truncated(bytes.data(), bytes.size() - 1);
+    mp::Checkpoint<2, float> otherType(bytes.data(), bytes.size());
+    mp::Checkpoint<3, double> otherDim(bytes.data(), bytes.size());
+    std::vector<std::uint8_t> corrupt = bytes;
+    // first constraint's first particle, pointed outside the particles
+    const std::size_t constraintOffset = bytes.size() - cloth.size() * sizeof(mp::IndexedDistanceConstraint<double>);
+    corrupt[constraintOffset + 3] = 0xff;
+    mp::Checkpoint<2, double> badIndex(corrupt.data(), corrupt.size());
+    // enums outside their range
+    using Header = mp::detail::checkpoint_header<2, double>;
+    std::vector<std::uint8_t> badMode = bytes, badPolicy = bytes;
+    badMode[offsetof(Header, solverMode)] = 0xff;
+    badPolicy[offsetof(Header, policy)] = 0xff;
+    mp::Checkpoint<2, double> modeCheck(badMode.data(), badMode.size());
+    mp::Checkpoint<2, double> policyCheck(badPolicy.data(), badPolicy.size());
+    // the index is only read when the set is loaded
+    mp::IndexedDistanceSet<2, double> badSet;
+    const bool indexRejected = badIndex.valid() && !badIndex.loadIndexedSet(0, badSet) && badSet.size() == 0;
+    return !truncated.valid() && !otherType.valid() && !otherDim.valid() && indexRejected &&
+        !modeCheck.valid() && !policyCheck.valid() &&
+        otherType.particles().size() == 0;
+}
+
+// opening a big checkpoint costs only the mapping, not a pass over the
+// particles or the constraints
+void timeLargeLoad(const char *path)
+{
+    using clock = std::chrono::steady_clock;
+    const std::uint32_t width = 1000;
+    const std::size_t n = width * width;
+    {
+        mp::ParticleStore<3, float> store(n);
+        // a cloth's worth of joins, about two per particle
+        mp::IndexedDistanceSet<3, float> joins;
+        for (std::uint32_t i = 0; i < n; ++i)
+        {
+            if (i % width + 1 < width)
+                joins.add(i, i + 1, 1.0f);
+            if (i + width < n)
+                joins.add(i, i + width, 1.0f);
+        }
+        mp::World<3, float, mp::ParticleStore<3, float>::range> world;
+        world.addParticles(store);
+        world.addConstraints(joins);
+        mp::saveCheckpoint(world, path);
+    }
+    const clock::time_point start = clock::now();
+    mp::mapped_file file(path);
+    mp::Checkpoint<3, float> checkpoint(file.data(), file.size());
+    mp::World<3, float, mp::ParticleStore<3, float>::range> world;
+    world.addParticles(checkpoint.store());
+    checkpoint.restore(world);
+    const double opened = std::chrono::duration<double>(clock::now() - start).count();
+    mp::IndexedDistanceSet<3, float> joins;
+    checkpoint.loadIndexedSet(0, joins);
+    const double loaded = std::chrono::duration<double>(clock::now() - start).count() - opened;
+    std::cout << "opened " << checkpoint.particleCount() << " particle, " << joins.size() << " constraint checkpoint of "
+        << file.size() / 1000000.0 << " MB in " << opened * 1000.0 << " ms, constraints loaded in " << loaded * 1000.0 << " ms\n";
+}
+
+int main()
+{
+    const char *path = "test-checkpoint.bin";
+    if (!particlesRoundTrip())
+    {
+        std::cout << "restored Particle checkpoint differs\n";
+        return 1;
+    }
+    if (!storeRoundTrip(path))
+    {
+        std::cout << "restored ParticleStore checkpoint differs\n";
+        return 1;
+    }
+    if (!rejectsBadCheckpoints())
+    {
+        std::cout << "bad checkpoint accepted\n";
+        return 1;
+    }
+    timeLargeLoad(path);
+    std::remove(path);
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
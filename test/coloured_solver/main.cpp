@@ -0,0 +1,58 @@
+#include "../common/cloth.hpp"
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <iostream>
+#include <set>
+#include <vector>
+
+int main()
+{
+    Cloth serial(Kind::Range, 40, 30), parallel(Kind::Range, 40, 30), typed(Kind::Typed, 40, 30);
+    serial.world.setSolverMode(mp::SolverMode::Coloured);
+    parallel.world.setSolverMode(mp::SolverMode::Coloured);
+    mp::ThreadPool pool(4);
+    parallel.world.setExecutor(&pool);
+    parallel.world.setGrainSize(32);
+    typed.world.setSolverMode(mp::SolverMode::Coloured);
+    typed.world.setExecutor(&pool);
+    typed.world.setGrainSize(32);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        serial.world.step(0.016);
+        parallel.world.step(0.016);
+        typed.world.step(0.016);
+    }
+
+    // no particle may appear twice within a colour
+    mp::ConstraintColouring<3, double> &colouring = parallel.world.colouring;
+    for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+    {
+        std::set<const Particle3 *> seen;
+        for (Constraint3 *constraint : colouring.colour(c))
+        {
+            if (!seen.insert(&constraint->p1).second || !seen.insert(&constraint->p2).second)
+            {
+                std::cout << "colour " << c << " shares a particle\n";
+                return 1;
+            }
+        }
+    }
+    std::cout << "colours: " << colouring.colourCount() << "\n";
+
+    // colours are independent so the threaded result matches the serial one exactly,
+    // as does the batched solve of the same colours from a ConstraintSet
+    for (std::size_t i = 0; i < serial.particles.size(); ++i)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (serial.particles[i].position[axis] != parallel.particles[i].position[axis] ||
+                serial.particles[i].position[axis] != typed.particles[i].position[axis])
+            {
+                std::cout << "mismatch at particle " << i << "\n";
+                return 1;
+            }
+        }
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
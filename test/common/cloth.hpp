@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../../src/mp/World.hpp"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// Scene shared by the solver tests: a cloth of particles one unit apart,
+// hanging from its top row, each joined to its neighbours right and below.
+
+using Particle3 = mp::Particle<3, double>;
+using Constraint3 = mp::Constraint<3, double>;
+using Distance3 = mp::DistanceConstraint<3, double>;
+
+// the three ways World takes constraints
+enum class Kind { Range, Typed, Indexed };
+
+inline std::vector<Particle3> clothParticles(int width, int height)
+{
+    std::vector<Particle3> particles(width * height);
+    for (int i = 0; i < width * height; ++i)
+    {
+        particles[i].position = {static_cast<double>(i % width), -static_cast<double>(i / width), 0.0};
+        if (i < width)
+            particles[i].inverseMass = 0.0;
+    }
+    return particles;
+}
+
+// join(i, j) for every pair of neighbours, in the order Cloth adds them
+template <typename F>
+void forEachJoin(int width, int height, F join)
+{
+    for (int i = 0; i < width * height; ++i)
+    {
+        if (i % width + 1 < width)
+            join(i, i + 1);
+        if (i + width < width * height)
+            join(i, i + width);
+    }
+}
+
+// The joins are built all three ways, in the same order, and World is given
+// the ones kind names. compliance is set on all of them.
+struct Cloth
+{
+    Cloth(Kind kind, int width = 20, int height = 20, double compliance = 0.0)
+        : particles(clothParticles(width, height))
+    {
+        joins.reserve(2 * particles.size());
+        indexed.compliance = compliance;
+        forEachJoin(width, height, [&](int i, int j) {
+            joins.emplace_back(particles[i], particles[j]);
+            joins.back().setCompliance(compliance);
+            set.emplace<Distance3>(particles[i], particles[j]).setCompliance(compliance);
+            indexed.add(particles, i, j);
+        });
+        refs.assign(joins.begin(), joins.end());
+        world.addParticles({particles});
+        if (kind == Kind::Range)
+            world.addConstraints({refs});
+        else if (kind == Kind::Typed)
+            world.addConstraints(set);
+        else
+            world.addConstraints(indexed);
+        world.setGravity({0.0, -9.8, 0.0});
+    }
+
+    Cloth(const Cloth &) = delete;
+    Cloth &operator=(const Cloth &) = delete;
+
+    // steps of 10 ms
+    void run(int steps)
+    {
+        for (int s = 0; s < steps; ++s)
+            world.step(0.01);
+    }
+
+    // largest relative stretch of any join
+    double stretch() const
+    {
+        double worst = 0.0;
+        for (const Distance3 &join : joins)
+        {
+            const double s = std::abs(join.relativePosition().length() - join.restLength()) / join.restLength();
+            // NaN is never within limits
+            worst = s < worst ? worst : s;
+        }
+        return worst;
+    }
+
+    bool samePositions(const Particle3 *other) const
+    {
+        for (std::size_t i = 0; i < particles.size(); ++i)
+            if (std::memcmp(&particles[i].position, &other[i].position, sizeof(particles[i].position)) != 0)
+                return false;
+        return true;
+    }
+
+    std::vector<Particle3> particles;
+    std::vector<Distance3> joins;
+    std::vector<std::reference_wrapper<Constraint3>> refs;
+    mp::ConstraintSet<Distance3> set;
+    mp::IndexedDistanceSet<3, double> indexed;
+    mp::World<3, double> world;
+};
@@ -0,0 +1,106 @@
+#include "../../src/mp/constraints/constraint.hpp"
+#include "../../src/mp/constraints/colouring.hpp"
+#include "../../src/mp/constraints/distance_batch.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+template <typename T>
+void join(std::vector<mp::DistanceConstraint<2, T>> &constraints, mp::Particle<2, T> &p1, mp::Particle<2, T> &p2)
+{
+    constraints.emplace_back(p1, p2, T{0.8}, T{0.4});
+}
+
+template <typename T>
+void join(std::vector<mp::WrappedDistanceConstraint<2, T>> &constraints, mp::Particle<2, T> &p1, mp::Particle<2, T> &p2)
+{
+    constraints.emplace_back(p1, p2, mp::Vec<2, T>{1.0, 0.0}, T{0.8}, T{0.4});
+}
+
+// solves a jittered grid of distance constraints colour by colour, either
+// one at a time or through the batch kernel, and returns the final velocities
+template <typename T, template <int, typename> class C>
+std::vector<mp::Particle<2, T>> run(bool batched, mp::simd::Isa isa)
+{
+    using Particle_t = mp::Particle<2, T>;
+    using Constraint_t = C<2, T>;
+    const int width = 23, height = 17;
+
+    std::vector<Particle_t> particles(width * height);
+    for (int i = 0; i < width * height; ++i)
+    {
+        particles[i].position = {static_cast<T>((i % width) / static_cast<T>(width) + 0.01 * std::sin(i)), 
+            static_cast<T>((i / width) / static_cast<T>(width))};
+        particles[i].linearVelocity = {static_cast<T>(std::cos(3 * i)), static_cast<T>(std::sin(5 * i))};
+        particles[i].inverseMass = i < width ? T{0} : T{1};
+    }
+
+    std::vector<Constraint_t> constraints;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int i = x + y * width;
+            join(constraints, particles[i], particles[y * width + (x + 1) % width]);
+            if (y < height - 1)
+                join(constraints, particles[i], particles[i + width]);
+        }
+    }
+    for (Particle_t &p : particles)
+        p.position = p.position * T{1.05};
+
+    std::vector<std::reference_wrapper<mp::Constraint<2, T>>> refs(constraints.begin(), constraints.end());
+    mp::ConstraintColouring<2, T> colouring;
+    colouring.build({refs});
+
+    mp::simd::setMaxIsa(isa);
+    for (int iteration = 0; iteration < 10; ++iteration)
+    {
+        for (std::size_t c = 0; c < colouring.colourCount(); ++c)
+        {
+            std::vector<Constraint_t *> group;
+            for (mp::Constraint<2, T> *constraint : colouring.colour(c))
+                group.push_back(static_cast<Constraint_t *>(constraint));
+            if (batched)
+                mp::solveDistanceBatch(group.data(), group.size(), T{0.01});
+            else
+                for (Constraint_t *constraint : group)
+                    constraint->solve(T{0.01});
+        }
+    }
+    return particles;
+}
+
+template <typename T, template <int, typename> class C>
+bool compare(const char *name, T tolerance)
+{
+    const mp::simd::Isa isas[] = {mp::simd::Isa::Scalar, mp::simd::Isa::SSE4, mp::simd::Isa::AVX2};
+    std::vector<mp::Particle<2, T>> reference = run<T, C>(false, mp::simd::Isa::Scalar);
+    for (mp::simd::Isa isa : isas)
+    {
+        std::vector<mp::Particle<2, T>> batched = run<T, C>(true, isa);
+        T maxError = 0;
+        for (std::size_t i = 0; i < reference.size(); ++i)
+            for (int a = 0; a < 2; ++a)
+                maxError = std::max(maxError, std::abs(reference[i].linearVelocity[a] - batched[i].linearVelocity[a]));
+        std::cout << name << " isa " << static_cast<int>(isa) << " max error " << maxError << "\n";
+        if (!(maxError <= tolerance))
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    std::cout << "detected isa " << static_cast<int>(mp::simd::detectIsa()) << "\n";
+    if (!compare<double, mp::WrappedDistanceConstraint>("wrapped double", 1e-12) ||
+        !compare<float, mp::WrappedDistanceConstraint>("wrapped float", 1e-4f) ||
+        !compare<double, mp::DistanceConstraint>("distance double", 1e-12) ||
+        !compare<float, mp::DistanceConstraint>("distance float", 1e-4f))
+    {
+        std::cout << "batched solve differs from scalar\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "../../src/mp/World.hpp"
+#include "../../src/mp/WorldEnsemble.hpp"
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+constexpr int nParticles = 30;
+constexpr int nWorlds = 37;
+constexpr int nSteps = 200;
+
+template <typename T>
+std::vector<mp::Particle<2, T>> looped_string(int w)
+{
+    std::vector<mp::Particle<2, T>> particles(nParticles);
+    for (int i = 0; i < nParticles; ++i)
+    {
+        particles[i].position = {static_cast<T>(i / static_cast<T>(nParticles)), static_cast<T>(0.01 * std::sin(i))};
+        particles[i].linearVelocity = {T{0}, static_cast<T>(0.1 * std::cos(3 * i + w))};
+    }
+    // one pinned particle in some worlds, so lanes differ in mass
+    if (w % 3 == 0)
+        particles[0].inverseMass = T{0};
+    return particles;
+}
+
+template <typename T>
+void join(mp::IndexedDistanceSet<2, T> &set, std::vector<mp::Particle<2, T>> &particles)
+{
+    set.wrapRange = {T{1}, T{0}};
+    set.strength = T{1};
+    set.biasFactor = T(0.6);
+    for (int i = 0; i < nParticles; ++i)
+        set.add(particles, i, (i + 1) % nParticles);
+}
+
+template <typename T>
+T gravity(int w) { return static_cast<T>(-9.5 + 0.1 * w); }
+template <typename T>
+T damping(int w) { return static_cast<T>(0.3 + 0.05 * (w % 7)); }
+
+// every world of the ensemble must match a World stepped on its own
+template <typename T>
+bool compare(const char *name, mp::simd::Isa isa, mp::Executor *executor)
+{
+    mp::simd::setMaxIsa(isa);
+    mp::WorldEnsemble<2, T> ensemble(nWorlds, nParticles);
+    std::vector<std::vector<mp::Particle<2, T>>> reference(nWorlds);
+    std::vector<mp::IndexedDistanceSet<2, T>> sets(nWorlds);
+    std::vector<mp::World<2, T>> worlds(nWorlds);
+    for (int w = 0; w < nWorlds; ++w)
+    {
+        reference[w] = looped_string<T>(w);
+        join(sets[w], reference[w]);
+        worlds[w].addParticles({reference[w]});
+        worlds[w].addConstraints(sets[w]);
+        worlds[w].setGravity({T{0}, gravity<T>(w)});
+        worlds[w].setDamping(damping<T>(w));
+        worlds[w].iterationCount = 3;
+
+        ensemble.setParticles(w, reference[w]);
+        ensemble.setGravity(w, {T{0}, gravity<T>(w)});
+        ensemble.setDamping(w, damping<T>(w));
+    }
+    join(ensemble.constraints, reference[0]);
+    ensemble.iterationCount = 3;
+    ensemble.setExecutor(executor);
+
+    for (int s = 0; s < nSteps; ++s)
+    {
+        const T dt = static_cast<T>(s % 5 == 0 ? 0.025 : 0.0101);
+        for (mp::World<2, T> &world : worlds)
+            world.step(dt);
+        ensemble.step(dt);
+    }
+
+    std::size_t mismatches = 0;
+    for (int w = 0; w < nWorlds; ++w)
+    {
+        for (int i = 0; i < nParticles; ++i)
+        {
+            for (int a = 0; a < 2; ++a)
+            {
+                if (!std::isfinite(reference[w][i].position[a]) ||
+                    ensemble.position(w, i)[a] != reference[w][i].position[a] ||
+                    ensemble.velocity(w, i)[a] != reference[w][i].linearVelocity[a])
+                    ++mismatches;
+            }
+        }
+    }
+    std::cout << name << " isa " << static_cast<int>(mp::simd::activeIsa()) << (executor ? " threaded" : "")
+        << " mismatches " << mismatches << "\n";
+    return mismatches == 0;
+}
+
+// world-steps per second of separate Worlds against the ensemble
+template <typename T>
+void throughput(const char *name, mp::Executor *executor)
+{
+    using clock = std::chrono::steady_clock;
+    const int worldCount = 256;
+    mp::simd::setMaxIsa(mp::simd::Isa::AVX2);
+
+    std::vector<std::vector<mp::Particle<2, T>>> particles(worldCount);
+    std::vector<mp::IndexedDistanceSet<2, T>> sets(worldCount);
+    std::vector<mp::World<2, T>> worlds(worldCount);
+    mp::WorldEnsemble<2, T> ensemble(worldCount, nParticles);
+    for (int w = 0; w < worldCount; ++w)
+    {
+        particles[w] = looped_string<T>(w);
+        join(sets[w], particles[w]);
+        worlds[w].addParticles({particles[w]});
+        worlds[w].addConstraints(sets[w]);
+        worlds[w].setGravity({T{0}, gravity<T>(w)});
+        worlds[w].iterationCount = 2;
+        ensemble.setParticles(w, particles[w]);
+        ensemble.setGravity(w, {T{0}, gravity<T>(w)});
+    }
+    join(ensemble.constraints, particles[0]);
+    ensemble.iterationCount = 2;
+    ensemble.setExecutor(executor);
+
+    const int steps = 200;
+    clock::time_point start = clock::now();
+    for (int s = 0; s < steps; ++s)
+        for (mp::World<2, T> &world : worlds)
+            world.step(T(0.01));
+    const double separate = std::chrono::duration<double>(clock::now() - start).count();
+    start = clock::now();
+    for (int s = 0; s < steps; ++s)
+        ensemble.step(T(0.01));
+    const double together = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << name << (executor ? " threaded" : "") << " world-steps/s: worlds " << worldCount * steps / separate
+        << ", ensemble " << ensemble.worldSteps() / together << "\n";
+}
+
+int main()
+{
+    mp::ThreadPool pool(4);
+    const mp::simd::Isa isas[] = {mp::simd::Isa::Scalar, mp::simd::Isa::SSE4, mp::simd::Isa::AVX2};
+    for (mp::simd::Isa isa : isas)
+    {
+        if (!compare<double>("double", isa, nullptr) || !compare<float>("float", isa, nullptr))
+        {
+            std::cout << "ensemble differs from separate worlds\n";
+            return 1;
+        }
+    }
+    if (!compare<double>("double", mp::simd::Isa::AVX2, &pool) || !compare<float>("float", mp::simd::Isa::AVX2, &pool))
+    {
+        std::cout << "threaded ensemble differs from separate worlds\n";
+        return 1;
+    }
+
+    throughput<float>("float", nullptr);
+    throughput<float>("float", &pool);
+    throughput<double>("double", nullptr);
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include "../../src/mp/World.hpp"
+#include "../../src/mp/dynamics/force.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using Vec2 = mp::Vec<2, double>;
+using Particle2 = mp::Particle<2, double>;
+using Store2 = mp::ParticleStore<2, double>;
+
+const double dragCoefficient = 0.2;
+const Vec2 lift{0.0, 3.0};
+
+Vec2 dragAndLift(Particle2 &particle) { return particle.linearVelocity * -dragCoefficient + lift; }
+
+// stateful functor, as a medium would be
+struct Lift
+{
+    Vec2 force;
+    template <typename P>
+    Vec2 operator()(const P &) const { return force; }
+};
+
+std::vector<Particle2> makeParticles()
+{
+    std::vector<Particle2> particles(40);
+    for (std::size_t i = 0; i < particles.size(); ++i)
+    {
+        particles[i].position = {static_cast<double>(i), 0.0};
+        particles[i].linearVelocity = {static_cast<double>(i) * 0.1, 1.0};
+        particles[i].inverseMass = i % 5 == 0 ? 0.0 : 1.0 / (1.0 + i);
+    }
+    return particles;
+}
+
+bool same(const std::vector<Particle2> &a, const std::vector<Particle2> &b)
+{
+    for (std::size_t i = 0; i < a.size(); ++i)
+        for (int axis = 0; axis < 2; ++axis)
+            if (a[i].position[axis] != b[i].position[axis] || a[i].linearVelocity[axis] != b[i].linearVelocity[axis])
+                return false;
+    return true;
+}
+
+// velocity after one 10 ms step the way World integrated it before forces
+// were fused: every force through the accumulator, then integrateVelocity
+Vec2 baselineVelocity(Particle2 particle, Vec2 applied, Vec2 gravity, double damping)
+{
+    particle.applyForce(applied);
+    particle.applyForce(gravity / particle.inverseMass);
+    particle.applyForce(-damping * particle.linearVelocity);
+    particle.integrateVelocity(0.01);
+    return particle.linearVelocity;
+}
+
+bool near(Vec2 a, Vec2 b) { return std::abs(a[0] - b[0]) < 1e-9 && std::abs(a[1] - b[1]) < 1e-9; }
+
+// applyForce between steps is integrated unless accumulation is turned off
+template <typename W, typename P>
+bool appliedForceIntegrated(W &world, P &particles, const std::vector<Particle2> &initial)
+{
+    const Vec2 push{4.0, 2.0};
+    world.setGravity({0.0, -9.8});
+    world.addParticles({particles});
+    for (std::size_t i = 0; i < initial.size(); ++i)
+        if (initial[i].inverseMass != 0.0)
+            particles[i].applyForce(push);
+    world.step(0.01);
+    for (std::size_t i = 0; i < initial.size(); ++i)
+    {
+        const Vec2 velocity = particles[i].linearVelocity;
+        if (initial[i].inverseMass == 0.0 ? !near(velocity, initial[i].linearVelocity)
+                                          : !near(velocity, baselineVelocity(initial[i], push, {0.0, -9.8}, 0.3)))
+            return false;
+    }
+
+    // forces applied while accumulation is off are dropped, not saved up
+    world.setForceAccumulation(false);
+    std::vector<Particle2> before = initial;
+    for (std::size_t i = 0; i < initial.size(); ++i)
+    {
+        particles[i].applyForce(push);
+        before[i].linearVelocity = particles[i].linearVelocity;
+    }
+    world.setForceAccumulation(true);
+    world.step(0.01);
+    for (std::size_t i = 0; i < initial.size(); ++i)
+    {
+        if (initial[i].inverseMass != 0.0 &&
+            !near(particles[i].linearVelocity, baselineVelocity(before[i], {}, {0.0, -9.8}, 0.3)))
+            return false;
+    }
+    return true;
+}
+
+template <typename W>
+void setup(W &world)
+{
+    world.setGravity({0.0, -9.8});
+}
+
+int main()
+{
+    std::vector<Particle2> callback = makeParticles(), separate = makeParticles(), fused = makeParticles();
+    std::vector<Particle2> soaParticles = makeParticles();
+    Store2 store(soaParticles);
+
+    mp::World<2, double> callbackWorld, separateWorld, fusedWorld;
+    mp::World<2, double, Store2::range> soaWorld;
+    setup(callbackWorld);
+    setup(separateWorld);
+    setup(fusedWorld);
+    setup(soaWorld);
+    callbackWorld.addParticles({callback});
+    separateWorld.addParticles({separate});
+    fusedWorld.addParticles({fused});
+    soaWorld.addParticles({store});
+
+    const double k = dragCoefficient;
+    auto drag = [k](Particle2 &particle) { return particle.linearVelocity * -k; };
+    callbackWorld.setForceCB(dragAndLift);
+    separateWorld.addForce(drag);
+    mp::Force<mp::contiguous_range<Particle2>> &liftForce = separateWorld.addForce(Lift{lift});
+    fusedWorld.addForce(mp::fuse(drag, Lift{lift}));
+
+    // span force writing straight into the SoA arrays
+    soaWorld.addForce([k](Store2::range &particles, std::size_t begin, std::size_t end) {
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            const double *velocity = particles.linearVelocity(axis);
+            double *force = particles.forceAccumulator(axis);
+            for (std::size_t i = begin; i < end; ++i)
+                force[i] += velocity[i] * -k;
+        }
+    });
+    soaWorld.addForce(Lift{lift});
+
+    for (int i = 0; i < 300; ++i)
+    {
+        callbackWorld.step(0.016);
+        separateWorld.step(0.016);
+        fusedWorld.step(0.016);
+        soaWorld.step(0.016);
+    }
+
+    std::vector<Particle2> fromStore;
+    for (std::size_t i = 0; i < store.size(); ++i)
+        fromStore.push_back(store.get(i));
+    if (!same(callback, separate) || !same(callback, fused) || !same(callback, fromStore))
+    {
+        std::cout << "registered forces differ from the force callback\n";
+        return 1;
+    }
+
+    // removing the lift leaves drag alone
+    separateWorld.removeForce(liftForce);
+    callbackWorld.setForceCB(nullptr);
+    callbackWorld.addForce(drag);
+    for (int i = 0; i < 100; ++i)
+    {
+        callbackWorld.step(0.016);
+        separateWorld.step(0.016);
+    }
+    if (separateWorld.forces.size() != 1 || !same(callback, separate))
+    {
+        std::cout << "removeForce failed\n";
+        return 1;
+    }
+
+    std::vector<Particle2> initial = makeParticles(), aos = makeParticles(), soa = makeParticles();
+    Store2 pushedStore(soa);
+    mp::World<2, double> aosWorld;
+    mp::World<2, double, Store2::range> soaPushedWorld;
+    if (!appliedForceIntegrated(aosWorld, aos, initial) || !appliedForceIntegrated(soaPushedWorld, pushedStore, initial))
+    {
+        std::cout << "applyForce between steps not integrated as before\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "../../src/mp/World.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using Particle2 = mp::Particle<2, double>;
+using World2 = mp::World<2, double>;
+
+// fake clock where every sub-step takes a millisecond
+std::uint32_t now = 0;
+std::uint32_t fakeClock() { return now; }
+void subStepTakesAMillisecond() { now += 1000; }
+
+struct Scene
+{
+    std::vector<Particle2> particles = std::vector<Particle2>(4);
+    World2 world;
+    Scene()
+    {
+        world.addParticles({particles});
+        world.setGravity({0.0, -10.0});
+        world.setDamping(0.0);
+        world.setClock(fakeClock);
+        world.setUserCB(subStepTakesAMillisecond);
+    }
+};
+
+bool near(double a, double b) { return std::fabs(a - b) < 1e-9; }
+
+int fail(const char *msg)
+{
+    std::cout << msg << "\n";
+    return 1;
+}
+
+int main()
+{
+    // ordinary frames run every sub-step
+    Scene normal;
+    normal.world.step(0.035);
+    if (normal.world.status.overloaded || normal.world.status.subSteps != 3 || !near(normal.world.dtAccumulator, 0.005))
+        return fail("normal frame");
+    if (!near(normal.world.status.subStepCost, 0.001))
+        return fail("sub-step cost not measured");
+
+    // a long stall is capped and the time dropped
+    Scene drop;
+    drop.world.setMaxSubSteps(3);
+    drop.world.step(5.0);
+    if (!drop.world.status.overloaded || drop.world.status.subSteps != 3 || drop.world.dtAccumulator >= drop.world.stepSize)
+        return fail("drop time");
+    if (!near(drop.world.status.droppedTime + 0.03 + drop.world.dtAccumulator, 5.0))
+        return fail("dropped time not reported");
+    if (!near(drop.particles[0].linearVelocity.y(), -0.3))
+        return fail("dropped sub-steps were simulated");
+
+    // the measured cost limits sub-steps to the budget
+    Scene budget;
+    budget.world.setStepBudget(0.0035);
+    budget.world.step(0.01);
+    budget.world.step(0.105);
+    if (budget.world.status.subSteps != 3 || budget.world.status.neededSubSteps != 10)
+        return fail("budget");
+
+    // stretching covers all the time with fewer, longer sub-steps
+    Scene stretch;
+    stretch.world.setMaxSubSteps(2);
+    stretch.world.setOverloadPolicy(mp::OverloadPolicy::StretchTime);
+    stretch.world.step(0.065);
+    if (stretch.world.status.subSteps != 2 || !near(stretch.world.status.stretch, 3.0) || !near(stretch.world.status.droppedTime, 0.0))
+        return fail("stretch time");
+    if (!near(stretch.particles[0].linearVelocity.y(), -0.6))
+        return fail("stretched sub-steps lost time");
+
+    // fewer iterations per sub-step fit every sub-step into the budget
+    Scene reduce;
+    reduce.world.iterationCount = 8;
+    reduce.world.setStepBudget(0.0035);
+    reduce.world.setOverloadPolicy(mp::OverloadPolicy::ReduceIterations);
+    reduce.world.step(0.01);
+    reduce.world.step(0.085);
+    if (reduce.world.status.iterations != 2 || reduce.world.status.subSteps != 8 || !near(reduce.world.status.droppedTime, 0.0))
+        return fail("reduce iterations");
+
+    // against maxSubSteps alone cheaper sub-steps do not help, so time is dropped
+    Scene capped;
+    capped.world.iterationCount = 8;
+    capped.world.setMaxSubSteps(4);
+    capped.world.setOverloadPolicy(mp::OverloadPolicy::ReduceIterations);
+    capped.world.step(0.085);
+    if (capped.world.status.iterations != 8 || capped.world.status.subSteps != 4 || !near(capped.world.status.droppedTime, 0.04))
+        return fail("reduce iterations without a budget");
+
+    // status is per World
+    if (normal.world.status.overloaded || normal.world.status.overloadCount != 0 || drop.world.status.overloadCount != 1)
+        return fail("status shared between worlds");
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "../common/cloth.hpp"
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// a rope of ten links hanging from one end
+struct Rope
+{
+    Rope(double compliance, double stepSize) : particles(11)
+    {
+        for (int i = 0; i < 11; ++i)
+            particles[i].position = {0.0, -0.1 * i, 0.0};
+        particles[0].inverseMass = 0.0;
+        links.compliance = compliance;
+        for (std::uint32_t i = 0; i < 10; ++i)
+            links.add(particles, i, i + 1);
+        world.addParticles({particles});
+        world.addConstraints(links);
+        world.setGravity({0.0, -9.8, 0.0});
+        world.setDamping(5.0);
+        world.setSolverMode(mp::SolverMode::Implicit);
+        world.stepSize = stepSize;
+    }
+
+    double length() const
+    {
+        double total = 0.0;
+        for (int i = 0; i < 10; ++i)
+            total += (particles[i].position - particles[i + 1].position).length();
+        return total;
+    }
+
+    std::vector<Particle3> particles;
+    mp::IndexedDistanceSet<3, double> links;
+    mp::World<3, double> world;
+};
+
+// A spring of stiffness 1e6 on a unit mass has a period of about 6 ms. Steps
+// of 20 ms stay stable and settle where the weight below each link balances
+// its spring.
+bool stiffRope()
+{
+    Rope rope(1e-6, 0.02);
+    for (int s = 0; s < 300; ++s)
+        rope.world.step(0.01);
+    const double stretch = rope.length() - 1.0;
+    // unit masses: 10 + 9 + ... + 1 below the links
+    const double expected = 1e-6 * 9.8 * 55.0;
+    std::cout << "stretch " << stretch << " of " << expected << " after " << rope.world.implicit.lastIterations()
+              << " conjugate gradient iterations\n";
+    return std::abs(stretch - expected) < 0.02 * expected && rope.world.implicit.lastIterations() > 0
+        && rope.world.implicit.lastIterations() < rope.world.implicit.maxIterations;
+}
+
+// the pattern is built once and again only when the constraints change
+bool reusesStructure()
+{
+    Rope rope(1e-4, 0.01);
+    for (int s = 0; s < 50; ++s)
+        rope.world.step(0.01);
+    if (rope.world.implicit.builds() != 1)
+        return false;
+    rope.links.add(rope.particles, 0, 2);
+    for (int s = 0; s < 50; ++s)
+        rope.world.step(0.01);
+    return rope.world.implicit.builds() == 2;
+}
+
+// sets with compliance 0 are still solved by the iterative solver
+bool rigidSetsIterate()
+{
+    Rope rope(0.0, 0.01);
+    rope.world.iterationCount = 20;
+    for (int s = 0; s < 100; ++s)
+        rope.world.step(0.01);
+    return rope.world.implicit.builds() == 1 && std::abs(rope.length() - 1.0) < 0.01;
+}
+
+// a cloth of stiff springs stepped 20 ms at a time
+struct SpringCloth : Cloth
+{
+    SpringCloth() : Cloth(Kind::Indexed, 20, 20, 1e-5)
+    {
+        world.setSolverMode(mp::SolverMode::Implicit);
+        world.stepSize = 0.02;
+    }
+};
+
+// the result does not depend on the executor
+bool sameAcrossThreads(mp::Executor *executor)
+{
+    SpringCloth serial, threaded;
+    threaded.world.setExecutor(executor);
+    threaded.world.setGrainSize(16);
+    for (int s = 0; s < 50; ++s)
+    {
+        serial.world.step(0.02);
+        threaded.world.step(0.02);
+    }
+    for (std::size_t i = 0; i < serial.particles.size(); ++i)
+    {
+        const mp::Vec<3, double> a = serial.particles[i].position, b = threaded.particles[i].position;
+        if (std::memcmp(&a, &b, sizeof(a)) != 0 || !(std::abs(a.z()) < 1e-9))
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!stiffRope())
+    {
+        std::cout << "stiff rope did not settle with long steps\n";
+        return 1;
+    }
+    if (!reusesStructure() || !rigidSetsIterate())
+    {
+        std::cout << "implicit structure not reused\n";
+        return 1;
+    }
+    mp::ThreadPool pool(4);
+    if (!sameAcrossThreads(&pool))
+    {
+        std::cout << "implicit result depends on the executor\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
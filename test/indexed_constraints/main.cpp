@@ -0,0 +1,126 @@
+#include "../../src/mp/World.hpp"
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <iostream>
+#include <vector>
+
+using Vec3 = mp::Vec<3, double>;
+using Particle3 = mp::Particle<3, double>;
+using Store3 = mp::ParticleStore<3, double>;
+using Distance3 = mp::DistanceConstraint<3, double>;
+
+const int width = 30, height = 20;
+
+std::vector<Particle3> makeGrid()
+{
+    std::vector<Particle3> particles(width * height);
+    for (int i = 0; i < width * height; ++i)
+    {
+        particles[i].position = {static_cast<double>(i % width), static_cast<double>(i / width), 0.0};
+        if (i < width)
+            particles[i].inverseMass = 0.0;
+    }
+    return particles;
+}
+
+template <typename F>
+void forEachJoin(F f)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int i = x + y * width;
+            if (x < width - 1)
+                f(i, i + 1);
+            if (y < height - 1)
+                f(i, i + width);
+        }
+    }
+}
+
+bool samePositions(const std::vector<Particle3> &a, const std::vector<Particle3> &b)
+{
+    for (std::size_t i = 0; i < a.size(); ++i)
+        for (int axis = 0; axis < 3; ++axis)
+            if (a[i].position[axis] != b[i].position[axis])
+                return false;
+    return true;
+}
+
+int main()
+{
+    static_assert(sizeof(mp::IndexedDistanceConstraint<double>) * 2 < sizeof(Distance3), "indexed constraints should be compact");
+    static_assert(sizeof(mp::IndexedDistanceConstraint<double>) == 16, "cached impulses belong in the set, not the constraint");
+
+    // reference based constraints
+    std::vector<Particle3> reference = makeGrid();
+    std::vector<Distance3> joins;
+    forEachJoin([&](int a, int b) { joins.emplace_back(reference[a], reference[b]); });
+    std::vector<std::reference_wrapper<mp::Constraint<3, double>>> refs(joins.begin(), joins.end());
+    mp::World<3, double> referenceWorld;
+    referenceWorld.addParticles({reference});
+    referenceWorld.addConstraints({refs});
+    referenceWorld.setGravity({0.0, -9.8, 0.0});
+
+    // the same constraints by index over Particle structs
+    std::vector<Particle3> indexed = makeGrid();
+    mp::IndexedDistanceSet<3, double> aosSet;
+    mp::contiguous_range<Particle3> indexedRange(indexed);
+    forEachJoin([&](int a, int b) { aosSet.add(indexedRange, a, b); });
+    mp::World<3, double> indexedWorld;
+    indexedWorld.addParticles(indexedRange);
+    indexedWorld.addConstraints(aosSet);
+    indexedWorld.setGravity({0.0, -9.8, 0.0});
+
+    // and by index over SoA storage
+    std::vector<Particle3> grid = makeGrid();
+    Store3 store(grid);
+    Store3::range storeRange(store);
+    mp::IndexedDistanceSet<3, double> soaSet;
+    forEachJoin([&](int a, int b) { soaSet.add(storeRange, a, b); });
+    mp::World<3, double, Store3::range> soaWorld;
+    soaWorld.addParticles(storeRange);
+    soaWorld.addConstraints(soaSet);
+    soaWorld.setGravity({0.0, -9.8, 0.0});
+
+    for (int i = 0; i < 100; ++i)
+    {
+        referenceWorld.step(0.016);
+        indexedWorld.step(0.016);
+        soaWorld.step(0.016);
+    }
+
+    std::vector<Particle3> soa;
+    for (std::size_t i = 0; i < store.size(); ++i)
+        soa.push_back(store.get(i));
+    if (!samePositions(reference, indexed) || !samePositions(reference, soa))
+    {
+        std::cout << "indexed constraints differ from reference constraints\n";
+        return 1;
+    }
+
+    // coloured and threaded over SoA against coloured and serial over Particle structs
+    mp::ThreadPool pool(4);
+    soaWorld.setSolverMode(mp::SolverMode::Coloured);
+    soaWorld.setExecutor(&pool);
+    soaWorld.setGrainSize(16);
+    indexedWorld.setSolverMode(mp::SolverMode::Coloured);
+    indexedWorld.setExecutor(&pool);
+    indexedWorld.setGrainSize(1 << 20);
+    for (int i = 0; i < 100; ++i)
+    {
+        indexedWorld.step(0.016);
+        soaWorld.step(0.016);
+    }
+    soa.clear();
+    for (std::size_t i = 0; i < store.size(); ++i)
+        soa.push_back(store.get(i));
+    if (!samePositions(indexed, soa))
+    {
+        std::cout << "threaded indexed solve differs\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "../../src/mp/World.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using Vec2 = mp::Vec<2, double>;
+using Particle2 = mp::Particle<2, double>;
+using Store2 = mp::ParticleStore<2, double>;
+
+bool near(const Vec2 &a, const Vec2 &b) { return std::fabs(a.x() - b.x()) < 1e-12 && std::fabs(a.y() - b.y()) < 1e-12; }
+
+int main()
+{
+    std::vector<Particle2> particles(3);
+    for (std::size_t i = 0; i < particles.size(); ++i)
+        particles[i].linearVelocity = {1.0, static_cast<double>(i)};
+    std::vector<Particle2> initial = particles;
+    Store2 store(initial);
+
+    mp::World<2, double> world;
+    world.addParticles({particles});
+    world.setGravity({0.0, -10.0});
+    world.setInterpolation(true);
+    mp::World<2, double, Store2::range> soa;
+    soa.addParticles({store});
+    soa.setGravity({0.0, -10.0});
+    soa.setInterpolation(true);
+
+    // before any sub-step the interpolated position is the current one
+    if (!near(world.interpolatedPosition(1), particles[1].position))
+    {
+        std::cout << "initial interpolation\n";
+        return 1;
+    }
+
+    world.step(0.025);
+    soa.step(0.025);
+    const std::vector<Particle2> afterTwo = particles;
+    world.step(0.01);
+    soa.step(0.01);
+
+    // three sub-steps have run with half of one left in the accumulator
+    if (std::fabs(world.alpha() - 0.5) > 1e-9)
+    {
+        std::cout << "alpha " << world.alpha() << "\n";
+        return 1;
+    }
+    std::vector<Vec2> rendered(particles.size());
+    world.copyInterpolatedPositions({rendered});
+    for (std::size_t i = 0; i < particles.size(); ++i)
+    {
+        const Vec2 expected = afterTwo[i].position + (particles[i].position - afterTwo[i].position) * world.alpha();
+        if (!near(world.interpolatedPosition(i), expected) || !near(rendered[i], expected) || !near(soa.interpolatedPosition(i), expected))
+        {
+            std::cout << "interpolated position " << i << "\n";
+            return 1;
+        }
+    }
+
+    // switched off, the current positions come back
+    world.setInterpolation(false);
+    if (!near(world.interpolatedPosition(2), particles[2].position))
+    {
+        std::cout << "interpolation not disabled\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
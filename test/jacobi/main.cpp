@@ -0,0 +1,106 @@
+#include "../common/cloth.hpp"
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using Store3 = mp::ParticleStore<3, double>;
+
+// indexed joins solved in the given mode
+struct SolvedCloth : Cloth
+{
+    SolvedCloth(mp::SolverMode mode, int iterations) : Cloth(Kind::Indexed)
+    {
+        world.setSolverMode(mode);
+        world.iterationCount = iterations;
+    }
+};
+
+// Jacobi holds the cloth, less tightly per pass than Gauss-Seidel
+bool holds()
+{
+    SolvedCloth gaussSeidel(mp::SolverMode::GaussSeidel, 10), jacobi(mp::SolverMode::Jacobi, 10);
+    SolvedCloth relaxed(mp::SolverMode::Jacobi, 10);
+    relaxed.world.jacobi.averaging = false;
+    relaxed.world.jacobi.relaxation = 0.25;
+    for (SolvedCloth *cloth : {&gaussSeidel, &jacobi, &relaxed})
+        cloth->run(300);
+    std::cout << "stretch after 10 passes, Gauss-Seidel " << gaussSeidel.stretch() << ", Jacobi " << jacobi.stretch()
+              << ", relaxed " << relaxed.stretch() << "\n";
+    return jacobi.stretch() < 0.1 && relaxed.stretch() < 0.1 && gaussSeidel.stretch() < jacobi.stretch();
+}
+
+// the result does not depend on the executor or how the work is split
+bool sameAcrossThreads(mp::Executor *executor)
+{
+    SolvedCloth serial(mp::SolverMode::Jacobi, 8), threaded(mp::SolverMode::Jacobi, 8);
+    threaded.world.setExecutor(executor);
+    threaded.world.setGrainSize(16);
+    for (SolvedCloth *cloth : {&serial, &threaded})
+    {
+        cloth->world.setWarmStarting(0.5);
+        cloth->run(100);
+    }
+    return serial.samePositions(threaded.particles.data()) && serial.stretch() < 0.1;
+}
+
+// ParticleStore arrays give the same result as Particle structs
+bool sameOverStore()
+{
+    SolvedCloth aos(mp::SolverMode::Jacobi, 8);
+    std::vector<Particle3> start = clothParticles(20, 20);
+    Store3 store(start);
+    mp::IndexedDistanceSet<3, double> joins;
+    forEachJoin(20, 20, [&](int i, int j) { joins.add(start, i, j); });
+    mp::World<3, double, Store3::range> soa;
+    soa.addParticles({store});
+    soa.addConstraints(joins);
+    soa.setGravity({0.0, -9.8, 0.0});
+    soa.setSolverMode(mp::SolverMode::Jacobi);
+    soa.iterationCount = 8;
+    for (int s = 0; s < 100; ++s)
+    {
+        aos.world.step(0.01);
+        soa.step(0.01);
+    }
+    for (std::size_t i = 0; i < aos.particles.size(); ++i)
+    {
+        const Particle3 q = store.get(i);
+        if (std::memcmp(&q.position, &aos.particles[i].position, sizeof(q.position)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// each pass leaves less to correct
+bool residualFalls()
+{
+    SolvedCloth cloth(mp::SolverMode::Jacobi, 10);
+    cloth.run(20);
+    cloth.world.setResidualTracking(true);
+    cloth.run(1);
+    const std::vector<mp::SolverResidual<double>> &history = cloth.world.residualHistory();
+    return history.size() == 10 && history[0].count == cloth.joins.size() && history.back().rms() < history[0].rms();
+}
+
+int main()
+{
+    mp::ThreadPool pool(4);
+    if (!holds())
+    {
+        std::cout << "Jacobi did not hold the cloth\n";
+        return 1;
+    }
+    if (!sameAcrossThreads(&pool) || !sameOverStore())
+    {
+        std::cout << "Jacobi result depends on threads or storage\n";
+        return 1;
+    }
+    if (!residualFalls())
+    {
+        std::cout << "Jacobi passes did not converge\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,116 @@
+#define MP_USE_PROFILE
+#include "../../src/mp/World.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using Vec2 = mp::Vec<2, float>;
+using Particle2 = mp::Particle<2, float>;
+
+int userCalls = 0;
+void user() { ++userCalls; }
+Vec2 wind(Particle2 &) { return {1.0f, 0.0f}; }
+void floor(Particle2 &p)
+{
+    if (p.position.y() < -1.0f)
+        p.position.y() = -1.0f;
+}
+
+std::size_t occurrences(const std::string &text, const std::string &pattern)
+{
+    std::size_t count = 0;
+    for (std::size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+        ++count;
+    return count;
+}
+
+int main()
+{
+    constexpr int n = 20;
+    std::vector<Particle2> particles(n);
+    mp::IndexedDistanceSet<2, float> chain;
+    for (int i = 0; i < n; ++i)
+        particles[i].position = {0.1f * i, 0.0f};
+    particles[0].inverseMass = 0.0f;
+    for (int i = 0; i + 1 < n; ++i)
+        chain.add(particles, i, i + 1);
+
+    mp::World<2, float> world;
+    world.addParticles({particles});
+    world.addConstraints(chain);
+    world.setGravity({0.0f, -9.8f});
+    world.setForceCB(wind);
+    world.setUserCB(user);
+    world.setPositionCB(floor);
+    world.iterationCount = 3;
+    world.profiler.enableTrace(1000);
+
+    long subSteps = 0, iterations = 0;
+    for (int s = 0; s < 50; ++s)
+    {
+        world.step(0.025f);
+        subSteps += world.status.subSteps;
+        iterations += world.status.subSteps * world.status.iterations;
+    }
+
+    const mp::Profiler &profiler = world.profiler;
+    using mp::ProfilePhase;
+    using mp::ProfileCounter;
+    const bool counted = profiler.count(ProfileCounter::Steps) == 50
+        && static_cast<long>(profiler.count(ProfileCounter::SubSteps)) == subSteps
+        && static_cast<long>(profiler.count(ProfileCounter::Iterations)) == iterations
+        && static_cast<long>(profiler.phase(ProfilePhase::SubStep).calls) == subSteps
+        && static_cast<long>(profiler.phase(ProfilePhase::Iteration).calls) == iterations
+        && static_cast<long>(profiler.phase(ProfilePhase::UserCallback).calls) == subSteps
+        && userCalls == subSteps
+        // the force callback sees the pinned particle too
+        && static_cast<long>(profiler.phase(ProfilePhase::ForceCallback).calls) == subSteps * n
+        && static_cast<long>(profiler.phase(ProfilePhase::PositionHandler).calls) == subSteps * n
+        && profiler.phase(ProfilePhase::Snapshot).calls == 0;
+    if (!counted || subSteps < 100)
+    {
+        std::cout << "phase counts wrong\n";
+        return 1;
+    }
+
+    // nested phases take no longer than what contains them
+    const bool nested = profiler.phase(ProfilePhase::SubStep).nanoseconds <= profiler.phase(ProfilePhase::Step).nanoseconds
+        && profiler.phase(ProfilePhase::Iteration).nanoseconds <= profiler.phase(ProfilePhase::Constraints).nanoseconds
+        && profiler.phase(ProfilePhase::ForceCallback).nanoseconds <= profiler.phase(ProfilePhase::Forces).nanoseconds
+        && profiler.phase(ProfilePhase::PositionHandler).nanoseconds <= profiler.phase(ProfilePhase::Integrate).nanoseconds
+        && profiler.phase(ProfilePhase::Constraints).nanoseconds > 0;
+    if (!nested)
+    {
+        std::cout << "phase times wrong\n";
+        return 1;
+    }
+
+    // every scoped phase and counter update is traced until the trace is full
+    const std::size_t scoped = 50 + 5 * subSteps + iterations;
+    if (profiler.traceSize() + profiler.traceDropped() != scoped + 3 * 50 || profiler.traceSize() != 1000)
+    {
+        std::cout << "trace size wrong " << profiler.traceSize() << "\n";
+        return 1;
+    }
+    mp::VectorSink sink;
+    if (!profiler.writeChromeTrace(sink))
+        return 1;
+    const std::string json(sink.bytes.begin(), sink.bytes.end());
+    if (json.compare(0, 16, "{\"traceEvents\":[") != 0 || occurrences(json, "\"ph\":") != 1000
+        || occurrences(json, "\"name\":\"iteration\"") == 0 || json.find("]") == std::string::npos)
+    {
+        std::cout << "trace export wrong\n";
+        return 1;
+    }
+
+    world.profiler.reset();
+    if (world.profiler.count(ProfileCounter::Steps) != 0 || world.profiler.phase(ProfilePhase::Step).calls != 0
+        || world.profiler.traceSize() != 0)
+    {
+        std::cout << "reset failed\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "../../src/mp/replay/replay.hpp"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using Particle2 = mp::Particle<2, double>;
+using World2 = mp::World<2, double>;
+
+constexpr int nParticles = 40;
+
+// a rope hanging from its first particle, with sleeping so impulses must wake it
+struct Scene
+{
+    Scene()
+    {
+        for (int i = 0; i < nParticles; ++i)
+            particles[i].position = {0.05 * i, 0.0};
+        particles[0].inverseMass = 0.0;
+        for (int i = 0; i + 1 < nParticles; ++i)
+            rope.add(particles, i, i + 1);
+        world.addParticles({particles});
+        world.addConstraints(rope);
+        world.setGravity({0.0, -9.8});
+        world.setDamping(2.0);
+        world.setSleeping(true);
+        world.setSleepWindow(10);
+    }
+
+    std::vector<Particle2> particles = std::vector<Particle2>(nParticles);
+    mp::IndexedDistanceSet<2, double> rope;
+    World2 world;
+};
+
+// wall time between frames, jittered as a real loop would be
+double frameTime(std::uint32_t &seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return 0.008 + 0.012 * static_cast<double>(seed >> 8) / static_cast<double>(1u << 24);
+}
+
+bool samePositions(const std::vector<Particle2> &a, const std::vector<Particle2> &b)
+{
+    for (std::size_t i = 0; i < a.size(); ++i)
+        if (std::memcmp(&a[i].position, &b[i].position, sizeof(a[i].position)) != 0 ||
+            std::memcmp(&a[i].linearVelocity, &b[i].linearVelocity, sizeof(a[i].linearVelocity)) != 0)
+            return false;
+    return true;
+}
+
+int main()
+{
+    const int nSteps = 400;
+    std::vector<std::uint8_t> log;
+    Scene recorded;
+    {
+        mp::InputRecorder<2, double> recorder(recorded.world, log);
+        std::uint32_t seed = 1;
+        for (int s = 0; s < nSteps; ++s)
+        {
+            if (s % 37 == 5)
+                recorder.applyImpulse(nParticles - 1, {0.3, 0.1 * (s % 3)});
+            if (s == 100)
+                recorder.setGravity({1.0, -9.8});
+            if (s == 150)
+                recorder.setDamping(1.0);
+            if (s == 200)
+                recorder.setIterationCount(3);
+            if (s == 250)
+                recorder.setTimeStretch(0.5);
+            recorder.step(frameTime(seed));
+        }
+    }
+    std::cout << "log " << log.size() << " bytes for " << nSteps << " steps\n";
+    if (log.size() > 20 + nSteps * 4 + 11 * 40)
+    {
+        std::cout << "log too large\n";
+        return 1;
+    }
+
+    // replaying from the same start gives the same run, bit for bit
+    Scene replayed;
+    mp::InputReplayer<2, double> replayer(replayed.world, log.data(), log.size());
+    if (!replayer.valid())
+    {
+        std::cout << "log header rejected\n";
+        return 1;
+    }
+    replayer.run();
+    if (replayer.steps() != nSteps || replayer.diverged() || replayer.failed())
+    {
+        std::cout << "replay steps " << replayer.steps() << " diverged " << replayer.diverged() << "\n";
+        return 1;
+    }
+    if (!samePositions(recorded.particles, replayed.particles))
+    {
+        std::cout << "replay differs from the recorded run\n";
+        return 1;
+    }
+
+    // whole ticks make the sub-steps independent of how the time was split
+    Scene a, b;
+    a.world.setTickRate(1000);
+    b.world.setTickRate(1000);
+    for (int s = 0; s < 100; ++s)
+        a.world.stepTicks(30);
+    for (int s = 0; s < 300; ++s)
+        b.world.stepTicks(10);
+    if (!samePositions(a.particles, b.particles))
+    {
+        std::cout << "tick split changed the trajectory\n";
+        return 1;
+    }
+
+    // a stall longer than the tick counter holds is clamped, not carried over
+    Scene stall;
+    stall.world.setTickRate(1000);
+    stall.world.setMaxSubSteps(3);
+    stall.world.step(1e12);
+    const int stalled = stall.world.status.subSteps;
+    stall.world.step(0.02);
+    if (stalled != 3 || stall.world.status.subSteps != 2)
+    {
+        std::cout << "long stall overflowed the tick count\n";
+        return 1;
+    }
+
+    // a log for another World is refused
+    std::vector<Particle2> other(nParticles + 1);
+    World2 otherWorld;
+    otherWorld.addParticles({other});
+    mp::InputReplayer<2, double> wrong(otherWorld, log.data(), log.size());
+    mp::InputReplayer<2, double> truncated(replayed.world, log.data(), 10);
+    if (wrong.valid() || truncated.valid() || wrong.next())
+    {
+        std::cout << "bad log accepted\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
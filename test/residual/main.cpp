@@ -0,0 +1,149 @@
+#include "../common/cloth.hpp"
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <iostream>
+#include <vector>
+
+// ten passes a sub-step, counting what runs
+struct MeasuredCloth : Cloth
+{
+    explicit MeasuredCloth(Kind kind) : Cloth(kind, 20, 12) { world.iterationCount = 10; }
+
+    // sub-steps and constraint passes run over steps of 10 ms
+    void run(int steps, long &subSteps, long &passes)
+    {
+        subSteps = passes = 0;
+        for (int s = 0; s < steps; ++s)
+        {
+            world.step(0.01);
+            subSteps += world.status.subSteps;
+            passes += world.status.iterationsRun;
+        }
+    }
+
+    double distance(const Cloth &other) const
+    {
+        double worst = 0.0;
+        for (std::size_t i = 0; i < particles.size(); ++i)
+        {
+            const double d = (particles[i].position - other.particles[i].position).length();
+            // NaN is never near
+            worst = d < worst ? worst : d;
+        }
+        return worst;
+    }
+};
+
+// every path reports the same error for every constraint of every pass
+bool sameResiduals()
+{
+    MeasuredCloth range(Kind::Range), typed(Kind::Typed), indexed(Kind::Indexed);
+    MeasuredCloth *cloths[] = {&range, &typed, &indexed};
+    for (MeasuredCloth *cloth : cloths)
+    {
+        cloth->world.setResidualTracking(true);
+        cloth->world.step(0.01);
+    }
+    const std::vector<mp::SolverResidual<double>> &history = range.world.residualHistory();
+    if (history.size() != 10 || history[0].count != range.joins.size() || !(history.back().max < history[0].max))
+        return false;
+    // the typed set solves colour by colour, so only the counts match exactly
+    const std::vector<mp::SolverResidual<double>> &typedHistory = typed.world.residualHistory();
+    const std::vector<mp::SolverResidual<double>> &indexedHistory = indexed.world.residualHistory();
+    if (typedHistory.size() != 10 || typedHistory[0].count != range.joins.size())
+        return false;
+    for (std::size_t i = 0; i < history.size(); ++i)
+        if (indexedHistory[i].max != history[i].max || indexedHistory[i].rms() != history[i].rms())
+            return false;
+    return true;
+}
+
+// the SIMD batch kernels report the scalar solve's errors
+bool batchResiduals()
+{
+    std::vector<double> maxima;
+    for (mp::simd::Isa isa : {mp::simd::Isa::Scalar, mp::simd::Isa::SSE4, mp::simd::Isa::AVX2})
+    {
+        mp::simd::setMaxIsa(isa);
+        MeasuredCloth cloth(Kind::Typed);
+        cloth.world.setResidualTracking(true);
+        cloth.world.step(0.01);
+        for (const mp::SolverResidual<double> &r : cloth.world.residualHistory())
+            maxima.push_back(r.max);
+    }
+    mp::simd::setMaxIsa(mp::simd::Isa::AVX2);
+    for (std::size_t i = 0; i < 10; ++i)
+        if (maxima[i] != maxima[i + 10] || maxima[i] != maxima[i + 20])
+            return false;
+    return true;
+}
+
+// kick the bottom row out of a cloth with no gravity and heavy damping
+void flick(Cloth &cloth)
+{
+    cloth.world.setGravity({0.0, 0.0, 0.0});
+    cloth.world.setDamping(2.0);
+    for (std::size_t i = cloth.particles.size() - 20; i < cloth.particles.size(); ++i)
+        cloth.particles[i].linearVelocity = {0.0, 0.0, 2.0};
+}
+
+// as a flick of the cloth dies away the tolerance cuts most passes and barely
+// moves the result
+bool stopsEarly(Kind kind, mp::Executor *executor)
+{
+    MeasuredCloth full(kind), adaptive(kind);
+    for (MeasuredCloth *cloth : {&full, &adaptive})
+    {
+        flick(*cloth);
+        if (executor != nullptr)
+        {
+            cloth->world.setExecutor(executor);
+            cloth->world.setGrainSize(16);
+            cloth->world.setSolverMode(mp::SolverMode::Coloured);
+        }
+    }
+    adaptive.world.setSolverTolerance(1e-3);
+    long subSteps, fullPasses, adaptivePasses;
+    full.run(500, subSteps, fullPasses);
+    adaptive.run(500, subSteps, adaptivePasses);
+    const double gap = full.distance(adaptive);
+    std::cout << "passes " << adaptivePasses << " of " << fullPasses << ", " << gap << " apart\n";
+    return fullPasses == subSteps * 10 && adaptivePasses * 2 < fullPasses && gap < 0.05
+        && adaptive.world.residualHistory().size() == static_cast<std::size_t>(adaptive.world.status.iterationsRun)
+        && adaptive.world.residualHistory().back().max <= 1e-3;
+}
+
+// in Islands mode each island stops on its own
+bool islandsStopEarly()
+{
+    MeasuredCloth cloth(Kind::Indexed);
+    cloth.world.setSolverMode(mp::SolverMode::Islands);
+    flick(cloth);
+    long subSteps, passes;
+    cloth.run(300, subSteps, passes);
+    return cloth.world.islands.size() == 1
+        && cloth.world.islands.solve(0, cloth.world.particles, 0.01, 10, 1e-2) < 10
+        && cloth.world.islands.solve(0, cloth.world.particles, 0.01, 10) == 10;
+}
+
+int main()
+{
+    if (!sameResiduals() || !batchResiduals())
+    {
+        std::cout << "residuals differ between solve paths\n";
+        return 1;
+    }
+    mp::ThreadPool pool(4);
+    if (!stopsEarly(Kind::Range, nullptr) || !stopsEarly(Kind::Indexed, nullptr) || !stopsEarly(Kind::Typed, &pool)
+        || !stopsEarly(Kind::Range, &pool))
+    {
+        std::cout << "tolerance did not stop the solver early\n";
+        return 1;
+    }
+    if (!islandsStopEarly())
+    {
+        std::cout << "islands did not stop early\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -41,7 +41,10 @@ int main(int argc, char * argv[]){
     
 
     mp::World<3, double> world;
-    std::vector<mp::DistanceConstraint<3, double>> joins;
+    using Join = mp::DistanceConstraint<3, double>;
+    mp::ConstraintSet<Join> joins;
+    // polygons draw from interpolated copies of the particle positions
+    std::vector<Vec3> renderPositions(particles.size());
     std::vector<mp::Triangle<3, double>> polygons;
     for (int y = 0; y < gridDim.y(); ++y)
     {
@@ -63,27 +66,33 @@ int main(int argc, char * argv[]){
             bool lastCol = x == gridDim.x() - 1;
 
             if (!firstRow)
-                joins.emplace_back(p0, p1);
+                joins.emplace<Join>(p0, p1);
             
             if (!lastRow)
-                joins.emplace_back(p0, p2);
+                joins.emplace<Join>(p0, p2);
 
             if (!lastCol)
-                joins.emplace_back(p0, p1);
+                joins.emplace<Join>(p0, p1);
             
             if (!lastRow && !lastCol)
             {
-                polygons.emplace_back(p0.position, p1.position, p2.position);
-                polygons.emplace_back(p1.position, p3.position, p2.position);
+                Vec3 &v0 = renderPositions[indexTopLeft];
+                Vec3 &v1 = renderPositions[indexTopRight];
+                Vec3 &v2 = renderPositions[indexBottomLeft];
+                Vec3 &v3 = renderPositions[indexBottomRight];
+                polygons.emplace_back(v0, v1, v2);
+                polygons.emplace_back(v1, v3, v2);
             }
         }
     }
 
     world.addParticles({particles}); 
-    std::vector<std::reference_wrapper<mp::Constraint<3, double>>> join_refs(joins.begin(), joins.end());
-    world.addConstraints({join_refs});
+    world.addConstraints(joins);
     
     world.setGravity({0, -13, 0}); 
+    // a coarse step stays smooth on screen with interpolation
+    world.stepSize = 0.02;
+    world.setInterpolation(true);
 
     SDL_Event sdl_event;
     int i = 10;
@@ -139,10 +148,11 @@ int main(int argc, char * argv[]){
         auto step_duration = std::chrono::high_resolution_clock::now() - start;
         // std::cout << "step_duration: " << std::chrono::duration_cast<std::chrono::microseconds>(step_duration).count() << "\n";
         
+        world.copyInterpolatedPositions({renderPositions});
         renderer.clear();
        for (mp::Triangle<3, double> &polygon : polygons)
             renderer.drawPolygon(polygon);
-//        for (DistanceConstraint<3, double> &join : joins)
+//        for (Join &join : joins.get<Join>())
 //            renderer.drawConstraint(join);
 //        for (auto &row : particleRows)
 //            for (Particle3 &particle : row)
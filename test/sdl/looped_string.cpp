@@ -76,40 +76,7 @@ public:
 
 };
 
-class WrappedDistanceConstraint : public Constraint<2, double>
-{
-    using Particle_t = Particle<2, double>;
-    using Vec_t = Vec<2, double>;
-public:
-    WrappedDistanceConstraint(Particle_t &p1, Particle_t &p2) 
-        : Constraint<2, double>(p1, p2), wrap(1.0), length((wrappedDistance(this->p1.position, this->p2.position)).length()) 
-    {
-    }
-    void solve(double dt) override
-    {
-        double constraintMass = this->p1.inverseMass + this->p2.inverseMass;
-        if (constraintMass <= 0)
-            return;
-
-        Vec<2, double> relativePosition = wrappedDistance(this->p1.position, this->p2.position);
-        double distance = relativePosition.length();
-        double offset = length - distance;
-        offset *= strength;
-        Vec<2, double> offsetDir = relativePosition.normalised();
-        Vec<2, double> relativeVelocity = this->p1.linearVelocity - this->p2.linearVelocity;
-        double velocityDot = Vec<2, double>::dot(relativeVelocity, offsetDir);
-        double bias = -(biasFactor / dt) * offset;
-        double lambda = -(velocityDot + bias) / constraintMass;
-        
-        this->p1.applyImpulse(offsetDir * lambda);
-        this->p2.applyImpulse(-offsetDir * lambda);
-    }
-    mp::wrapped_distance<double> wrap;
-    bool log = false;
-    double length;
-    double strength = 1.0;
-    double biasFactor = 0.6;
-};
+using WrappedDistance_t = WrappedDistanceConstraint<2, double>;
 
 void handleEdge(Particle_t &particle)
 {
@@ -131,18 +98,12 @@ void handleEdge(Particle_t &particle)
 std::vector<Particle_t> particles;
 
     mp::World<2, double> world;
-LogisticMedium medium(-1.0, 1.0, 2.0, 0.0, 0.5, world.gravity);
-
-Vec_t applyForces(Particle_t &particle)
-{
-    return medium.calculateForce(particle);
-}
 
 int main()
 {
     int width = 1500;
     int height = 400;
-    world.setForceCB(applyForces);
+    world.addForce(LogisticMedium(-1.0, 1.0, 2.0, 0.0, 0.5, world.gravity));
     
     Vec_t physMin = {0.0, -0.03};
     Vec_t physMax = {1.0, 0.03};
@@ -156,10 +117,10 @@ int main()
         particles.push_back(p);
     }
     
-    std::vector<WrappedDistanceConstraint> constraints;
+    std::vector<WrappedDistance_t> constraints;
     for (int i = 0; i < particles.size(); ++i)
     {
-        WrappedDistanceConstraint d(particles[i], particles[(i + 1) % particles.size()]);
+        WrappedDistance_t d(particles[i], particles[(i + 1) % particles.size()], {1.0, 0.0}, 1.0, 0.6);
         constraints.push_back(d);
     }
     
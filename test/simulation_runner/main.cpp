@@ -0,0 +1,96 @@
+#include "../../src/mp/parallel/simulation_runner.hpp"
+#include <iostream>
+#include <vector>
+
+using Particle2 = mp::Particle<2, double>;
+using Runner2 = mp::SimulationRunner<2, double>;
+
+// sink attached before the runner, e.g. a trajectory recorder
+struct CountingSink : mp::SnapshotSink<2, double>
+{
+    mp::Snapshot<2, double> buffer;
+    int published = 0;
+    std::uint64_t lastFrame = 0;
+    mp::Snapshot<2, double> &writeBuffer() override { return buffer; }
+    void publish() override
+    {
+        ++published;
+        lastFrame = buffer.frame;
+    }
+};
+
+int fail(const char *msg)
+{
+    std::cout << msg << "\n";
+    return 1;
+}
+
+int main()
+{
+    std::vector<Particle2> particles(8);
+    mp::World<2, double> world;
+    world.addParticles({particles});
+    world.setGravity({0.0, -10.0});
+    CountingSink recorder;
+    world.setSnapshotSink(&recorder);
+    // frames 0 and 1 before the runner is attached
+    world.step(0.0105);
+    world.step(0.0105);
+
+    {
+        Runner2 runner(world, 4);
+
+        // on request steps, each returning the status of its step
+        std::vector<std::future<mp::StepStatus<double>>> steps;
+        for (int i = 0; i < 10; ++i)
+            steps.push_back(runner.stepAsync(0.0105));
+        for (std::future<mp::StepStatus<double>> &step : steps)
+            if (step.get().subSteps != 1)
+                return fail("stepAsync status");
+
+        // nobody read frames, so only the newest four are kept
+        mp::Snapshot<2, double> frame;
+        std::uint64_t expected = 8;
+        while (runner.tryPopFrame(frame))
+        {
+            if (frame.frame != expected++ || frame.positions.size() != particles.size())
+                return fail("queued frames");
+        }
+        if (expected != 12 || runner.droppedFrames() != 6)
+            return fail("frame queue did not drop the oldest");
+        // the sink attached before the runner sees every frame, none dropped,
+        // numbered on from the frames before
+        if (recorder.published != 12 || recorder.lastFrame != 11 || recorder.buffer.positions.size() != particles.size())
+            return fail("earlier sink not chained");
+
+        // changes go through the runner's thread
+        runner.post([](mp::World<2, double> &w) { w.particles[0].applyImpulse({5.0, 0.0}); }).get();
+
+        // fixed rate stepping keeps producing frames until stopped
+        runner.start(500.0);
+        std::uint64_t last = frame.frame;
+        for (int i = 0; i < 5; ++i)
+        {
+            if (!runner.waitFrame(frame, std::chrono::seconds(2)) || frame.frame <= last)
+                return fail("fixed rate frames");
+            last = frame.frame;
+        }
+        runner.stop();
+        if (frame.positions[0].x() <= 0.0)
+            return fail("posted impulse lost");
+    }
+
+    // the runner has let go of the world and given back the earlier sink
+    if (world.getSnapshotSink() != &recorder)
+        return fail("earlier sink not restored");
+    const double x = particles[0].position.x();
+    const std::uint64_t runnerFrames = recorder.lastFrame;
+    world.step(0.02);
+    if (particles[0].position.x() == x)
+        return fail("world not usable after the runner");
+    if (recorder.lastFrame != runnerFrames + 1)
+        return fail("frame numbers restarted when the sink was given back");
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "../../src/mp/World.hpp"
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using Vec2 = mp::Vec<2, double>;
+using Particle2 = mp::Particle<2, double>;
+using Distance2 = mp::DistanceConstraint<2, double>;
+using Constraint2 = mp::Constraint<2, double>;
+using Store2 = mp::ParticleStore<2, double>;
+
+constexpr std::size_t ropeLength = 20;
+
+int staticCalls = 0;
+void countStatic(Particle2 &particle) { staticCalls += particle.inverseMass == 0.0 ? 1 : 0; }
+
+// horizontal rope pinned at its first particle
+std::vector<Particle2> makeRope()
+{
+    std::vector<Particle2> particles(ropeLength);
+    for (std::size_t i = 0; i < particles.size(); ++i)
+        particles[i].position = {static_cast<double>(i) * 0.1, 0.0};
+    particles[0].inverseMass = 0.0;
+    return particles;
+}
+
+// the rope's joins are a range of constraints, or typed ones in a ConstraintSet
+struct Rope
+{
+    std::vector<Particle2> particles = makeRope();
+    std::vector<Distance2> joins;
+    std::vector<std::reference_wrapper<Constraint2>> refs;
+    mp::ConstraintSet<Distance2> set;
+    mp::World<2, double> world;
+
+    explicit Rope(bool typed = false)
+    {
+        joins.reserve(ropeLength);
+        for (std::size_t i = 1; i < particles.size(); ++i)
+        {
+            joins.emplace_back(particles[i - 1], particles[i]);
+            set.emplace<Distance2>(particles[i - 1], particles[i]);
+        }
+        refs.assign(joins.begin(), joins.end());
+        world.addParticles({particles});
+        if (typed)
+            world.addConstraints(set);
+        else
+            world.addConstraints({refs});
+        world.setGravity({0.0, -9.8});
+        world.setDamping(5.0);
+    }
+
+    // step until everything that can sleep has, false if it never does
+    bool settle()
+    {
+        world.setSleeping(true);
+        world.setSleepThreshold(1e-4);
+        world.setSleepWindow(20);
+        for (int steps = 0; steps < 5000; ++steps)
+        {
+            world.step(0.01);
+            if (world.sleep.awakeCount() == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool movedSince(const std::vector<Particle2> &before) const
+    {
+        for (std::size_t i = 0; i < ropeLength; ++i)
+            if (particles[i].position[0] != before[i].position[0] || particles[i].position[1] != before[i].position[1])
+                return true;
+        return false;
+    }
+};
+
+int main()
+{
+    // a threshold of zero never sleeps, and must match sleeping switched off
+    Rope reference, neverSleeps;
+    neverSleeps.world.setSleeping(true);
+    neverSleeps.world.setSleepThreshold(0.0);
+    for (int i = 0; i < 300; ++i)
+    {
+        reference.world.step(0.01);
+        neverSleeps.world.step(0.01);
+    }
+    for (std::size_t i = 0; i < ropeLength; ++i)
+    {
+        if (reference.particles[i].position[0] != neverSleeps.particles[i].position[0] ||
+            reference.particles[i].position[1] != neverSleeps.particles[i].position[1])
+        {
+            std::cout << "sleep tracking changed the simulation\n";
+            return 1;
+        }
+    }
+
+    // the rope settles and goes to sleep, whichever way its joins are held
+    Rope rope, typed(true);
+    if (!rope.settle() || !typed.settle())
+    {
+        std::cout << "rope did not fall asleep\n";
+        return 1;
+    }
+
+    // sleeping particles do not move, and nothing solved wakes them
+    std::vector<Particle2> resting = rope.particles, typedResting = typed.particles;
+    for (int i = 0; i < 100; ++i)
+    {
+        rope.world.step(0.01);
+        typed.world.step(0.01);
+    }
+    if (rope.movedSince(resting) || typed.movedSince(typedResting) || typed.world.sleep.awakeCount() != 0)
+    {
+        std::cout << "sleeping particle moved\n";
+        return 1;
+    }
+
+    // a static particle is still integrated and passed to the position
+    // callback, and moving it wakes what hangs from it
+    typed.world.setPositionCB(countStatic);
+    typed.particles[0].linearVelocity = {0.5, 0.0};
+    for (int i = 0; i < 10; ++i)
+        typed.world.step(0.01);
+    if (staticCalls == 0 || typed.particles[0].position[0] == typedResting[0].position[0]
+        || typed.world.sleep.awakeCount() != ropeLength - 1)
+    {
+        std::cout << "moving anchor did not wake the rope\n";
+        return 1;
+    }
+
+    // an impulse wakes everything connected to the particle
+    const std::size_t last = ropeLength - 1;
+    rope.world.applyImpulse(last, {0.0, 2.0});
+    rope.world.step(0.01);
+    if (rope.world.sleep.awakeCount() != ropeLength - 1 || rope.particles[last].position[1] == resting[last].position[1])
+    {
+        std::cout << "impulse did not wake the rope\n";
+        return 1;
+    }
+
+    // index based constraints over SoA storage sleep too
+    std::vector<Particle2> initial = makeRope();
+    Store2 store(initial);
+    mp::IndexedDistanceSet<2, double> links;
+    for (std::uint32_t i = 1; i < ropeLength; ++i)
+        links.add(store, i - 1, i);
+    mp::World<2, double, Store2::range> soa;
+    soa.addParticles({store});
+    soa.addConstraints(links);
+    soa.setGravity({0.0, -9.8});
+    soa.setDamping(5.0);
+    soa.setSleeping(true);
+    soa.setSleepThreshold(1e-4);
+    soa.setSleepWindow(20);
+    soa.setWarmStarting(0.5);
+    for (int i = 0; i < 5000 && (i == 0 || soa.sleep.awakeCount() > 0); ++i)
+        soa.step(0.01);
+    if (soa.sleep.awakeCount() != 0)
+    {
+        std::cout << "indexed rope did not fall asleep\n";
+        return 1;
+    }
+    // the impulses cached while it was awake are kept for when it wakes, back
+    // in the set once the next sub-step drops its constraints from the solve
+    soa.step(0.01);
+    if (!links.cachesImpulses() || links.impulses[0] == 0.0)
+    {
+        std::cout << "cached impulses lost\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "../../src/mp/World.hpp"
+#include "../../src/mp/parallel/triple_buffer.hpp"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using Particle2 = mp::Particle<2, double>;
+
+constexpr std::uint64_t frames = 20000;
+
+int main()
+{
+    // every particle moves identically, so a torn frame would show different positions
+    std::vector<Particle2> particles(500);
+    for (Particle2 &p : particles)
+        p.linearVelocity = {1.0, 0.0};
+
+    mp::World<2, double> world;
+    world.addParticles({particles});
+    world.setDamping(0.0);
+    mp::SnapshotBuffer<2, double> snapshots;
+    world.setSnapshotSink(&snapshots);
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> torn{false};
+    std::atomic<std::uint64_t> framesRead{0};
+    std::thread reader([&] {
+        std::uint64_t lastFrame = 0;
+        bool first = true;
+        while (!done.load())
+        {
+            if (!snapshots.hasNew())
+                continue;
+            const mp::Snapshot<2, double> &snapshot = snapshots.read();
+            if (snapshot.positions.size() != particles.size() || (!first && snapshot.frame <= lastFrame))
+                torn = true;
+            for (const mp::Vec<2, double> &position : snapshot.positions)
+                if (position.x() != snapshot.positions[0].x())
+                    torn = true;
+            lastFrame = snapshot.frame;
+            first = false;
+            ++framesRead;
+        }
+    });
+
+    for (std::uint64_t i = 0; i < frames; ++i)
+        world.step(0.01);
+    done = true;
+    reader.join();
+
+    // the newest frame is always available
+    const mp::Snapshot<2, double> &last = snapshots.read();
+    if (torn || framesRead == 0 || last.frame != frames - 1 || last.positions[0].x() != particles[0].position.x())
+    {
+        std::cout << "inconsistent snapshots\n";
+        return 1;
+    }
+
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
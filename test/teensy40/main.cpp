@@ -105,7 +105,7 @@ void loop()
     static elapsedMillis outputMs = 0;
     if (outputMs > 10)
     {
-        if (world.isDeathSpiralling)
+        if (world.status.overloaded)
             Serial.println("dying");
         frames = 0;
         for (auto &row : particleRows)
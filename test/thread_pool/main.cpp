@@ -0,0 +1,94 @@
+#include "../../src/mp/parallel/thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// every index of [0, n) was visited exactly once
+bool coveredOnce(const std::vector<std::atomic<int>> &visits)
+{
+    for (const std::atomic<int> &v : visits)
+        if (v.load() != 1)
+            return false;
+    return true;
+}
+
+// The first quarter of the range is slow and is all dealt to the calling
+// thread's block, so the other threads must steal it to finish early.
+bool stealsUnevenWork(mp::ThreadPool &pool)
+{
+    const std::size_t n = 400;
+    std::vector<std::atomic<int>> visits(n);
+    std::mutex mutex;
+    std::set<std::thread::id> slowThreads;
+    mp::parallel_for(&pool, 0, n, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            ++visits[i];
+            if (i < n / 4)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> lock(mutex);
+                slowThreads.insert(std::this_thread::get_id());
+            }
+        }
+    });
+    std::cout << slowThreads.size() << " threads shared the slow quarter\n";
+    return coveredOnce(visits) && slowThreads.size() > 1;
+}
+
+// calls from two threads at once take turns rather than sharing a job
+bool concurrentCallers(mp::ThreadPool &pool)
+{
+    const std::size_t n = 1000;
+    std::vector<std::atomic<int>> first(n), second(n);
+    const auto call = [&pool, n](std::vector<std::atomic<int>> &visits) {
+        for (int repeat = 0; repeat < 100; ++repeat)
+            mp::parallel_for(&pool, 0, n, 16, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i)
+                    ++visits[i];
+            });
+    };
+    std::thread other(call, std::ref(second));
+    call(first);
+    other.join();
+    for (std::size_t i = 0; i < n; ++i)
+        if (first[i].load() != 100 || second[i].load() != 100)
+            return false;
+    return true;
+}
+
+// a parallel_for inside a task runs serially in that task
+bool nestedCalls(mp::ThreadPool &pool)
+{
+    const std::size_t outer = 64, inner = 64;
+    std::vector<std::atomic<int>> visits(outer * inner);
+    mp::parallel_for(&pool, 0, outer, 4, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            mp::parallel_for(&pool, 0, inner, 4, [&](std::size_t b, std::size_t e) {
+                for (std::size_t j = b; j < e; ++j)
+                    ++visits[i * inner + j];
+            });
+    });
+    return coveredOnce(visits);
+}
+
+int main()
+{
+    mp::ThreadPool pool(4);
+    if (!stealsUnevenWork(pool))
+    {
+        std::cout << "slow chunks were not stolen\n";
+        return 1;
+    }
+    if (!concurrentCallers(pool) || !nestedCalls(pool))
+    {
+        std::cout << "shared or nested runs lost chunks\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "../../src/mp/World.hpp"
+#include "../../src/mp/parallel/trajectory_writer.hpp"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using Vec3 = mp::Vec<3, float>;
+using Particle3 = mp::Particle<3, float>;
+
+constexpr int side = 32;
+const Vec3 boundsMin{-70.0f, -80.0f, -40.0f};
+const Vec3 boundsMax{70.0f, 20.0f, 40.0f};
+
+// a cloth pinned along its top edge, swinging in a side wind
+struct Cloth
+{
+    Cloth()
+    {
+        for (int i = 0; i < side * side; ++i)
+        {
+            particles[i].position = {-62.0f + 4.0f * (i % side), 0.0f, -1.0f * (i / side)};
+            particles[i].inverseMass = i < side ? 0.0f : 1.0f;
+        }
+        for (int i = 0; i < side * side; ++i)
+        {
+            if (i % side + 1 < side)
+                joins.add(particles, i, i + 1);
+            if (i + side < side * side)
+                joins.add(particles, i, i + side);
+        }
+        world.addParticles({particles});
+        world.addConstraints(joins);
+        world.setGravity({2.0f, -13.0f, 1.0f});
+        world.setDamping(0.4f);
+    }
+
+    std::vector<Particle3> particles = std::vector<Particle3>(side * side);
+    mp::IndexedDistanceSet<3, float> joins;
+    mp::World<3, float> world;
+};
+
+std::vector<Vec3> positions(const std::vector<Particle3> &particles)
+{
+    std::vector<Vec3> out(particles.size());
+    for (std::size_t i = 0; i < particles.size(); ++i)
+        out[i] = particles[i].position;
+    return out;
+}
+
+// bytes the comma separated text of Serial.print takes for one frame
+std::size_t textBytes(const std::vector<Vec3> &frame)
+{
+    std::size_t bytes = 0;
+    char buffer[32];
+    for (const Vec3 &p : frame)
+        for (int a = 0; a < 3; ++a)
+            bytes += static_cast<std::size_t>(std::snprintf(buffer, sizeof(buffer), "%.2f,", p[a]));
+    return bytes;
+}
+
+bool withinQuantisation(const std::vector<Vec3> &expected, const std::vector<Vec3> &decoded)
+{
+    if (expected.size() != decoded.size())
+        return false;
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            const float step = (boundsMax[a] - boundsMin[a]) / 65535.0f;
+            if (!(std::abs(expected[i][a] - decoded[i][a]) <= step))
+                return false;
+        }
+    }
+    return true;
+}
+
+// 10 ms frames of a swinging cloth: size against text, and the decoded
+// positions within one quantisation step
+bool compression()
+{
+    Cloth cloth;
+    mp::TrajectoryEncoder<3, float> keys(boundsMin, boundsMax, false);
+    mp::TrajectoryEncoder<3, float> deltas(boundsMin, boundsMax, true);
+    std::vector<std::uint8_t> keyStream, deltaStream;
+    // wrapped, as Vec's catch-all operators would otherwise match the iterators
+    struct Frame { std::vector<Vec3> positions; };
+    std::vector<Frame> frames;
+    std::size_t text = 0;
+    for (int f = 0; f < 300; ++f)
+    {
+        cloth.world.step(0.01f);
+        frames.push_back({positions(cloth.particles)});
+        const std::vector<Vec3> &frame = frames.back().positions;
+        text += textBytes(frame);
+        keys.encode(frame.data(), frame.size(), f, keyStream);
+        deltas.encode(frame.data(), frame.size(), f, deltaStream);
+    }
+    std::cout << "bytes per frame: text " << text / frames.size() << ", key " << keyStream.size() / frames.size()
+        << ", delta " << deltaStream.size() / frames.size() << "\n";
+
+    const std::vector<std::uint8_t> *streams[] = {&keyStream, &deltaStream};
+    for (const std::vector<std::uint8_t> *stream : streams)
+    {
+        mp::TrajectoryDecoder<3, float> decoder(stream->data(), stream->size());
+        std::vector<Vec3> decoded;
+        std::uint64_t frame = 0;
+        std::size_t count = 0;
+        while (decoder.next(decoded, frame))
+        {
+            if (frame != count || !withinQuantisation(frames[count].positions, decoded))
+                return false;
+            ++count;
+        }
+        if (count != frames.size() || decoder.failed())
+            return false;
+    }
+    return deltaStream.size() * 10 <= text;
+}
+
+// the writer thread encodes every frame World publishes
+bool writerStreamsWorld()
+{
+    Cloth cloth;
+    mp::VectorSink sink;
+    std::vector<Vec3> last;
+    {
+        mp::TrajectoryWriter<3, float> writer(sink, boundsMin, boundsMax, true, 1, 1000);
+        cloth.world.setSnapshotSink(&writer);
+        for (int s = 0; s < 100; ++s)
+            cloth.world.step(0.01f);
+        cloth.world.setSnapshotSink(nullptr);
+        last = positions(cloth.particles);
+    }
+
+    mp::TrajectoryDecoder<3, float> decoder(sink.bytes.data(), sink.bytes.size());
+    std::vector<Vec3> decoded;
+    std::uint64_t frame = 0;
+    std::size_t count = 0;
+    while (decoder.next(decoded, frame))
+        if (frame != count++)
+            return false;
+    return count == 100 && withinQuantisation(last, decoded);
+}
+
+// a sink that holds every write until opened, as a stalled disk or socket would
+class LatchedSink : public mp::ByteSink
+{
+public:
+    bool write(const std::uint8_t *data, std::size_t size) override
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // only a guard against hanging the test if publish ever waits on the sink
+        if (!opened.wait_for(lock, std::chrono::seconds(10), [this] { return isOpen; }))
+            timedOut = true;
+        ++completed;
+        return inner.write(data, size);
+    }
+
+    void open()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isOpen = true;
+        }
+        opened.notify_all();
+    }
+
+    int writesCompleted()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return completed;
+    }
+
+    mp::VectorSink inner;
+    bool timedOut = false;
+
+private:
+    std::mutex mutex;
+    std::condition_variable opened;
+    bool isOpen = false;
+    int completed = 0;
+};
+
+// a sink that cannot keep up loses frames rather than holding up step
+bool blockedSinkDoesNotBlock()
+{
+    Cloth cloth;
+    LatchedSink sink;
+    std::uint64_t dropped = 0;
+    bool failed = false;
+    int completedWhileStepping = 0;
+    {
+        mp::TrajectoryWriter<3, float> writer(sink, boundsMin, boundsMax, true, 1, 2);
+        cloth.world.setSnapshotSink(&writer);
+        for (int s = 0; s < 50; ++s)
+            cloth.world.step(0.01f);
+        // every step returned while no write could finish
+        completedWhileStepping = sink.writesCompleted();
+        cloth.world.setSnapshotSink(nullptr);
+        sink.open();
+        dropped = writer.framesDropped();
+        failed = writer.failed();
+    }
+
+    mp::TrajectoryDecoder<3, float> decoder(sink.inner.bytes.data(), sink.inner.bytes.size());
+    std::vector<Vec3> decoded;
+    std::uint64_t frame = 0, previous = 0;
+    std::size_t count = 0;
+    while (decoder.next(decoded, frame))
+    {
+        if (count++ > 0 && frame <= previous)
+            return false;
+        previous = frame;
+    }
+    return completedWhileStepping == 0 && !sink.timedOut && dropped > 0 && !failed && count > 0 && !decoder.failed();
+}
+
+int main()
+{
+    if (!compression())
+    {
+        std::cout << "trajectory stream too large or inaccurate\n";
+        return 1;
+    }
+    if (!writerStreamsWorld())
+    {
+        std::cout << "writer lost frames\n";
+        return 1;
+    }
+    if (!blockedSinkDoesNotBlock())
+    {
+        std::cout << "blocked sink held up the world\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include "../common/cloth.hpp"
+#include "../../src/mp/io/checkpoint.hpp"
+#include <iostream>
+#include <vector>
+
+double settledStretch(Kind kind, int iterations, double factor, mp::SolverMode mode = mp::SolverMode::GaussSeidel)
+{
+    Cloth cloth(kind);
+    cloth.world.iterationCount = iterations;
+    cloth.world.setWarmStarting(factor);
+    cloth.world.setSolverMode(mode);
+    cloth.run(300);
+    return cloth.stretch();
+}
+
+// warm started the cloth holds as well with fewer iterations
+bool fewerIterations()
+{
+    const double cold = settledStretch(Kind::Indexed, 5, 0.0);
+    const double half = settledStretch(Kind::Indexed, 5, 0.5);
+    const double two = settledStretch(Kind::Indexed, 2, 0.9);
+    const double typed = settledStretch(Kind::Typed, 2, 0.9);
+    const double islands = settledStretch(Kind::Indexed, 2, 0.9, mp::SolverMode::Islands);
+    std::cout << "stretch cold 5 iterations " << cold << ", warm 5 " << half << ", warm 2 " << two << "\n";
+    return half < cold * 0.8 && two < cold && typed < cold && islands < cold;
+}
+
+// range and indexed constraints solve the same joins in the same order, so
+// their cached impulses and results match exactly
+bool samePaths()
+{
+    Cloth range(Kind::Range), indexed(Kind::Indexed);
+    for (Cloth *cloth : {&range, &indexed})
+    {
+        cloth->world.iterationCount = 4;
+        cloth->world.setWarmStarting(0.5);
+        cloth->run(100);
+    }
+    if (!indexed.indexed.cachesImpulses())
+        return false;
+    bool cached = false;
+    for (std::size_t i = 0; i < range.joins.size(); ++i)
+    {
+        if (range.joins[i].accumulatedImpulse() != indexed.indexed.impulses[i])
+            return false;
+        cached = cached || range.joins[i].accumulatedImpulse() != 0.0;
+    }
+    return cached && range.samePositions(indexed.particles.data());
+}
+
+// the SIMD batch kernels cache the scalar solve's impulses
+bool batchImpulses()
+{
+    std::vector<double> impulses;
+    for (mp::simd::Isa isa : {mp::simd::Isa::Scalar, mp::simd::Isa::SSE4, mp::simd::Isa::AVX2})
+    {
+        mp::simd::setMaxIsa(isa);
+        Cloth cloth(Kind::Typed);
+        cloth.world.iterationCount = 4;
+        cloth.world.setWarmStarting(0.5);
+        cloth.run(50);
+        for (const Distance3 &join : cloth.set.get<Distance3>())
+            impulses.push_back(join.accumulatedImpulse());
+    }
+    mp::simd::setMaxIsa(mp::simd::Isa::AVX2);
+    const std::size_t n = impulses.size() / 3;
+    for (std::size_t i = 0; i < n; ++i)
+        if (impulses[i] != impulses[i + n] || impulses[i] != impulses[i + 2 * n])
+            return false;
+    return true;
+}
+
+// turning warm starting off and on again starts it from nothing rather than
+// from impulses cached while it was off
+bool toggles()
+{
+    Cloth toggled(Kind::Indexed), fresh(Kind::Indexed);
+    toggled.world.setWarmStarting(0.5);
+    toggled.run(50);
+    toggled.world.setWarmStarting(0.0);
+    toggled.run(1);
+    if (toggled.world.warmStarted)
+        return false;
+
+    // the fresh cloth catches up cold, then both switch on together
+    for (std::size_t i = 0; i < fresh.particles.size(); ++i)
+        fresh.particles[i] = toggled.particles[i];
+    fresh.world.setWarmStarting(0.0);
+    fresh.run(1);
+    for (std::size_t i = 0; i < fresh.particles.size(); ++i)
+        fresh.particles[i] = toggled.particles[i];
+    for (Cloth *cloth : {&toggled, &fresh})
+    {
+        cloth->world.setWarmStarting(0.5);
+        cloth->run(20);
+    }
+    return toggled.samePositions(fresh.particles.data());
+}
+
+// indexed sets only keep impulses while warm starting reads them
+bool impulsesOnDemand()
+{
+    Cloth cloth(Kind::Indexed);
+    cloth.run(5);
+    const bool cold = cloth.indexed.impulses.empty();
+    cloth.world.setWarmStarting(0.5);
+    cloth.run(5);
+    const bool warm = cloth.indexed.cachesImpulses();
+    cloth.world.setWarmStarting(0.0);
+    cloth.run(2);
+    return cold && warm && cloth.indexed.impulses.empty();
+}
+
+// the cached impulses and whether they apply survive a checkpoint
+bool checkpointed()
+{
+    Cloth cloth(Kind::Indexed);
+    cloth.world.setWarmStarting(0.5);
+    cloth.run(50);
+    std::vector<std::uint8_t> bytes;
+    mp::writeCheckpoint(cloth.world, bytes);
+    cloth.run(50);
+
+    mp::Checkpoint<3, double> checkpoint(bytes.data(), bytes.size());
+    if (!checkpoint.valid())
+        return false;
+    mp::IndexedDistanceSet<3, double> restoredCloth;
+    checkpoint.loadIndexedSet(0, restoredCloth);
+    mp::World<3, double> restored;
+    restored.addParticles(checkpoint.particles());
+    restored.addConstraints(restoredCloth);
+    checkpoint.restore(restored);
+    for (int s = 0; s < 50; ++s)
+        restored.step(0.01);
+    return cloth.samePositions(checkpoint.particles().begin()) && restored.getWarmStarting() == 0.5 && restored.warmStarted;
+}
+
+// Islands solves the indexed set itself, so turning sleeping on and off keeps
+// its impulses. Nothing comes to rest here, so it runs as if never sleeping.
+bool islandsSleeping()
+{
+    Cloth sleeper(Kind::Indexed), reference(Kind::Indexed);
+    for (Cloth *cloth : {&sleeper, &reference})
+    {
+        cloth->world.setSolverMode(mp::SolverMode::Islands);
+        cloth->world.setWarmStarting(0.5);
+        cloth->run(10);
+    }
+    for (int round = 0; round < 3; ++round)
+    {
+        sleeper.world.setSleeping(true);
+        sleeper.run(20);
+        reference.run(20);
+        // and switching solver while asleep hands the impulses over both ways
+        const mp::SolverMode mode = round == 1 ? mp::SolverMode::GaussSeidel : mp::SolverMode::Islands;
+        for (Cloth *cloth : {&sleeper, &reference})
+            cloth->world.setSolverMode(mode);
+        sleeper.run(10);
+        reference.run(10);
+        sleeper.world.setSleeping(false);
+        sleeper.run(5);
+        reference.run(5);
+    }
+    if (!sleeper.indexed.cachesImpulses())
+        return false;
+    for (std::size_t i = 0; i < sleeper.indexed.impulses.size(); ++i)
+        if (sleeper.indexed.impulses[i] != reference.indexed.impulses[i])
+            return false;
+    return sleeper.samePositions(reference.particles.data());
+}
+
+int main()
+{
+    if (!fewerIterations())
+    {
+        std::cout << "warm starting did not hold the cloth with fewer iterations\n";
+        return 1;
+    }
+    if (!samePaths() || !batchImpulses())
+    {
+        std::cout << "cached impulses differ between solve paths\n";
+        return 1;
+    }
+    if (!toggles() || !impulsesOnDemand())
+    {
+        std::cout << "toggling warm starting kept stale impulses\n";
+        return 1;
+    }
+    if (!islandsSleeping())
+    {
+        std::cout << "sleeping overwrote the impulses Islands cached\n";
+        return 1;
+    }
+    if (!checkpointed())
+    {
+        std::cout << "warm starting did not survive a checkpoint\n";
+        return 1;
+    }
+    std::cout << "Test Success" << "\n";
+    return 0;
+}